@@ -5,9 +5,13 @@
  * @details Measures performance of the following operations
  * - Random number generator
  * - 3x3 matrix multiplication
- * - Nearest neighbour communication
+ * - Nearest neighbour communication, compare builds with and without SHARED_HALO=1
  * - FFT
- * - Simple smear update
+ * - Simple smear update, and nearest neighbour SU(5) multiplication where the halo exchange
+ *   overlaps with the computation: compare runs with and without "-mpi_progress on"
+ * - Lattice metadata: neighbour and coordinate access, compare builds with and without
+ *   LOW_MEMORY_LATTICE=1
+ * - Binary field I/O, rank 0 vs. collective MPI-IO
  */
 #include "hila.h"
 
@@ -150,6 +154,26 @@ void bench_comm() {
         hila::out0 << "  Gather from direction " << hila::prettyprint(d) << ": " << time / n_gathers
                    << " s/gather\n";
     }
+
+    // halos of all directions in flight at once, as in stencil loops
+#ifdef MPI_SHARED_HALO
+    hila::out0 << "SU(3) matrix field, all directions (shared memory halos on the host)\n";
+#else
+    hila::out0 << "SU(3) matrix field, all directions (MPI messages)\n";
+#endif
+
+    Field<SU<3, double>> mf = 1;
+    foralldir(d) mf.gather(d);
+
+    auto time = hila::gettime();
+    for (int i = 0; i < n_gathers; i++) {
+        mf.mark_changed(ALL);
+        foralldir(d) mf.start_gather(d, ALL);
+        foralldir(d) mf.wait_gather(d, ALL);
+    }
+    hila::synchronize();
+    time = hila::gettime() - time;
+    hila::out0 << "  Gather from all positive directions: " << time / n_gathers << " s\n";
 }
 
 //--------------------------------------------------------------------------------
@@ -225,7 +249,10 @@ void bench_matrix_update() {
     constexpr int n_update = 50;
 
     hila::out0 << "\n-------------------------------------\n";
-    hila::out0 << "NN-mult SU(5) matrix field " << n_update << " times\n";
+    hila::out0 << "NN-mult SU(5) matrix field " << n_update << " times";
+    if (hila::mpi_progress.is_on())
+        hila::out0 << " (MPI progress thread on)";
+    hila::out0 << '\n';
 
     Field<SU<5, double>> df, rf;
 
@@ -252,6 +279,116 @@ void bench_matrix_update() {
 }
 
 
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Benchmark neighbour and coordinate access - the per-site tables, or computed
+// from the site index with LOW_MEMORY_LATTICE
+
+void bench_lattice_metadata() {
+
+    constexpr int n_loops = 200;
+
+    hila::out0 << "\n-------------------------------------\n";
+#ifdef LOW_MEMORY_LATTICE
+    hila::out0 << "Lattice metadata (LOW_MEMORY_LATTICE): ";
+#else
+    hila::out0 << "Lattice metadata (site tables): ";
+#endif
+    hila::out0 << lattice->metadata_bytes() / (double)lattice->mynode.volume
+               << " bytes/site on node 0\n";
+
+    Field<double> df, rf;
+
+    df.gaussian_random();
+    foralldir(d) {
+        df.gather(d);
+        df.gather(-d);
+    }
+
+    // halos are valid, loops measure only the neighbour access
+    auto time = hila::gettime();
+    for (int i = 0; i < n_loops; i++) {
+        onsites(ALL) {
+            double s = 0;
+            foralldir(d) s += df[X + d] + df[X - d];
+            rf[X] = s;
+        }
+    }
+    hila::synchronize();
+    time = hila::gettime() - time;
+    hila::out0 << "  Neighbour access loop: " << time / n_loops << " s, per site "
+               << time / n_loops / lattice.volume() << '\n';
+
+    time = hila::gettime();
+    for (int i = 0; i < n_loops; i++) {
+        onsites(ALL) {
+            rf[X] = X.coordinate(e_x) + X.coordinate(e_y);
+        }
+    }
+    hila::synchronize();
+    time = hila::gettime() - time;
+    hila::out0 << "  Coordinate access loop: " << time / n_loops << " s, per site "
+               << time / n_loops / lattice.volume() << '\n';
+}
+
+// ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+// Benchmark binary field I/O: everything through rank 0 vs. collective MPI-IO
+
+void bench_io() {
+
+    constexpr int n_io = 3;
+    const std::string fname_root("bench_io_root.dat"), fname_mpi("bench_io_mpi.dat");
+
+    hila::out0 << "\n-------------------------------------\n";
+    hila::out0 << "Write and read 3x3 complex double matrix field, " << n_io << " times\n";
+
+    using mat_t = Matrix<3, 3, Complex<double>>;
+    Field<mat_t> f, g;
+    f.gaussian_random();
+
+    bool parallel_io = hila::get_parallel_io();
+    double mbytes = lattice.volume() * sizeof(mat_t) * 1e-6;
+
+    for (int mode = 0; mode < 2; mode++) {
+        hila::set_parallel_io(mode == 1);
+        const std::string &fname = (mode == 0) ? fname_root : fname_mpi;
+
+        hila::synchronize();
+        auto time = hila::gettime();
+        for (int i = 0; i < n_io; i++) {
+            f.write(fname);
+        }
+        hila::synchronize();
+        auto wtime = (hila::gettime() - time) / n_io;
+
+        time = hila::gettime();
+        for (int i = 0; i < n_io; i++) {
+            g.read(fname);
+        }
+        hila::synchronize();
+        auto rtime = (hila::gettime() - time) / n_io;
+
+        double diff = 0;
+        onsites(ALL) diff += (f[X] - g[X]).squarenorm();
+
+        hila::out0 << (mode == 0 ? "  Rank 0 I/O:   " : "  MPI-IO:       ") << "write " << wtime
+                   << " s (" << mbytes / wtime << " MB/s), read " << rtime << " s ("
+                   << mbytes / rtime << " MB/s), read back diff " << diff << '\n';
+    }
+
+    hila::set_parallel_io(parallel_io);
+
+    if (hila::myrank() == 0) {
+        std::ifstream f1(fname_root, std::ios::binary), f2(fname_mpi, std::ios::binary);
+        bool same = std::equal(std::istreambuf_iterator<char>(f1), std::istreambuf_iterator<char>(),
+                               std::istreambuf_iterator<char>(f2), std::istreambuf_iterator<char>());
+        hila::out0 << "  Files are " << (same ? "identical" : "DIFFERENT") << '\n';
+        f1.close();
+        f2.close();
+        filesys_ns::remove(fname_root);
+        filesys_ns::remove(fname_mpi);
+    }
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
 int main(int argc, char **argv) {
@@ -292,6 +429,10 @@ int main(int argc, char **argv) {
 
     bench_matrix_update();
 
+    bench_lattice_metadata();
+
+    bench_io();
+
     hila::out0 << "\n##################################\n";
 
     hila::finishrun();
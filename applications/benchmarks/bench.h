@@ -8,7 +8,7 @@
 
 #include "plumbing/defs.h"
 #include "datatypes/matrix.h"
-#include "datatypes/sun.h"
+#include "datatypes/sun_matrix.h"
 //#include "datatypes/wilson_vector.h"
 #include "plumbing/field.h"
 //#include "dirac/staggered.h"
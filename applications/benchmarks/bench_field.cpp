@@ -1,3 +1,4 @@
+#include "bench.h"
 #include "plumbing/coordinates.h"
 #include "dirac/conjugate_gradient.h"
 
@@ -266,5 +267,127 @@ int main(int argc, char **argv) {
     timing = timing / 2 / NDIRS / (double)n_runs;
     hila::out0 << "Matrix nearest neighbour communication: " << timing << " ms \n";
 
+    // Site ordering and stencil kernels.  Compare the numbers between builds
+    // with and without TILED_SITE_ORDER: the fraction of on-node neighbours
+    // stored "far" from the site (more than ~ an L2 cache worth of matrices away)
+    // tracks the cache misses of the staple and hopping kernels below.
+    // With EVEN_SITES_FIRST the neighbours of even sites are in the odd block and vice
+    // versa, thus the distance is measured between the offsets within the parity blocks.
+    {
+        constexpr size_t far_sites = 256 * 1024 / sizeof(SquareMatrix<N, Complex<double>>);
+        auto block_offset = [](size_t i) -> size_t {
+#if defined(EVEN_SITES_FIRST)
+            if (i >= lattice->mynode.evensites)
+                return i - lattice->mynode.evensites;
+#endif
+            return i;
+        };
+        hila::out0 << "Site order: ";
+#ifdef TILED_SITE_ORDER
+        hila::out0 << "tiled, tile size " << SITE_TILE_SIZE << '\n';
+#else
+        hila::out0 << "typewriter\n";
+#endif
+        for (int dir = 0; dir < NDIRS; dir++) {
+            size_t n_on = 0, n_far = 0;
+            for (unsigned i = 0; i < lattice->mynode.volume; i++) {
+                unsigned j = lattice->neighb[dir][i];
+                if (j < lattice->mynode.volume) {
+                    n_on++;
+                    size_t oi = block_offset(i), oj = block_offset(j);
+                    if ((oj > oi ? oj - oi : oi - oj) > far_sites)
+                        n_far++;
+                }
+            }
+            hila::reduce_node_sum(&n_on, 1, true);
+            hila::reduce_node_sum(&n_far, 1, true);
+            hila::out0 << "  direction " << (Direction)dir << ": far neighbours "
+                       << (n_on > 0 ? 100.0 * n_far / n_on : 0.0) << " %\n";
+        }
+    }
+
+    Field<SquareMatrix<N, Complex<double>>> link[NDIM];
+    foralldir(d) {
+        onsites(ALL) link[d][X].random();
+    }
+
+    // Time STAPLE sum
+    timing = 0;
+    for (n_runs = 1; timing < mintime;) {
+        n_runs *= 2;
+        gettimeofday(&start, NULL);
+        for (int i = 0; i < n_runs; i++) {
+            matrix1[ALL] = 0;
+            foralldir(mu) foralldir(nu) if (mu != nu) {
+                link[mu].mark_changed(ALL);
+                link[nu].mark_changed(ALL);
+                onsites(ALL) {
+                    matrix1[X] += link[nu][X + mu] * link[mu][X + nu].dagger() * link[nu][X].dagger();
+                }
+            }
+        }
+        // synchronize();
+        gettimeofday(&end, NULL);
+        timing = timediff(start, end);
+        hila::broadcast(timing);
+    }
+    timing = timing / (double)n_runs;
+    hila::out0 << "Staple sum: " << timing << " ms, "
+               << 1e6 * timing / (NDIM * (NDIM - 1) * lattice.volume() / hila::number_of_nodes())
+               << " ns/site/staple\n";
+
+    // Time HOPPING term of Dirac operators
+    timing = 0;
+    for (n_runs = 1; timing < mintime;) {
+        n_runs *= 2;
+        gettimeofday(&start, NULL);
+        for (int i = 0; i < n_runs; i++) {
+            vector1.mark_changed(ALL);
+            onsites(ALL) {
+                Vector<N, Complex<double>> v = 0;
+                foralldir(d) {
+                    v += link[d][X] * vector1[X + d] + link[d][X - d].dagger() * vector1[X - d];
+                }
+                vector2[X] = v;
+            }
+        }
+        // synchronize();
+        gettimeofday(&end, NULL);
+        timing = timediff(start, end);
+        hila::broadcast(timing);
+    }
+    timing = timing / (double)n_runs;
+    hila::out0 << "Dirac hopping term: " << timing << " ms, "
+               << 1e6 * timing / (lattice.volume() / hila::number_of_nodes()) << " ns/site\n";
+
+    // The same hopping term on K vectors at once, each link read once per site for
+    // all of them.  Reported per vector, compare to the single vector timing above.
+    constexpr int K = 4;
+    Field<VectorBatch<K, Vector<N, Complex<double>>>> batch1, batch2;
+    onsites(ALL) batch1[X].gaussian_random();
+    timing = 0;
+    for (n_runs = 1; timing < mintime;) {
+        n_runs *= 2;
+        gettimeofday(&start, NULL);
+        for (int i = 0; i < n_runs; i++) {
+            batch1.mark_changed(ALL);
+            onsites(ALL) {
+                VectorBatch<K, Vector<N, Complex<double>>> v = 0;
+                foralldir(d) {
+                    v += link[d][X] * batch1[X + d] + link[d][X - d].dagger() * batch1[X - d];
+                }
+                batch2[X] = v;
+            }
+        }
+        // synchronize();
+        gettimeofday(&end, NULL);
+        timing = timediff(start, end);
+        hila::broadcast(timing);
+    }
+    timing = timing / (double)n_runs / K;
+    hila::out0 << "Dirac hopping term, " << K << " vectors: " << timing << " ms, "
+               << 1e6 * timing / (lattice.volume() / hila::number_of_nodes())
+               << " ns/site/vector\n";
+
     hila::finishrun();
 }
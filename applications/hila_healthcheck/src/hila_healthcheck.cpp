@@ -7,6 +7,8 @@
 #include "hila.h"
 
 #include "clusters.h"
+#include "dirac/conjugate_gradient.h"
+#include "dirac/multigrid.h"
 
 // unistd.h needed for isatty()
 #include <unistd.h>
@@ -207,6 +209,45 @@ void test_reductions() {
         report_pass("SU(" + std::to_string(N) + ") ReductionVector", diff, 1e-8);
     }
 #endif
+
+    {
+        // batched reductions of different types, combined to one collective
+        Field<Complex<double>> f;
+        f[ALL] = expi(2 * M_PI * X.x() / lattice.size(e_x));
+
+        Reduction<double> rd;
+        Reduction<Complex<double>> rc;
+        Reduction<Matrix<2, 2, double>> rm;
+        Reduction<ExtendedPrecision> re;
+        Reduction<int64_t> ri;
+        rd.batched();
+        rc.batched();
+        rm.batched();
+        re.batched();
+        ri.batched();
+
+        int64_t n_coll = hila::reduction_batch.n_collectives;
+
+        onsites (ALL) {
+            rd += X.x();
+            rc += f[X];
+            rm += X.x();
+            re += X.x();
+            ri += 1;
+        }
+
+        // expected sum of X.x()
+        double xsum = 0.5 * (lattice.size(e_x) - 1) * lattice.volume();
+
+        double diff = abs(rd.value() - xsum) + abs(rc.value()) +
+                      abs(rm.value().trace() - 2 * xsum) + abs(re.value().to_double() - xsum) +
+                      abs(ri.value() - lattice.volume());
+        report_pass("Batched reductions", diff / lattice.volume(), 1e-10);
+
+        if (hila::number_of_nodes() > 1)
+            report_pass("Batched reductions use one collective",
+                        hila::reduction_batch.n_collectives - n_coll - 1, 1e-10);
+    }
 }
 
 
@@ -233,6 +274,542 @@ void test_site_access() {
     }
 }
 
+/**
+ * @brief Test shifts by general offsets
+ * @details Shifted coordinate fields are compared with the expected coordinates, for
+ * both parities and a repeated shift which uses the cached gather
+ */
+void test_shift() {
+
+    CoordinateVector v;
+    foralldir (d)
+        v[d] = (int)(hila::random() * 2 * lattice.size(d)) - lattice.size(d);
+    hila::broadcast(v);
+
+    Field<int> f, g;
+    for (Parity par : {ALL, EVEN, ALL}) {
+        int64_t errors = 0;
+        foralldir (d) {
+            int vd = v[d];
+            int size = lattice.size(d);
+            f[ALL] = X.coordinate(d);
+            g[ALL] = -1;
+            f.shift(v, g, par);
+            onsites (par) {
+                if (g[X] != ((X.coordinate(d) + vd) % size + size) % size)
+                    errors += 1;
+            }
+        }
+        report_pass("Shift by " + hila::prettyprint(v.transpose()) + " parity " +
+                        hila::prettyprint(par),
+                    errors, 0.5);
+    }
+
+    // more offsets than the gather cache holds: gathers are evicted and recreated
+    {
+        int64_t errors = 0;
+        int size = lattice.size(e_x);
+        lattice.ptr()->set_general_gather_cache_size(2);
+        f[ALL] = X.coordinate(e_x);
+        for (int rep = 0; rep < 2; rep++) {
+            for (int k = 2; k <= 4; k++) {
+                CoordinateVector w(0);
+                w[e_x] = k;
+                f.shift(w, g);
+                onsites (ALL) {
+                    if (g[X] != (X.coordinate(e_x) + k) % size)
+                        errors += 1;
+                }
+            }
+        }
+        lattice.ptr()->clear_general_gathers();
+        lattice.ptr()->set_general_gather_cache_size(16);
+        report_pass("Shift with evicted gathers", errors, 0.5);
+    }
+
+    // offsets within the wide halo: X + d1 + d2 and X + 2*d1
+    {
+        int64_t errors = 0;
+        f.set_halo_depth(2);
+        f[ALL] = X.coordinate(e_x) + lattice.size(e_x) * X.coordinate(e_y);
+        for (Parity par : {ALL, EVEN})
+            foralldir (d1)
+                foralldir (d2) {
+                    CoordinateVector w = (d1 == d2) ? d1 + d1 : d1 - d2;
+                    g[ALL] = -1;
+                    f.shift(w, g, par);
+                    int wx = w[e_x], wy = w[e_y];
+                    onsites (ALL) {
+                        int x = (X.coordinate(e_x) + wx + lattice.size(e_x)) % lattice.size(e_x);
+                        int y = (X.coordinate(e_y) + wy + lattice.size(e_y)) % lattice.size(e_y);
+                        bool in_par = (par == ALL || X.parity() == par);
+                        if (g[X] != (in_par ? x + lattice.size(e_x) * y : -1))
+                            errors += 1;
+                    }
+                }
+        // back to the default, and release the halo tables
+        f.set_halo_depth(1);
+        lattice.ptr()->clear_wide_halos();
+        report_pass("Shift within wide halo of depth 2", errors, 0.5);
+    }
+}
+
+/**
+ * @brief Test gathers with the MPI progress thread
+ * @details Runs only with "-mpi_progress on" on at least 2 ranks.  Gathers are started by
+ * hand and left to the thread, and the fields are changed or deleted while the other
+ * requests are still registered with it, thus add(), wait() and remove() race with the
+ * thread.  The gathered neighbours must be correct.
+ */
+void test_mpi_progress() {
+    if (!hila::mpi_progress.is_on()) {
+        hila::out0 << " ...  Skipping MPI progress thread test, run with -mpi_progress on "
+                      "on at least 2 ranks\n";
+        return;
+    }
+
+    int64_t n_requests = hila::mpi_progress.n_requests;
+    int64_t errors = 0;
+    for (int rep = 0; rep < 10; rep++) {
+        foralldir (d) {
+            int size = lattice.size(d);
+            Field<int> f;
+            f[ALL] = X.coordinate(d);
+            for (Direction dir = (Direction)0; dir < NDIRS; ++dir)
+                f.start_gather(dir, (rep % 2 == 0) ? ALL : EVEN);
+            onsites (ALL) {
+                if (f[X + d] != (X.coordinate(d) + 1) % size ||
+                    f[X - d] != (X.coordinate(d) - 1 + size) % size)
+                    errors += 1;
+            }
+            // the gathers of the other directions are dropped here
+            f[ALL] = X.coordinate(d);
+            f.start_gather(d, ALL);
+            f.start_gather(-d, ODD);
+            // and deleted with the field
+        }
+    }
+    report_pass("Gathers with the MPI progress thread", errors, 0.5);
+    report_pass("MPI progress thread saw the requests",
+                hila::mpi_progress.n_requests > n_requests ? 0 : 1, 0.5);
+}
+
+/**
+ * @brief Test compressed halo exchange
+ * @details SU(N) links are sent as N-1 rows, neighbours must agree with the uncompressed
+ * field to rounding accuracy.
+ */
+void test_halo_compression() {
+    // on a single rank there are no halo messages
+    if (hila::number_of_nodes() < 2) {
+        hila::out0 << " ...  Skipping halo compression test, needs at least 2 ranks\n";
+        return;
+    }
+
+    Field<SU<3, double>> f, g;
+    onsites (ALL)
+        f[X].random();
+    g = f;
+    g.set_halo_compression();
+
+    double diff = 0;
+    for (Direction d = e_x; d < NDIRS; ++d) {
+        onsites (ALL)
+            diff += (f[X + d] - g[X + d]).squarenorm();
+    }
+    report_pass("SU(3) halo compression", diff / lattice.volume(), 1e-20);
+
+    // numbers in reduced precision, relative error ~ float epsilon.  Changing the halo
+    // format invalidates the halos gathered above, thus they are gathered again
+    g.set_halo_compression(false);
+    g.set_halo_precision(hila::halo_precision::SINGLE);
+    diff = 0;
+    for (Direction d = e_x; d < NDIRS; ++d) {
+        onsites (ALL)
+            diff += (f[X + d] - g[X + d]).squarenorm();
+    }
+    report_pass("SU(3) single precision halo", sqrt(diff / lattice.volume()), 1e-6);
+}
+
+/**
+ * @brief Toy operator for the solver tests
+ * @details D = m + K, where K v(X) = 1/2 sum_d (v(X+d) - v(X-d)) is anti-Hermitian, thus
+ * D^dagger D = m^2 - K^2 is positive definite with condition number ~ (1 + NDIM/m^2).
+ */
+template <typename T>
+class toy_dirac {
+  public:
+    using vector_type = T;
+    Parity par = ALL;
+    double mass;
+
+    toy_dirac(double m) : mass(m) {}
+
+    void apply(const Field<T> &in, Field<T> &out) {
+        hop(in, out, 1);
+    }
+    void dagger(const Field<T> &in, Field<T> &out) {
+        hop(in, out, -1);
+    }
+
+    /// the same operator on a batch of K vectors, for CG_multi
+    template <int K>
+    void apply(const Field<VectorBatch<K, T>> &in, Field<VectorBatch<K, T>> &out) {
+        hop(in, out, 1);
+    }
+    template <int K>
+    void dagger(const Field<VectorBatch<K, T>> &in, Field<VectorBatch<K, T>> &out) {
+        hop(in, out, -1);
+    }
+
+  private:
+    template <typename B>
+    void hop(const Field<B> &in, Field<B> &out, int sign) {
+        hila::arithmetic_type<T> m = mass;
+        hila::arithmetic_type<T> h = 0.5 * sign;
+        out[ALL] = m * in[X];
+        foralldir (d)
+            out[ALL] += h * (in[X + d] - in[X - d]);
+    }
+};
+
+/**
+ * @brief Relative residual |src - (D^dagger D + shift) x| / |src| of a solution of the toy
+ * operator
+ */
+template <typename T>
+double toy_residue(toy_dirac<T> &D, const Field<T> &src, const Field<T> &x, double shift = 0) {
+    Field<T> t1, t2;
+    D.apply(x, t1);
+    D.dagger(t1, t2);
+    t2[ALL] = src[X] - t2[X] - shift * x[X];
+    return sqrt(t2.squarenorm() / src.squarenorm());
+}
+
+/**
+ * @brief Test CG with reduced precision halos
+ * @details The early iterations use SINGLE or HALF precision halos, the result must
+ * still reach the requested accuracy.  With a single rank there are no halo messages
+ * and the test checks only the switching logic.
+ */
+void test_cg_halo_precision() {
+    using vec_t = Vector<2, Complex<double>>;
+    toy_dirac<vec_t> D(0.2);
+
+    Field<vec_t> src, x;
+    src.gaussian_random();
+
+    for (auto prec : {hila::halo_precision::FULL, hila::halo_precision::SINGLE,
+                      hila::halo_precision::HALF}) {
+        x[ALL] = 0;
+        CG<toy_dirac<vec_t>> inverse(D, 1e-10);
+        inverse.set_halo_precision(prec);
+        inverse.apply(src, x);
+
+        const char *name[] = {"full", "single", "half"};
+        report_pass(std::string("CG with ") + name[(int)prec] + " precision halos",
+                    toy_residue(D, src, x), 1e-9);
+    }
+}
+
+/**
+ * @brief Test mixed precision CG
+ * @details The Krylov iterations run with the single precision toy operator, the reliable
+ * updates must still bring the double precision residual to the requested accuracy.
+ */
+void test_cg_mixed() {
+    using vec_t = Vector<2, Complex<double>>;
+    using vec_f = Vector<2, Complex<float>>;
+    toy_dirac<vec_t> D(0.2);
+    toy_dirac<vec_f> D_flt(0.2);
+
+    Field<vec_t> src, x;
+    src.gaussian_random();
+    x[ALL] = 0;
+
+    CG_mixed<toy_dirac<vec_t>, toy_dirac<vec_f>> inverse(D, D_flt, 1e-10);
+    inverse.apply(src, x);
+    report_pass("Mixed precision CG", toy_residue(D, src, x), 1e-9);
+}
+
+/**
+ * @brief Test multi-shift CG
+ * @details All shifted systems (D^dagger D + shift) x = b are solved in the Krylov space of
+ * the smallest shift, each solution must reach the requested accuracy.
+ */
+void test_multishift_cg() {
+    using vec_t = Vector<2, Complex<double>>;
+    toy_dirac<vec_t> D(0.2);
+
+    Field<vec_t> src;
+    src.gaussian_random();
+
+    std::vector<double> shifts = {0.5, 0.0, 0.01, 0.1};
+    std::vector<Field<vec_t>> x;
+    multishift_CG<toy_dirac<vec_t>> inverse(D, shifts, 1e-10);
+    inverse.apply(src, x);
+
+    double res = 0;
+    for (int i = 0; i < shifts.size(); i++)
+        res = std::max(res, toy_residue(D, src, x[i], shifts[i]));
+    report_pass("Multi-shift CG", res, 1e-9);
+}
+
+/**
+ * @brief Test pipelined CG against the plain CG
+ * @details Both must reach the requested accuracy, and the solutions must agree within
+ * the condition number of D^dagger D times the accuracy.
+ */
+void test_cg_pipelined() {
+    using vec_t = Vector<2, Complex<double>>;
+    toy_dirac<vec_t> D(0.2);
+
+    Field<vec_t> src, x, x_pipe;
+    src.gaussian_random();
+    x[ALL] = 0;
+    x_pipe[ALL] = 0;
+
+    CG<toy_dirac<vec_t>> inverse(D, 1e-10);
+    inverse.apply(src, x);
+    CG_pipelined<toy_dirac<vec_t>> inverse_pipe(D, 1e-10);
+    inverse_pipe.apply(src, x_pipe);
+
+    report_pass("Pipelined CG", toy_residue(D, src, x_pipe), 1e-9);
+
+    x_pipe[ALL] = x_pipe[X] - x[X];
+    report_pass("Pipelined CG against CG", sqrt(x_pipe.squarenorm() / x.squarenorm()), 1e-7);
+}
+
+/**
+ * @brief Test the batched operator and the multi right hand side CG
+ * @details The batched toy operator must agree with K single applications, and CG_multi
+ * must agree with CG for each vector.  The std::vector interface is given 5 sources, thus
+ * the last batch of K = 3 is padded with a zero vector.
+ */
+void test_cg_multi() {
+    using vec_t = Vector<2, Complex<double>>;
+    constexpr int K = 3;
+    toy_dirac<vec_t> D(0.2);
+
+    Field<VectorBatch<K, vec_t>> a, Da;
+    Field<vec_t> a1, Da1;
+    a.gaussian_random();
+    D.apply(a, Da);
+
+    double diff = 0, norm = 0;
+    for (int k = 0; k < K; k++) {
+        a1[ALL] = a[X].v[k];
+        D.apply(a1, Da1);
+        onsites (ALL) {
+            diff += squarenorm(Da[X].v[k] - Da1[X]);
+            norm += squarenorm(Da1[X]);
+        }
+    }
+    report_pass("Batched operator against single vectors", sqrt(diff / norm), 1e-14);
+
+    std::vector<Field<vec_t>> src(5), x;
+    for (auto &s : src)
+        s.gaussian_random();
+
+    CG_multi<toy_dirac<vec_t>, K> inverse_multi(D, 1e-10);
+    inverse_multi.apply(src, x);
+
+    CG<toy_dirac<vec_t>> inverse(D, 1e-10);
+    double res = 0, dev = 0;
+    for (int i = 0; i < src.size(); i++) {
+        res = std::max(res, toy_residue(D, src[i], x[i]));
+        a1[ALL] = 0;
+        inverse.apply(src[i], a1);
+        a1[ALL] = a1[X] - x[i][X];
+        dev = std::max(dev, sqrt(a1.squarenorm() / x[i].squarenorm()));
+    }
+    report_pass("Multi-RHS CG, 5 sources in batches of 3", res, 1e-9);
+    report_pass("Multi-RHS CG against CG", dev, 1e-7);
+}
+
+#if NDIM <= 4
+/**
+ * @brief Free Wilson toy operator for the multigrid test
+ * @details D v(X) = v(X) - kappa sum_d [(1 - g_d) v(X+d) + (1 + g_d) v(X-d)] on 4-component
+ * vectors, with hermitian gamma matrices g_d anticommuting with g5 = diag(1,1,-1,-1), thus
+ * D^dagger = g5 D g5.  The lowest mode of D is 1 - 2 NDIM kappa.
+ */
+class toy_wilson {
+  public:
+    using vector_type = Vector<4, Complex<double>>;
+    using matrix_type = SquareMatrix<4, Complex<double>>;
+    Parity par = ALL;
+    double kappa;
+
+    toy_wilson(double k) : kappa(k) {
+        // chiral representation, g_k = ((0, -i sigma_k), (i sigma_k, 0)), g_4 = ((0, 1), (1, 0))
+        const Complex<double> I(0, 1);
+        SquareMatrix<2, Complex<double>> sigma[3];
+        for (auto &sm : sigma)
+            sm = 0;
+        sigma[0].e(0, 1) = sigma[0].e(1, 0) = 1;
+        sigma[1].e(0, 1) = -I;
+        sigma[1].e(1, 0) = I;
+        sigma[2].e(0, 0) = 1;
+        sigma[2].e(1, 1) = -1;
+
+        foralldir (d) {
+            gamma[d] = 0;
+            for (int i = 0; i < 2; i++)
+                for (int j = 0; j < 2; j++) {
+                    if (d < 3) {
+                        gamma[d].e(i, j + 2) = -I * sigma[d].e(i, j);
+                        gamma[d].e(i + 2, j) = I * sigma[d].e(i, j);
+                    } else if (i == j) {
+                        gamma[d].e(i, j + 2) = gamma[d].e(i + 2, j) = 1;
+                    }
+                }
+        }
+        g5 = 0;
+        g5.e(0, 0) = g5.e(1, 1) = 1;
+        g5.e(2, 2) = g5.e(3, 3) = -1;
+    }
+
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        hop(in, out, 1);
+    }
+    void dagger(const Field<vector_type> &in, Field<vector_type> &out) {
+        hop(in, out, -1);
+    }
+
+    /// out(X) = H_dir in(X + dir), the hopping term from direction dir
+    void hop_direction(const Field<vector_type> &in, Field<vector_type> &out, Direction dir) {
+        matrix_type h = projector(abs(dir), is_up_dir(dir) ? 1 : -1);
+        out[ALL] = h * in[X + dir];
+    }
+
+    void apply_gamma5(const Field<vector_type> &in, Field<vector_type> &out) {
+        matrix_type g = g5;
+        out[ALL] = g * in[X];
+    }
+
+  private:
+    matrix_type gamma[NDIM], g5;
+
+    // -kappa (1 - sign g_d)
+    matrix_type projector(Direction d, int sign) const {
+        matrix_type p;
+        p = 1;
+        p -= sign * gamma[d];
+        return -kappa * p;
+    }
+
+    void hop(const Field<vector_type> &in, Field<vector_type> &out, int sign) {
+        out[ALL] = in[X];
+        foralldir (d) {
+            matrix_type hp = projector(d, sign), hm = projector(d, -sign);
+            out[ALL] += hp * in[X + d] + hm * in[X - d];
+        }
+    }
+};
+#endif
+
+/**
+ * @brief Test gamma5 hermiticity of the Wilson toy operator
+ * @details <y, D x> = <g5 D g5 y, x> holds only if the backward hopping term is the adjoint
+ * of the forward one, the property broken by the old backward term of Dirac_Wilson.  The
+ * dagger() of the operator must agree with g5 D g5 as well.
+ */
+void test_gamma5_hermiticity() {
+#if NDIM <= 4
+    using vec_t = toy_wilson::vector_type;
+    toy_wilson D(0.12);
+    Field<vec_t> x, y, Dx, t, g5Dg5y, Ddy;
+    x.gaussian_random();
+    y.gaussian_random();
+
+    D.apply(x, Dx);
+    D.apply_gamma5(y, t);
+    D.apply(t, g5Dg5y);
+    D.apply_gamma5(g5Dg5y, t);
+    g5Dg5y = t;
+    D.dagger(y, Ddy);
+
+    Complex<double> lhs = 0, rhs = 0;
+    double diff = 0;
+    onsites (ALL) {
+        lhs += y[X].dot(Dx[X]);
+        rhs += g5Dg5y[X].dot(x[X]);
+        diff += (g5Dg5y[X] - Ddy[X]).squarenorm();
+    }
+    report_pass("Wilson toy operator <y, D x> = <g5 D g5 y, x>",
+                abs(lhs - rhs) / abs(lhs), 1e-12);
+    report_pass("Wilson toy operator dagger = g5 D g5", sqrt(diff / Ddy.squarenorm()), 1e-14);
+#endif
+}
+
+/**
+ * @brief Test the multigrid solver
+ * @details Checks that the coarse operator is P^dagger D P, and solves D^dagger D x = b for the
+ * free Wilson toy operator approaching the critical kappa = 1/(2 NDIM).  The solution must reach the accuracy, and the number of iterations must
+ * stay flat while the lowest mode of D drops by a factor of 10.
+ */
+void test_multigrid() {
+#if NDIM <= 4
+    CoordinateVector blocking;
+    blocking.fill(2);
+    if (!lattice.can_block(blocking)) {
+        hila::out0 << " ...  Skipping multigrid test, lattice cannot be blocked by 2\n";
+        return;
+    }
+
+    using vec_t = toy_wilson::vector_type;
+    Field<vec_t> src, x, Dx, DDx;
+    src.gaussian_random();
+
+    double res = 0, coarse_diff = 0;
+    std::vector<int> iters;
+    for (double mass : {0.1, 0.04, 0.01}) {
+        toy_wilson D((1 - mass) / (2 * NDIM));
+        using multigrid = multigrid_GCR<toy_wilson, 4>;
+        multigrid mg(D, blocking, 1e-10);
+        mg.setup();
+
+        // the coarse operator is the restriction of D, D_c = P^dagger D P
+        {
+            Field<multigrid::coarse_vector_type> c, Dc, RDPc;
+            Field<vec_t> pc, qc;
+            mg.restrict_vector(src, c);
+            mg.prolong_vector(c, pc);
+            D.apply(pc, Dx);
+            mg.restrict_vector(Dx, RDPc);
+            mg.apply_coarse(c, Dc);
+            mg.prolong_vector(Dc, pc);
+            mg.prolong_vector(RDPc, qc);
+            pc[ALL] = pc[X] - qc[X];
+            coarse_diff = std::max(coarse_diff, sqrt(pc.squarenorm() / qc.squarenorm()));
+        }
+
+        x[ALL] = 0;
+        mg.apply(src, x);
+        iters.push_back(mg.iterations);
+
+        D.apply(x, Dx);
+        D.dagger(Dx, DDx);
+        DDx[ALL] = src[X] - DDx[X];
+        res = std::max(res, sqrt(DDx.squarenorm() / src.squarenorm()));
+    }
+    hila::out0 << "Multigrid iterations at masses 0.1, 0.04, 0.01: " << iters[0] << ", "
+               << iters[1] << ", " << iters[2] << '\n';
+
+    report_pass("Multigrid coarse operator P^dagger D P", coarse_diff, 1e-12);
+    report_pass("Multigrid D^dagger D solution", res, 1e-7);
+    report_pass("Multigrid iterations flat in kappa", (double)iters[2] / iters[0] - 1, 1.0);
+
+    // a zero source must give a zero solution, not NaN
+    toy_wilson D(0.12);
+    GCR<toy_wilson> inverse(D, 1e-10, 100);
+    src[ALL] = 0;
+    x.gaussian_random();
+    inverse.apply(src, x);
+    report_pass("GCR with a zero source", x.squarenorm(), 1e-30);
+#endif
+}
 
 /**
  * @brief Test min and max operations on fields
@@ -755,6 +1332,149 @@ void test_field_slices() {
     }
 }
 
+//--------------------------------------------------------------------------------
+
+/**
+ * @brief Test binary field I/O
+ * @details Write with the rank 0 method and read with collective MPI-IO, and vice versa.
+ */
+void test_field_io() {
+
+    const std::string fname("healthcheck_io.tmp");
+    bool parallel_io = hila::get_parallel_io();
+
+    Field<Complex<double>> f, g;
+    f.gaussian_random();
+
+    for (int mode = 0; mode < 2; mode++) {
+        hila::set_parallel_io(mode == 0);
+        f.write(fname);
+        hila::set_parallel_io(mode == 1);
+        g.read(fname);
+
+        double diff = 0;
+        onsites (ALL) diff += squarenorm(f[X] - g[X]);
+        report_pass(mode == 0 ? "Field MPI-IO write, rank 0 read" : "Field rank 0 write, MPI-IO read",
+                    diff, 1e-20);
+    }
+
+    // checksum must agree after I/O, and change if a single site changes
+    uint64_t cs = f.checksum();
+    int csdiff = (cs != g.checksum());
+    g[CoordinateVector(0)] += 1;
+    csdiff += (cs == g.checksum());
+    report_pass("Field checksum", csdiff, 0.5);
+
+    // slice output: parallel and rank 0 modes must produce identical files
+    const std::string fname2("healthcheck_io2.tmp");
+    CoordinateVector slice;
+    slice.fill(-1);
+    slice[e_y] = lattice.size(e_y) / 2;
+    for (int binary = 0; binary < 2; binary++) {
+        hila::set_parallel_io(false);
+        f.write_slice(fname, slice, 8, binary);
+        hila::set_parallel_io(true);
+        f.write_slice(fname2, slice, 8, binary);
+
+        int differ = 0;
+        if (hila::myrank() == 0) {
+            std::ifstream f1(fname, std::ios::binary), f2(fname2, std::ios::binary);
+            std::istreambuf_iterator<char> end;
+            differ = !std::equal(std::istreambuf_iterator<char>(f1), end,
+                                 std::istreambuf_iterator<char>(f2), end);
+            filesys_ns::remove(fname2);
+        }
+        hila::broadcast(differ);
+        report_pass(binary ? "parallel binary write_slice" : "parallel text write_slice", differ,
+                    0.5);
+    }
+
+    // read a file of smaller lattice, replicating it to fill the lattice
+    CoordinateVector blocking;
+    blocking.fill(2);
+    if (lattice.can_block(blocking)) {
+        lattice.block(blocking);
+        CoordinateVector insize = lattice.size();
+        Field<CoordinateVector> cf;
+        cf[ALL] = X.coordinates();
+        hila::set_parallel_io(true);
+        cf.write(fname);
+        lattice.unblock();
+
+        Field<CoordinateVector> rf;
+        MPI_File fh;
+        hila::open_mpi_input_file(fname, fh);
+        rf.read_at(fh, 0, insize);
+        hila::close_mpi_file(fname, fh);
+
+        int64_t diff = 0;
+        onsites (ALL) {
+            foralldir (d)
+                diff += abs(rf[X][d] - X.coordinate(d) % insize[d]);
+        }
+        report_pass("Field MPI-IO read with replication", diff, 1e-5);
+    }
+
+    // compact SU(N) config format: N-1 rows, double and single precision
+    GaugeField<SU<3, double>> U, V;
+    foralldir (d) {
+        onsites (ALL)
+            U[d][X].random();
+    }
+    for (int sp = 0; sp < 2; sp++) {
+        for (int mode = 0; mode < 2; mode++) {
+            hila::set_parallel_io(mode == 1);
+            U.config_write(fname, true, sp == 1);
+            V.config_read(fname);
+
+            double diff = 0;
+            foralldir (d) {
+                onsites (ALL)
+                    diff += (U[d][X] - V[d][X]).squarenorm();
+            }
+            diff /= lattice.volume() * NDIM;
+            std::string msg = std::string("compact config, ") + (sp ? "single" : "double") +
+                              " precision, " + (mode ? "MPI-IO" : "rank 0") + " I/O";
+            report_pass(msg, diff, sp ? 1e-10 : 1e-24);
+        }
+    }
+
+    // config files with the optional checksum, verified by config_read()
+    for (int compact = 0; compact < 2; compact++) {
+        U.config_write(fname, compact == 1, false, true);
+        V.config_read(fname);
+
+        double diff = 0;
+        foralldir (d) {
+            onsites (ALL)
+                diff += (U[d][X] - V[d][X]).squarenorm();
+        }
+        diff /= lattice.volume() * NDIM;
+        report_pass(std::string(compact ? "compact" : "full") + " config with checksum", diff,
+                    1e-24);
+    }
+
+#if NDIM == 4
+    // ILDG format, 64 and 32 bits
+    for (int prec = 64; prec >= 32; prec -= 32) {
+        U.ildg_write(fname, prec);
+        V.ildg_read(fname);
+
+        double diff = 0;
+        foralldir (d) {
+            onsites (ALL)
+                diff += (U[d][X] - V[d][X]).squarenorm();
+        }
+        diff /= lattice.volume() * NDIM;
+        report_pass("ILDG config, " + std::to_string(prec) + " bits", diff,
+                    prec == 64 ? 1e-28 : 1e-12);
+    }
+#endif
+
+    hila::set_parallel_io(parallel_io);
+    if (hila::myrank() == 0)
+        filesys_ns::remove(fname);
+}
 
 /**
  * @brief Test matrix operations
@@ -1019,6 +1739,29 @@ void test_clusters() {
             double types = abs(cl[0].type() - 1) + abs(cl[1].type() - 2) + abs(cl[2].type() - 3);
             report_pass("Cluster test: cluster types ", types, 1e-10);
 
+            // distributed mode must give the same clusters
+            hila::Clusters dcl;
+            dcl.set_distributed();
+            dcl.find(m);
+            auto hist = dcl.size_histogram(lattice.volume());
+            double dsize = fabs(dcl.number() - 3.0) + fabs(dcl.cluster_size(cl[2].label()) - 9.0);
+            for (auto c : cl)
+                hist[c.size()]--;
+            for (auto h : hist)
+                dsize += fabs(h);
+            report_pass("Cluster test: distributed cluster sizes ", dsize, 1e-10);
+
+            double darea = 0;
+            for (auto c : cl)
+                darea += fabs(dcl.cluster_area(c.label()) - c.area());
+            report_pass("Cluster test: distributed cluster areas ", darea, 1e-10);
+
+            dcl.make_full_list();
+            double dlabels = 0;
+            for (int i = 0; i < 3; i++)
+                dlabels += (dcl[i].label() != cl[i].label());
+            report_pass("Cluster test: distributed full list ", dlabels, 1e-10);
+
 #if NDIM == 3
             double area = abs(cl[0].area() - 4 * lattice.size(e_z)) +
                           abs(cl[1].area() - 4 * lattice.size(e_y)) +
@@ -1182,10 +1925,21 @@ int main(int argc, char **argv) {
     test_reductions();
     test_functions();
     test_site_access();
+    test_shift();
+    test_mpi_progress();
+    test_halo_compression();
+    test_cg_halo_precision();
+    test_cg_mixed();
+    test_multishift_cg();
+    test_cg_pipelined();
+    test_cg_multi();
+    test_gamma5_hermiticity();
+    test_multigrid();
     test_minmax();
     test_random();
     test_set_elements_and_select();
     test_subvolumes();
+    test_field_io();
     test_matrix_operations();
     test_element_operations();
     test_fft();
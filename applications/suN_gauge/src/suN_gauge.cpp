@@ -251,9 +251,12 @@ int main(int argc, char **argv) {
 
         go = !hila::time_to_finish();
         if (!go || (p.n_save > 0 && (trajectory + 1) % p.n_save == 0)) {
-            checkpoint(U, p.config_file, p.n_trajectories, trajectory);
+            checkpoint_async(U, p.config_file, p.n_trajectories, trajectory);
         }
     }
 
+    // let the last checkpoint finish
+    wait_checkpoint();
+
     hila::finishrun();
 }
@@ -12,7 +12,8 @@
 constexpr int N = 2;
 
 template <typename fermion_action, typename dirac, typename gauge_field_type>
-void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
+void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge,
+                  Direction fdir = e_x) {
     using sun = typename gauge_field_type::fund_type;
     using forcetype = SquareMatrix<gauge_field_type::N, Complex<double>>;
     Field<forcetype> force[NDIM];
@@ -26,7 +27,7 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
 
         CoordinateVector coord(0);
 
-        sun g1 = gauge.get_gauge(0).get_element(coord);
+        sun g1 = gauge.get_gauge(fdir).get_element(coord);
         sun h = sun(1) + Complex<double>(0, eps) * sun::generator(ng);
         sun g12 = h * g1;
 
@@ -48,20 +49,20 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
         D.apply(psi, tmp);
         onsites(D.par) { s1 += chi[X].rdot(tmp[X]); }
 
-        gauge.get_gauge(0).set_element(g12, coord);
+        gauge.get_gauge(fdir).set_element(g12, coord);
         gauge.refresh();
 
         double s2 = 0;
         D.apply(psi, tmp);
         onsites(D.par) { s2 += chi[X].rdot(tmp[X]); }
 
-        gauge.get_gauge(0).set_element(g1, coord);
+        gauge.get_gauge(fdir).set_element(g1, coord);
         gauge.refresh();
 
         D.force(chi, psi, force, 1);
 
         gauge.add_momentum(force);
-        sun f = gauge.get_momentum(0).get_element(coord);
+        sun f = gauge.get_momentum(fdir).get_element(coord);
         double f1 = (s2 - s1) / eps;
         double f2 = (f * Complex<double>(0, 1) * sun::generator(ng)).trace().re;
         double diff = f2 - f1;
@@ -85,19 +86,19 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
         D.dagger(psi, tmp);
         onsites(D.par) { s1 += chi[X].rdot(tmp[X]); }
 
-        gauge.get_gauge(0).set_element(g12, coord);
+        gauge.get_gauge(fdir).set_element(g12, coord);
         gauge.refresh();
 
         s2 = 0;
         D.dagger(psi, tmp);
         onsites(D.par) { s2 += chi[X].rdot(tmp[X]); }
 
-        gauge.get_gauge(0).set_element(g1, coord);
+        gauge.get_gauge(fdir).set_element(g1, coord);
         gauge.refresh();
 
         D.force(chi, psi, force, -1);
         gauge.add_momentum(force);
-        f = gauge.get_momentum(0).get_element(coord);
+        f = gauge.get_momentum(fdir).get_element(coord);
         f1 = (s2 - s1) / eps;
         f2 = (f * Complex<double>(0, 1) * sun::generator(ng)).trace().re;
         diff = f2 - f1;
@@ -116,11 +117,11 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
         sf1[ALL] = 0;
         sf2[ALL] = 0;
 
-        gauge.get_gauge(0).set_element(g12, coord);
+        gauge.get_gauge(fdir).set_element(g12, coord);
         gauge.refresh();
         fa.action(sf2);
 
-        gauge.get_gauge(0).set_element(g1, coord);
+        gauge.get_gauge(fdir).set_element(g1, coord);
         gauge.refresh();
         fa.action(sf1);
 
@@ -133,7 +134,7 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
         }
 
         fa.force_step(1.0);
-        f = gauge.get_momentum(0).get_element(coord);
+        f = gauge.get_momentum(fdir).get_element(coord);
         f1 = dS / eps;
         f2 = (f * Complex<double>(0, 1) * sun::generator(ng)).trace().re;
         diff = f2 - f1;
@@ -149,6 +150,35 @@ void check_forces(fermion_action &fa, dirac &D, gauge_field_type &gauge) {
     }
 }
 
+/// Check D^dagger = gamma5 D gamma5 for the Wilson operator, which tests the forward
+/// and backward hopping terms against each other
+template <typename dirac>
+void check_gamma5_hermiticity(dirac &D) {
+#if NDIM == 4
+    Field<typename dirac::vector_type> a, Da, g5a, Dg5a;
+    a.set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
+    a.set_boundary_condition(-e_t, hila::bc::ANTIPERIODIC);
+    Da.copy_boundary_condition(a);
+    g5a.copy_boundary_condition(a);
+    Dg5a.copy_boundary_condition(a);
+
+    a[ALL] = 0;
+    onsites(D.par) {
+        a[X].gaussian_random();
+    }
+    D.dagger(a, Da);
+    g5a[ALL] = gamma5 * a[X];
+    D.apply(g5a, Dg5a);
+
+    double diff = 0, norm = 0;
+    onsites(D.par) {
+        diff += squarenorm(Da[X] - gamma5 * Dg5a[X]);
+        norm += squarenorm(Da[X]);
+    }
+    assert(diff < 1e-20 * norm && "D^dagger = gamma5 D gamma5");
+#endif
+}
+
 int main(int argc, char **argv) {
 
 /* Use a smaller lattice size since
@@ -277,8 +307,11 @@ int main(int argc, char **argv) {
     {
         hila::out0 << "Checking Wilson forces:\n";
         Dirac_Wilson D(0.05, gauge);
+        check_gamma5_hermiticity(D);
         fermion_action fa(D, gauge);
         check_forces(fa, D, gauge);
+        // and a link in the last direction
+        check_forces(fa, D, gauge, Direction(NDIM - 1));
     }
 
     {
@@ -294,6 +327,15 @@ int main(int argc, char **argv) {
         hila::out0 << "Checking hasenbusch 2:\n";
         Hasenbusch_action_2 fa2(D, gauge, 0);
         check_forces(fa2, D, gauge);
+
+        // the force must match the action for any rational function
+        hila::out0 << "Checking rational HMC action:\n";
+        rational_approximation r;
+        r.norm = 0.1;
+        r.residues = {0.5, 0.3, 0.05};
+        r.poles = {0.01, 0.1, 1.0};
+        rational_fermion_action fa3(D, gauge, r, r);
+        check_forces(fa3, D, gauge);
     }
 
     {
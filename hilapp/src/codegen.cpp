@@ -264,7 +264,8 @@ void TopLevelVisitor::generate_code(Stmt *S) {
                              << loop_info.parity_str << ");\n";
                     } else {
                         if (first)
-                            code << "dir_mask_t  _dir_mask_ = 0;\n";
+                            code << "dir_mask_t  _dir_mask_ = 0;\n"
+                                 << "hila::gather_batch.begin();\n";
                         first = false;
 
                         code << "_dir_mask_ |= " << l.new_name << ".start_gather(" << d.direxpr_s
@@ -281,7 +282,8 @@ void TopLevelVisitor::generate_code(Stmt *S) {
                      << ");\n}\n";
             } else {
                 if (first)
-                    code << "dir_mask_t  _dir_mask_ = 0;\n";
+                    code << "dir_mask_t  _dir_mask_ = 0;\n"
+                         << "hila::gather_batch.begin();\n";
                 first = false;
                 code << "for (Direction HILA_dir_ = (Direction)0; HILA_dir_ < NDIRS; "
                         "++HILA_dir_) {\n"
@@ -303,6 +305,8 @@ void TopLevelVisitor::generate_code(Stmt *S) {
 
     if (first)
         generate_wait_loops = false; // no communication needed in the 1st place
+    else if (generate_wait_loops)
+        code << "hila::gather_batch.flush();\n"; // send the halos collected above
 
     /////////////////////////////////////////////////////////////////////
     // make the reduction expr list from variables and loop const expressions
@@ -99,6 +99,7 @@ class Alg_gen {
  * - SU::make_unitary
  * - SU::fix_det
  * - SU::reunitarize
+ * - SU::reconstruct_last_row
  * - SU::random
  * - SU::project_to_algebra
  *
@@ -182,6 +183,37 @@ class SU : public Matrix_t<N, N, Complex<T>, SU<N, T>> {
         return *this;
     }
 
+    /**
+     * @brief Reconstruct the last row from the other N-1 rows
+     * @details For a special unitary matrix the last row is the complex conjugate of its
+     * cofactors. Used when only N-1 rows are stored, see GaugeField::config_write().
+     *
+     * @return const SU&
+     */
+    const SU &reconstruct_last_row() {
+        static_assert(N >= 2, "reconstruct_last_row() requires N >= 2");
+        if constexpr (N == 2) {
+            this->e(1, 0) = -::conj(this->e(0, 1));
+            this->e(1, 1) = ::conj(this->e(0, 0));
+        } else {
+            Matrix<N - 1, N - 1, Complex<T>> sub;
+            for (int j = 0; j < N; j++) {
+                // submatrix without the last row and column j
+                for (int r = 0; r < N - 1; r++) {
+                    for (int c = 0, k = 0; c < N; c++) {
+                        if (c != j)
+                            sub.e(r, k++) = this->e(r, c);
+                    }
+                }
+                Complex<T> cof = sub.det();
+                if ((N - 1 + j) % 2)
+                    cof = -cof;
+                this->e(N - 1, j) = ::conj(cof);
+            }
+        }
+        return *this;
+    }
+
     /**
      * @brief Reunitarize SU(N) matrix
      * @details Steps to reunitarize are:
@@ -736,6 +768,30 @@ void project_to_algebra_bilinear(const MT (&w)[N][N],
 
 namespace hila {
 
+/// SU(N) halo compression: the first N-1 rows are sent, the last row is reconstructed
+/// from unitarity.  For SU(3) this is 2/3 of the full matrix.
+template <int N, typename T>
+struct halo_compression<SU<N, T>> {
+    static constexpr bool is_compressible = (N >= 2);
+    static constexpr size_t compressed_size = (N - 1) * N * sizeof(Complex<T>);
+
+    static void compress(const SU<N, T> &v, void *buf) {
+        Complex<T> *c = static_cast<Complex<T> *>(buf);
+        for (int i = 0; i < N - 1; i++)
+            for (int j = 0; j < N; j++)
+                c[i * N + j] = v.e(i, j);
+    }
+
+    static void decompress(const void *buf, SU<N, T> &v) {
+        const Complex<T> *c = static_cast<const Complex<T> *>(buf);
+        for (int i = 0; i < N - 1; i++)
+            for (int j = 0; j < N; j++)
+                v.e(i, j) = c[i * N + j];
+        if constexpr (N >= 2)
+            v.reconstruct_last_row();
+    }
+};
+
 ///
 /// Function hila::random(SU<N,T> & m), equivalent to m.random()
 // template <int N, typename T>
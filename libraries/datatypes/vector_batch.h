@@ -0,0 +1,189 @@
+#ifndef VECTOR_BATCH_H_
+#define VECTOR_BATCH_H_
+
+#include "matrix.h"
+
+/// Define type VectorBatch<K,V>
+
+/**
+ * @brief A batch of K vectors of type V at a site
+ *
+ * @details Fields of VectorBatch let an operator act on K right hand sides in one sweep.
+ * A matrix multiplying a batch is applied to each of the K vectors, so e.g. a gauge link
+ * of a Dirac operator is loaded from memory once for all K vectors.  Arithmetic acts on
+ * the vectors separately; per-vector coefficients are applied through the element access
+ * v[k].
+ *
+ * @tparam K number of vectors
+ * @tparam V vector type, e.g. Vector<N, Complex<double>> or WilsonVector<N, double>
+ */
+template <int K, typename V>
+class VectorBatch {
+
+  public:
+    // std incantation for field types
+    using base_type = hila::arithmetic_type<V>;
+    using argument_type = V;
+
+    V v[K];
+
+    /// Define default constructors to ensure std::is_trivial
+    VectorBatch() = default;
+    ~VectorBatch() = default;
+    VectorBatch(const VectorBatch &b) = default;
+
+    /// construct from 0
+    inline VectorBatch(const std::nullptr_t &z) {
+        for (int k = 0; k < K; k++)
+            v[k] = 0;
+    }
+
+    /// and from a batch of different vector type
+    template <typename A>
+    inline VectorBatch(const VectorBatch<K, A> &b) {
+        for (int k = 0; k < K; k++)
+            v[k] = b.v[k];
+    }
+
+    /// number of vectors in the batch
+    static constexpr int size() {
+        return K;
+    }
+
+    inline V &operator[](const int k) {
+        return v[k];
+    }
+    inline const V &operator[](const int k) const {
+        return v[k];
+    }
+
+    /// unary -
+    inline VectorBatch operator-() const {
+        VectorBatch res;
+        for (int k = 0; k < K; k++)
+            res.v[k] = -v[k];
+        return res;
+    }
+
+    /// unary +
+    inline const VectorBatch &operator+() const {
+        return *this;
+    }
+
+    /// assign from 0
+    inline VectorBatch &operator=(const std::nullptr_t &z) out_only {
+        for (int k = 0; k < K; k++)
+            v[k] = 0;
+        return *this;
+    }
+
+    /// assign from batch of different vector type
+    template <typename A>
+    inline VectorBatch &operator=(const VectorBatch<K, A> &rhs) out_only {
+        for (int k = 0; k < K; k++)
+            v[k] = rhs.v[k];
+        return *this;
+    }
+
+    /// add assign
+    template <typename A>
+    inline VectorBatch &operator+=(const VectorBatch<K, A> &rhs) {
+        for (int k = 0; k < K; k++)
+            v[k] += rhs.v[k];
+        return *this;
+    }
+
+    /// subtract assign
+    template <typename A>
+    inline VectorBatch &operator-=(const VectorBatch<K, A> &rhs) {
+        for (int k = 0; k < K; k++)
+            v[k] -= rhs.v[k];
+        return *this;
+    }
+
+    /// multiply assign by scalar
+    template <typename S, std::enable_if_t<hila::is_complex_or_arithmetic<S>::value, int> = 0>
+    inline VectorBatch &operator*=(const S rhs) {
+        for (int k = 0; k < K; k++)
+            v[k] *= rhs;
+        return *this;
+    }
+
+    /// gaussian random vectors
+    inline VectorBatch &gaussian_random(double width = 1.0) out_only {
+        for (int k = 0; k < K; k++)
+            v[k].gaussian_random(width);
+        return *this;
+    }
+
+    /// square norm of the whole batch
+    inline double squarenorm() const {
+        double r = 0;
+        for (int k = 0; k < K; k++)
+            r += v[k].squarenorm();
+        return r;
+    }
+
+    /// square norms of the vectors, one for each
+    inline Vector<K, double> squarenorms() const {
+        Vector<K, double> r;
+        for (int k = 0; k < K; k++)
+            r.e(k) = v[k].squarenorm();
+        return r;
+    }
+
+    std::string str(int prec = 8, char separator = ' ') const {
+        std::string text = "";
+        for (int k = 0; k < K; k++)
+            text += hila::prettyprint(v[k], prec) + "\n";
+        return text;
+    }
+};
+
+/// batch + batch
+template <int K, typename A, typename B, typename R = hila::type_plus<A, B>>
+inline VectorBatch<K, R> operator+(const VectorBatch<K, A> &a, const VectorBatch<K, B> &b) {
+    VectorBatch<K, R> res;
+    for (int k = 0; k < K; k++)
+        res.v[k] = a.v[k] + b.v[k];
+    return res;
+}
+
+/// batch - batch
+template <int K, typename A, typename B, typename R = hila::type_minus<A, B>>
+inline VectorBatch<K, R> operator-(const VectorBatch<K, A> &a, const VectorBatch<K, B> &b) {
+    VectorBatch<K, R> res;
+    for (int k = 0; k < K; k++)
+        res.v[k] = a.v[k] - b.v[k];
+    return res;
+}
+
+/// m * batch, where m is a scalar or a matrix.  The matrix is applied to each vector,
+/// loading it only once.
+template <typename M, int K, typename V,
+          typename R = decltype(std::declval<const M &>() * std::declval<const V &>())>
+inline VectorBatch<K, R> operator*(const M &m, const VectorBatch<K, V> &b) {
+    VectorBatch<K, R> res;
+    for (int k = 0; k < K; k++)
+        res.v[k] = m * b.v[k];
+    return res;
+}
+
+/// batch * scalar
+template <int K, typename V, typename S,
+          std::enable_if_t<hila::is_complex_or_arithmetic<S>::value, int> = 0,
+          typename R = decltype(std::declval<const V &>() * std::declval<const S &>())>
+inline VectorBatch<K, R> operator*(const VectorBatch<K, V> &b, const S &s) {
+    VectorBatch<K, R> res;
+    for (int k = 0; k < K; k++)
+        res.v[k] = b.v[k] * s;
+    return res;
+}
+
+/// square norm of the whole batch
+template <int K, typename V>
+inline double squarenorm(const VectorBatch<K, V> &b) {
+    return b.squarenorm();
+}
+
+#endif
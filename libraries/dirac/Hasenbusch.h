@@ -35,6 +35,11 @@ template <typename Dirac_type> class Hasenbusch_operator {
         par = D.par;
     }
 
+    /// Precision of the halo messages, passed on to the Dirac operator
+    void set_halo_precision(hila::halo_precision prec) {
+        D.set_halo_precision(prec);
+    }
+
     inline void apply(const Field<vector_type> &in, Field<vector_type> &out) {
         D.apply(in, out);
         out[D.par] = out[X] + h_parameter * in[X];
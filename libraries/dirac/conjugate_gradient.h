@@ -11,9 +11,25 @@
 
 #include <sstream>
 #include <iostream>
+#include <sys/time.h>
+#include "hila.h"
+#include "datatypes/vector_batch.h"
 
 constexpr int CG_DEFAULT_MAXITERS = 10000;
 constexpr double CG_DEFAULT_ACCURACY = 1e-12;
+constexpr double CG_DEFAULT_RELIABLE_DELTA = 0.1;
+/// With reduced precision halos, switch to full precision if the residue has not
+/// reached a new minimum in this many iterations
+constexpr int CG_HALO_PRECISION_STALL_ITERS = 20;
+/// GCR restarts when a new direction |M z|^2 is below this fraction of the residue
+constexpr double GCR_BREAKDOWN = 1e-24;
+
+/// Detect operators with reduced precision halos, set_halo_precision(hila::halo_precision)
+template <typename Op, typename = void>
+struct CG_has_halo_precision : std::false_type {};
+template <typename Op>
+struct CG_has_halo_precision<Op, std::void_t<decltype(std::declval<Op &>().set_halo_precision(
+                                     hila::halo_precision::FULL))>> : std::true_type {};
 
 /// The conjugate gradient operator. Applies the inverse square of an operator on a vector
 template <typename Op> class CG {
@@ -24,11 +40,27 @@ template <typename Op> class CG {
     double accuracy = CG_DEFAULT_ACCURACY;
     // maximum number of iterations
     double maxiters = CG_DEFAULT_MAXITERS;
+    // halo precision in the early iterations, and the relative residue where
+    // the iteration switches to full precision
+    hila::halo_precision halo_prec = hila::halo_precision::FULL;
+    double halo_switch_residue = 0;
 
   public:
     /// Get the type the operator applies to
     using vector_type = typename Op::vector_type;
 
+  private:
+    // set the halo precision of the operator and the work fields
+    void set_work_precision(hila::halo_precision prec, Field<vector_type> &p,
+                            Field<vector_type> &Dp, Field<vector_type> &DDp) {
+        if constexpr (CG_has_halo_precision<Op>::value)
+            M.set_halo_precision(prec);
+        p.set_halo_precision(prec);
+        Dp.set_halo_precision(prec);
+        DDp.set_halo_precision(prec);
+    }
+
+  public:
     /// Constructor: initialize the operator
     CG(Op &op) : M(op){};
     /// Constructor: operator and accuracy
@@ -39,6 +71,21 @@ template <typename Op> class CG {
         maxiters = _maxiters;
     };
 
+    /// Run the early iterations with halos in reduced precision, see
+    /// Field::set_halo_precision.  When the relative residue drops below
+    /// switch_residue the halos go back to full precision, the true residual
+    /// is recomputed and the iteration restarts from it.  Small switch_residue
+    /// saves more communication but may cost extra iterations.  By default
+    /// switch_residue is 1e-5 for SINGLE and 1e-2 for HALF, which has only 8 bits of
+    /// mantissa.  The switch is also done if the residue stops decreasing, see
+    /// CG_HALO_PRECISION_STALL_ITERS.
+    void set_halo_precision(hila::halo_precision prec, double switch_residue = -1) {
+        halo_prec = prec;
+        if (switch_residue < 0)
+            switch_residue = (prec == hila::halo_precision::HALF) ? 1e-2 : 1e-5;
+        halo_switch_residue = switch_residue;
+    }
+
     /// The apply() -member runs the full conjugate gradient
     /// The operators themselves have the same structure.
     /// The conjugate gradient operator is Hermitean, so there is
@@ -55,12 +102,14 @@ template <typename Op> class CG {
         double pDp = 0, rr = 0, rrnew = 0, rr_start = 0;
         double alpha, beta;
         double target_rr, source_norm = 0;
+        bool reduced = (halo_prec != hila::halo_precision::FULL);
 
         gettimeofday(&start, NULL);
 
         onsites(M.par) { source_norm += squarenorm(in[X]); }
 
         target_rr = accuracy * accuracy * source_norm;
+        double switch_rr = halo_switch_residue * halo_switch_residue * source_norm;
 
         M.apply(out, Dp);
         M.dagger(Dp, DDp);
@@ -72,6 +121,12 @@ template <typename Op> class CG {
         onsites(M.par) { rr += squarenorm(r[X]); }
         rr_start = rr;
 
+        if (reduced)
+            set_work_precision(halo_prec, p, Dp, DDp);
+        // smallest residue in reduced precision, and the iteration where it was reached
+        double rr_min = rr;
+        int i_min = 0;
+
         for (i = 0; i < maxiters; i++) {
             pDp = rrnew = 0;
             M.apply(p, Dp);
@@ -88,6 +143,29 @@ template <typename Op> class CG {
 #ifdef DEBUG_CG
             hila::out0 << "CG step " i << ", residue " << sqrt(rrnew / target_rr) << "\n";
 #endif
+            if (reduced && rrnew < rr_min) {
+                rr_min = rrnew;
+                i_min = i;
+            }
+            if (reduced && (rrnew < switch_rr || rrnew < target_rr ||
+                            i - i_min >= CG_HALO_PRECISION_STALL_ITERS)) {
+                // back to full precision: the iterated residual has drifted,
+                // recompute the true one and restart the search direction
+                reduced = false;
+                set_work_precision(hila::halo_precision::FULL, p, Dp, DDp);
+                M.apply(out, Dp);
+                M.dagger(Dp, DDp);
+                rrnew = 0;
+                onsites(M.par) {
+                    r[X] = in[X] - DDp[X];
+                    p[X] = r[X];
+                }
+                onsites(M.par) { rrnew += squarenorm(r[X]); }
+                rr = rrnew;
+                if (rrnew < target_rr)
+                    break;
+                continue;
+            }
             if (rrnew < target_rr)
                 break;
             beta = rrnew / rr;
@@ -95,6 +173,9 @@ template <typename Op> class CG {
             rr = rrnew;
         }
 
+        if (halo_prec != hila::halo_precision::FULL)
+            set_work_precision(hila::halo_precision::FULL, p, Dp, DDp);
+
         gettimeofday(&end, NULL);
         double timing =
             1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
@@ -104,4 +185,759 @@ template <typename Op> class CG {
     }
 };
 
+/// Pipelined conjugate gradient (Ghysels and Vanroose).  A drop-in replacement for
+/// CG<Op> with the same constructors and apply(), intended for runs where the global
+/// reductions dominate, i.e. many MPI ranks with small local volumes.  The iteration
+/// is rearranged so that both inner products of a step are combined into a single
+/// non-blocking reduction, which runs while the operator is applied to the next
+/// vector.  All vector updates are done in a single site loop per iteration.
+///
+/// The price is three extra work vectors and slightly worse rounding properties:
+/// when the recursive residual has converged the true residual is recomputed, and
+/// the iteration restarts from it if it has not reached the accuracy.
+template <typename Op> class CG_pipelined {
+  private:
+    // The operator to invert
+    Op &M;
+    // desired relative accuracy
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+
+    /// Constructor: initialize the operator
+    CG_pipelined(Op &op) : M(op){};
+    /// Constructor: operator and accuracy
+    CG_pipelined(Op &op, double _accuracy) : M(op) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, accuracy and maximum number of iterations
+    CG_pipelined(Op &op, double _accuracy, int _maxiters) : M(op) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// The apply() -member runs the full conjugate gradient, out is the initial guess
+    void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        int i;
+        struct timeval start, end;
+        Field<vector_type> r, w, p, s, z, q, Dw;
+        r.copy_boundary_condition(in);
+        w.copy_boundary_condition(in);
+        p.copy_boundary_condition(in);
+        s.copy_boundary_condition(in);
+        z.copy_boundary_condition(in);
+        q.copy_boundary_condition(in);
+        Dw.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        double gamma = 0, gamma_old = 1, delta, alpha, alpha_old = 1, beta;
+        double target_rr, source_norm = 0;
+        int restarts = 0;
+        bool first = true;
+
+        // (r,r) and (w,r) are batched to one non-blocking collective, started with
+        // start_reduce() and completed only when the values are needed
+        Reduction<double> rr, rw;
+        rr.batched();
+        rw.batched();
+
+        gettimeofday(&start, NULL);
+
+        onsites(M.par) { source_norm += squarenorm(in[X]); }
+        target_rr = accuracy * accuracy * source_norm;
+
+        // r = in - D^dagger D out, w = D^dagger D r
+        M.apply(out, Dw);
+        M.dagger(Dw, q);
+        r[M.par] = in[X] - q[X];
+        p[ALL] = 0;
+        s[ALL] = 0;
+        z[ALL] = 0;
+
+        M.apply(r, Dw);
+        M.dagger(Dw, w);
+        rr = 0;
+        rw = 0;
+        onsites(M.par) {
+            rr += squarenorm(r[X]);
+            rw += real(r[X].dot(w[X]));
+        }
+        rr.start_reduce();
+
+        for (i = 0; i < maxiters; i++) {
+            // q = D^dagger D w, overlapping with the reduction
+            M.apply(w, Dw);
+            M.dagger(Dw, q);
+
+            gamma = rr.value();
+            delta = rw.value();
+#ifdef DEBUG_CG
+            hila::out0 << "Pipelined CG step " << i << ", residue " << sqrt(gamma / target_rr)
+                       << "\n";
+#endif
+            if (gamma < target_rr) {
+                // check the true residual, and restart from it if the recursion has drifted
+                M.apply(out, Dw);
+                M.dagger(Dw, q);
+                gamma = 0;
+                onsites(M.par) {
+                    r[X] = in[X] - q[X];
+                    gamma += squarenorm(r[X]);
+                }
+                if (gamma < target_rr)
+                    break;
+
+                restarts++;
+                first = true;
+                M.apply(r, Dw);
+                M.dagger(Dw, w);
+                rr = 0;
+                rw = 0;
+                onsites(M.par) {
+                    rr += squarenorm(r[X]);
+                    rw += real(r[X].dot(w[X]));
+                }
+                rr.start_reduce();
+                continue;
+            }
+
+            if (first) {
+                beta = 0;
+                alpha = gamma / delta;
+                first = false;
+            } else {
+                beta = gamma / gamma_old;
+                alpha = gamma / (delta - beta * gamma / alpha_old);
+            }
+
+            // all vector updates and the next inner products in one pass
+            rr = 0;
+            rw = 0;
+            onsites(M.par) {
+                z[X] = q[X] + beta * z[X];
+                s[X] = w[X] + beta * s[X];
+                p[X] = r[X] + beta * p[X];
+                out[X] += alpha * p[X];
+                r[X] -= alpha * s[X];
+                w[X] -= alpha * z[X];
+
+                rr += squarenorm(r[X]);
+                rw += real(r[X].dot(w[X]));
+            }
+            rr.start_reduce();
+
+            gamma_old = gamma;
+            alpha_old = alpha;
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        hila::out0 << "Pipelined CG: " << i << " steps, " << restarts << " restarts in "
+                   << timing << "ms, ";
+        hila::out0 << "relative residue:" << gamma / source_norm << "\n";
+    }
+};
+
+/// Mixed precision conjugate gradient with reliable updates.  Applies the inverse
+/// square of Op like CG<Op>, but the Krylov iteration runs with the single precision
+/// operator Op_flt (by default Op::type_flt) on single precision vectors.  The
+/// solution is accumulated to the full precision output and the true residual
+/// recomputed with Op whenever the iterated residual has dropped by the factor
+/// delta since the last update, so the result meets the requested accuracy in
+/// full precision.
+///
+/// The single precision operator is constructed from a single precision copy of the
+/// gauge field:
+///   auto gauge_flt = gauge.get_single_precision();
+///   typename Op::type_flt D_flt(D, gauge_flt);
+///   CG_mixed inverse(D, D_flt);
+template <typename Op, typename Op_flt = typename Op::type_flt> class CG_mixed {
+  private:
+    // The operator to invert and its single precision version
+    Op &M;
+    Op_flt &M_flt;
+    // desired relative accuracy
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+    // relative drop of the iterated residual between reliable updates
+    double delta = CG_DEFAULT_RELIABLE_DELTA;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+    using vector_type_flt = typename Op_flt::vector_type;
+
+    /// Constructor: initialize the operators
+    CG_mixed(Op &op, Op_flt &op_flt) : M(op), M_flt(op_flt){};
+    /// Constructor: operators and accuracy
+    CG_mixed(Op &op, Op_flt &op_flt, double _accuracy) : M(op), M_flt(op_flt) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operators, accuracy and maximum number of iterations
+    CG_mixed(Op &op, Op_flt &op_flt, double _accuracy, int _maxiters)
+        : M(op), M_flt(op_flt) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// Set the reliable update parameter: the true residual is recomputed when the
+    /// iterated one is below delta times the largest iterated residual since the
+    /// previous update.  Larger delta means more full precision operator applications.
+    void set_reliable_update(double _delta) {
+        delta = _delta;
+    }
+
+    /// The apply() -member runs the full conjugate gradient, out is the
+    /// initial guess and the result
+    void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        int i, updates = 0;
+        struct timeval start, end;
+        Field<vector_type> r, Dx, DDx;
+        Field<vector_type_flt> r_f, p_f, x_f, Dp_f, DDp_f;
+        r.copy_boundary_condition(in);
+        Dx.copy_boundary_condition(in);
+        DDx.copy_boundary_condition(in);
+        r_f.copy_boundary_condition(in);
+        p_f.copy_boundary_condition(in);
+        x_f.copy_boundary_condition(in);
+        Dp_f.copy_boundary_condition(in);
+        DDp_f.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        double pDp = 0, rr = 0, rrnew = 0, rr_max = 0;
+        double target_rr, source_norm = 0;
+
+        gettimeofday(&start, NULL);
+
+        onsites(M.par) { source_norm += squarenorm(in[X]); }
+
+        target_rr = accuracy * accuracy * source_norm;
+
+        M.apply(out, Dx);
+        M.dagger(Dx, DDx);
+        onsites(M.par) { r[X] = in[X] - DDx[X]; }
+        onsites(M.par) { rr += squarenorm(r[X]); }
+
+        p_f[ALL] = 0;
+        x_f[ALL] = 0;
+        onsites(M.par) {
+            r_f[X] = r[X];
+            p_f[X] = r_f[X];
+        }
+        rrnew = rr_max = rr;
+
+        for (i = 0; i < maxiters && rr >= target_rr; i++) {
+            pDp = rrnew = 0;
+            M_flt.apply(p_f, Dp_f);
+            M_flt.dagger(Dp_f, DDp_f);
+            onsites(M.par) { pDp += squarenorm(Dp_f[X]); }
+
+            float alpha = rr / pDp;
+
+            onsites(M.par) {
+                x_f[X] = x_f[X] + alpha * p_f[X];
+                r_f[X] = r_f[X] - alpha * DDp_f[X];
+            }
+            onsites(M.par) { rrnew += squarenorm(r_f[X]); }
+#ifdef DEBUG_CG
+            hila::out0 << "Mixed CG step " << i << ", residue " << sqrt(rrnew / target_rr)
+                       << "\n";
+#endif
+            rr_max = std::max(rr_max, rrnew);
+
+            if (rrnew < delta * delta * rr_max || rrnew < target_rr) {
+                // reliable update: move the single precision solution to out and
+                // replace the iterated residual with the true one
+                onsites(M.par) {
+                    out[X] += x_f[X];
+                    x_f[X] = 0;
+                }
+                M.apply(out, Dx);
+                M.dagger(Dx, DDx);
+                rrnew = 0;
+                onsites(M.par) { r[X] = in[X] - DDx[X]; }
+                onsites(M.par) { rrnew += squarenorm(r[X]); }
+                updates++;
+                if (rrnew < target_rr)
+                    break;
+                r_f[M.par] = r[X];
+                rr_max = rrnew;
+            }
+
+            float beta = rrnew / rr;
+            p_f[M.par] = beta * p_f[X] + r_f[X];
+            rr = rrnew;
+        }
+
+        // leftover from the iterations after the last update
+        out[M.par] += x_f[X];
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        hila::out0 << "Mixed precision CG: " << i << " steps, " << updates
+                   << " reliable updates in " << timing << "ms, ";
+        hila::out0 << "relative residue:" << rrnew / source_norm << "\n";
+    }
+};
+
+/// Multi-shift conjugate gradient.  Solves (D^dagger D + shift_i) out_i = in
+/// for all shifts in the Krylov space of the smallest shift, at the cost of
+/// a single CG inversion plus vector updates for each extra shift.  Used for
+/// the rational functions of the RHMC algorithm.  The shifts must be non-negative,
+/// and the solutions start from zero: an initial guess cannot be used.
+/// A shifted system stops updating when it has converged, the iteration ends
+/// when the smallest shift has converged.
+template <typename Op> class multishift_CG {
+  private:
+    // The operator to invert
+    Op &M;
+    // the shifts
+    std::vector<double> shifts;
+    // desired relative accuracy
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+
+    /// Constructor: initialize the operator and the shifts
+    multishift_CG(Op &op, const std::vector<double> &_shifts) : M(op), shifts(_shifts){};
+    /// Constructor: operator, shifts and accuracy
+    multishift_CG(Op &op, const std::vector<double> &_shifts, double _accuracy)
+        : M(op), shifts(_shifts) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, shifts, accuracy and maximum number of iterations
+    multishift_CG(Op &op, const std::vector<double> &_shifts, double _accuracy, int _maxiters)
+        : M(op), shifts(_shifts) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// Solve for all shifts, out[i] is the solution with shifts[i].
+    /// out is resized to the number of shifts.
+    void apply(Field<vector_type> &in, std::vector<Field<vector_type>> &out) {
+        int i;
+        struct timeval start, end;
+        int n_shifts = shifts.size();
+        Field<vector_type> r, Dp, DDp;
+        std::vector<Field<vector_type>> p(n_shifts);
+        r.copy_boundary_condition(in);
+        Dp.copy_boundary_condition(in);
+        DDp.copy_boundary_condition(in);
+
+        // iterate the smallest shift, the others follow
+        int base = 0;
+        for (int s = 1; s < n_shifts; s++) {
+            if (shifts[s] < shifts[base])
+                base = s;
+        }
+        double sigma = shifts[base];
+
+        // zeta: ratio of the shifted and the base residual at this and
+        // the previous step
+        std::vector<double> zeta(n_shifts, 1.0), zeta_old(n_shifts, 1.0);
+        std::vector<bool> converged(n_shifts, false);
+        double pDp, rr = 0, rrnew = 0;
+        double alpha, alpha_old = 1, beta = 0, beta_old = 0;
+        double target_rr, source_norm = 0;
+
+        gettimeofday(&start, NULL);
+
+        out.resize(n_shifts);
+        for (int s = 0; s < n_shifts; s++) {
+            out[s].copy_boundary_condition(in);
+            p[s].copy_boundary_condition(in);
+            out[s][ALL] = 0;
+            p[s][ALL] = 0;
+            p[s][M.par] = in[X];
+        }
+        r[M.par] = in[X];
+
+        onsites(M.par) { source_norm += squarenorm(in[X]); }
+        rr = rrnew = source_norm;
+        target_rr = accuracy * accuracy * source_norm;
+
+        for (i = 0; i < maxiters && rr >= target_rr; i++) {
+            pDp = rrnew = 0;
+            M.apply(p[base], Dp);
+            M.dagger(Dp, DDp);
+            onsites(M.par) { pDp += squarenorm(Dp[X]) + sigma * squarenorm(p[base][X]); }
+
+            alpha = rr / pDp;
+
+            // the shifted systems use the step lengths of the base system
+            std::vector<double> zeta_new(n_shifts, 1.0);
+            for (int s = 0; s < n_shifts; s++) {
+                if (s == base || converged[s])
+                    continue;
+                zeta_new[s] = zeta[s] * zeta_old[s] * alpha_old /
+                              (alpha * beta_old * (zeta_old[s] - zeta[s]) +
+                               zeta_old[s] * alpha_old * (1 + (shifts[s] - sigma) * alpha));
+                double alpha_s = alpha * zeta_new[s] / zeta[s];
+                onsites(M.par) { out[s][X] += alpha_s * p[s][X]; }
+            }
+
+            onsites(M.par) {
+                out[base][X] += alpha * p[base][X];
+                r[X] -= alpha * (DDp[X] + sigma * p[base][X]);
+            }
+            onsites(M.par) { rrnew += squarenorm(r[X]); }
+#ifdef DEBUG_CG
+            hila::out0 << "Multishift CG step " << i << ", residue " << sqrt(rrnew / target_rr)
+                       << "\n";
+#endif
+            beta = rrnew / rr;
+            p[base][M.par] = r[X] + beta * p[base][X];
+
+            for (int s = 0; s < n_shifts; s++) {
+                if (s == base || converged[s])
+                    continue;
+                double z = zeta_new[s];
+                double beta_s = beta * (z / zeta[s]) * (z / zeta[s]);
+                p[s][M.par] = z * r[X] + beta_s * p[s][X];
+                zeta_old[s] = zeta[s];
+                zeta[s] = z;
+                if (z * z * rrnew < target_rr)
+                    converged[s] = true;
+            }
+
+            alpha_old = alpha;
+            beta_old = beta;
+            rr = rrnew;
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        hila::out0 << "Multishift CG: " << n_shifts << " shifts, " << i << " steps in " << timing
+                   << "ms, ";
+        hila::out0 << "relative residue:" << rrnew / source_norm << "\n";
+    }
+};
+
+/// Conjugate gradient for K right hand sides at once.  Solves the K independent
+/// systems D^dagger D out_k = in_k, stored as a field of VectorBatch<K, vector_type>,
+/// with one batched application of the operator per iteration:  the operator reads
+/// the gauge links once for all K vectors, which is where the gain over K separate
+/// CG runs comes from.  Each system has its own step lengths, and a system that
+/// has converged stops updating while the others continue.
+///
+/// The operator has to provide apply() and dagger() for fields of
+/// VectorBatch<K, vector_type>.
+template <typename Op, int K> class CG_multi {
+  private:
+    // The operator to invert
+    Op &M;
+    // desired relative accuracy
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+    /// The batch of K vectors
+    using batch_type = VectorBatch<K, vector_type>;
+
+    /// Constructor: initialize the operator
+    CG_multi(Op &op) : M(op){};
+    /// Constructor: operator and accuracy
+    CG_multi(Op &op, double _accuracy) : M(op) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, accuracy and maximum number of iterations
+    CG_multi(Op &op, double _accuracy, int _maxiters) : M(op) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// Run the conjugate gradient for the K vectors of in.  out is used
+    /// as the initial guess.
+    void apply(Field<batch_type> &in, Field<batch_type> &out) {
+        int i;
+        struct timeval start, end;
+        Field<batch_type> r, p, Dp, DDp;
+        r.copy_boundary_condition(in);
+        p.copy_boundary_condition(in);
+        Dp.copy_boundary_condition(in);
+        DDp.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        Vector<K, double> pDp, rr, rrnew, source_norm;
+        Vector<K, double> alpha, beta, active;
+        Vector<K, double> target_rr;
+        bool converged[K];
+        int n_converged = 0;
+
+        gettimeofday(&start, NULL);
+
+        source_norm = 0;
+        onsites(M.par) { source_norm += in[X].squarenorms(); }
+
+        M.apply(out, Dp);
+        M.dagger(Dp, DDp);
+        onsites(M.par) {
+            r[X] = in[X] - DDp[X];
+            p[X] = r[X];
+        }
+
+        rr = 0;
+        onsites(M.par) { rr += r[X].squarenorms(); }
+        rrnew = rr;
+
+        for (int k = 0; k < K; k++) {
+            target_rr.e(k) = accuracy * accuracy * source_norm.e(k);
+            converged[k] = (rr.e(k) <= target_rr.e(k));
+            if (converged[k])
+                n_converged++;
+        }
+
+        for (i = 0; i < maxiters && n_converged < K; i++) {
+            pDp = 0;
+            rrnew = 0;
+            M.apply(p, Dp);
+            M.dagger(Dp, DDp);
+            onsites(M.par) { pDp += Dp[X].squarenorms(); }
+
+            for (int k = 0; k < K; k++)
+                alpha.e(k) = converged[k] ? 0 : rr.e(k) / pDp.e(k);
+
+            onsites(M.par) {
+                batch_type o = out[X], res = r[X], pk = p[X], d = DDp[X];
+                for (int k = 0; k < K; k++) {
+                    o.v[k] += alpha.e(k) * pk.v[k];
+                    res.v[k] -= alpha.e(k) * d.v[k];
+                }
+                out[X] = o;
+                r[X] = res;
+            }
+            onsites(M.par) { rrnew += r[X].squarenorms(); }
+#ifdef DEBUG_CG
+            hila::out0 << "Multi-RHS CG step " << i << ", residues " << rrnew << "\n";
+#endif
+            // a converged system gets a zero step length and search direction, so that
+            // it stops moving.  It still goes through the batched operator every step.
+            for (int k = 0; k < K; k++) {
+                if (!converged[k] && rrnew.e(k) < target_rr.e(k)) {
+                    converged[k] = true;
+                    n_converged++;
+                }
+                beta.e(k) = converged[k] ? 0 : rrnew.e(k) / rr.e(k);
+                active.e(k) = converged[k] ? 0 : 1;
+            }
+            onsites(M.par) {
+                batch_type pk = p[X], res = r[X];
+                for (int k = 0; k < K; k++) {
+                    pk.v[k] = beta.e(k) * pk.v[k] + active.e(k) * res.v[k];
+                }
+                p[X] = pk;
+            }
+            rr = rrnew;
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        double max_residue = 0;
+        for (int k = 0; k < K; k++) {
+            if (source_norm.e(k) > 0)
+                max_residue = std::max(max_residue, rrnew.e(k) / source_norm.e(k));
+        }
+        hila::out0 << "Multi-RHS CG: " << K << " vectors, " << i << " steps in " << timing
+                   << "ms, ";
+        hila::out0 << "max relative residue:" << max_residue << "\n";
+    }
+
+    /// Solve for a set of vectors, K at a time.  out is resized to in.size()
+    /// and the solutions start from zero.
+    void apply(std::vector<Field<vector_type>> &in, std::vector<Field<vector_type>> &out) {
+        int n = in.size();
+        Field<batch_type> b_in, b_out;
+
+        out.resize(n);
+        for (int first = 0; first < n; first += K) {
+            b_in.copy_boundary_condition(in[first]);
+            b_in[ALL] = 0;
+            b_out[ALL] = 0;
+            // the last batch is padded with zero vectors, which converge immediately
+            for (int k = 0; k < K && first + k < n; k++) {
+                onsites(M.par) { b_in[X].v[k] = in[first + k][X]; }
+            }
+
+            apply(b_in, b_out);
+
+            for (int k = 0; k < K && first + k < n; k++) {
+                out[first + k].copy_boundary_condition(in[first + k]);
+                out[first + k][ALL] = 0;
+                onsites(M.par) { out[first + k][X] = b_out[X].v[k]; }
+            }
+        }
+    }
+};
+
+/// Restarted generalized conjugate residual solver.  Unlike CG, which inverts
+/// D^dagger D, GCR solves M out = in directly for a non-hermitian M, such as the
+/// Wilson Dirac operator.  The search directions are preconditioned with
+/// P.precondition(in, out), which approximates M^-1 and may change from one
+/// iteration to the next (flexible GCR), e.g. a multigrid cycle with an inexact
+/// coarse solve.  Without Prec the search directions are the residuals.  The
+/// iteration restarts after every restart_length steps.
+template <typename Op, typename Prec = void> class GCR {
+  private:
+    // The operator to invert and the preconditioner
+    Op &M;
+    Prec *P = nullptr;
+    // desired relative accuracy
+    double accuracy = CG_DEFAULT_ACCURACY;
+    // maximum number of iterations
+    int maxiters = CG_DEFAULT_MAXITERS;
+    // number of search directions kept before a restart
+    int restart_length = 20;
+    // print a line for each solve
+    bool verbose = true;
+
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+
+    /// Number of iterations in the last solve
+    int iterations = 0;
+
+    /// Constructor: initialize the operator
+    GCR(Op &op) : M(op){};
+    /// Constructor: operator and accuracy
+    GCR(Op &op, double _accuracy) : M(op) {
+        accuracy = _accuracy;
+    };
+    /// Constructor: operator, accuracy and maximum number of iterations
+    GCR(Op &op, double _accuracy, int _maxiters) : M(op) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+    /// Constructor: operator, preconditioner, accuracy and maximum number of iterations
+    template <typename P_t = Prec, std::enable_if_t<!std::is_void<P_t>::value, int> = 0>
+    GCR(Op &op, P_t &prec, double _accuracy, int _maxiters) : M(op), P(&prec) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+    };
+
+    /// Set the number of search directions kept before a restart
+    void set_restart_length(int n) {
+        restart_length = n;
+    }
+
+    /// Print a line for each solve, or not
+    void set_verbose(bool v) {
+        verbose = v;
+    }
+
+    /// Solve M out = in, out is the initial guess
+    void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        struct timeval start, end;
+        Field<vector_type> r, Mx;
+        std::vector<Field<vector_type>> z(restart_length), w(restart_length);
+        r.copy_boundary_condition(in);
+        Mx.copy_boundary_condition(in);
+        out.copy_boundary_condition(in);
+        for (int k = 0; k < restart_length; k++) {
+            z[k].copy_boundary_condition(in);
+            w[k].copy_boundary_condition(in);
+        }
+        double rr = 0, target_rr, source_norm = 0;
+        int i = 0;
+
+        gettimeofday(&start, NULL);
+
+        onsites(M.par) { source_norm += squarenorm(in[X]); }
+        target_rr = accuracy * accuracy * source_norm;
+
+        // the solution of a zero source is zero
+        if (source_norm == 0) {
+            out[M.par] = 0;
+            iterations = 0;
+            return;
+        }
+
+        M.apply(out, Mx);
+        onsites(M.par) {
+            r[X] = in[X] - Mx[X];
+            rr += squarenorm(r[X]);
+        }
+
+        bool breakdown = false;
+        while (i < maxiters && rr > target_rr && !breakdown) {
+            for (int k = 0; k < restart_length && i < maxiters && rr > target_rr; k++, i++) {
+                if constexpr (std::is_void<Prec>::value)
+                    z[k][M.par] = r[X];
+                else
+                    P->precondition(r, z[k]);
+                M.apply(z[k], w[k]);
+
+                // orthogonalize M z_k against the previous directions
+                for (int j = 0; j < k; j++) {
+                    Complex<double> beta = 0;
+                    onsites(M.par) { beta += w[j][X].dot(w[k][X]); }
+                    onsites(M.par) {
+                        w[k][X] -= beta * w[j][X];
+                        z[k][X] -= beta * z[j][X];
+                    }
+                }
+                double ww = 0;
+                onsites(M.par) { ww += squarenorm(w[k][X]); }
+
+                // The direction vanished, or was removed by the orthogonalization, e.g.
+                // with an inexact multigrid cycle.  Restart from the current residue;
+                // if already the first direction vanishes, the solve cannot proceed.
+                if (!(ww > GCR_BREAKDOWN * rr)) {
+                    i++;
+                    breakdown = (k == 0);
+                    break;
+                }
+                double inv_norm = 1.0 / sqrt(ww);
+
+                Complex<double> alpha = 0;
+                onsites(M.par) {
+                    w[k][X] *= inv_norm;
+                    z[k][X] *= inv_norm;
+                    alpha += w[k][X].dot(r[X]);
+                }
+
+                rr = 0;
+                onsites(M.par) {
+                    out[X] += alpha * z[k][X];
+                    r[X] -= alpha * w[k][X];
+                    rr += squarenorm(r[X]);
+                }
+#ifdef DEBUG_CG
+                hila::out0 << "GCR step " << i << ", residue " << sqrt(rr / target_rr) << "\n";
+#endif
+            }
+        }
+        iterations = i;
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+
+        if (breakdown)
+            hila::out0 << "GCR: the preconditioned direction vanished, stopping at step " << i
+                       << "\n";
+        if (verbose) {
+            hila::out0 << "GCR: " << i << " steps in " << timing << "ms, ";
+            hila::out0 << "relative residue:" << rr / source_norm << "\n";
+        }
+    }
+};
+
 #endif
@@ -0,0 +1,513 @@
+#ifndef __DIRAC_MULTIGRID_H__
+#define __DIRAC_MULTIGRID_H__
+
+///////////////////////////////////////////////////////
+/// Adaptive aggregation multigrid for the Wilson Dirac operator
+///
+/// The fine lattice is divided into blocks (aggregates), which are the sites
+/// of a coarse lattice made with lattice.block().  On each block the
+/// interpolation P maps a coarse vector with NC components to the span of NC
+/// block-local basis vectors.  These are built from NV near-null vectors of the
+/// Dirac operator, D v ~ 0, each split to its two chiral halves, so that
+/// NC = 2 NV, and orthonormalized on each block.  The restriction is then
+/// R = P^dagger and the coarse operator D_c = P^dagger D P couples only
+/// nearest neighbour blocks.  The chirality comes from the operator, which
+/// provides apply_gamma5() with D^dagger = gamma5 D gamma5.
+///
+/// The near-null vectors are found adaptively: random vectors are smoothed by
+/// inverse iteration, and then improved with the two-level solver itself.
+///
+/// The solver is a flexible GCR on the fine lattice, preconditioned with a
+/// two-level cycle: the coarse system is solved to low accuracy with GCR
+/// (a K-cycle), followed by minimal residual smoothing on the fine lattice.
+///////////////////////////////////////////////////////
+
+#include <sstream>
+#include <iostream>
+#include "plumbing/defs.h"
+#include "datatypes/matrix.h"
+#include "datatypes/vector_batch.h"
+#include "plumbing/field.h"
+#include "dirac/conjugate_gradient.h"
+
+/// The coarse operator of the multigrid, a general nearest neighbour operator on
+/// the coarse lattice
+///   out(x) = diag(x) in(x) + sum_dir link[dir](x) in(x + dir),
+/// summed over the 2*NDIM directions.  The fields live on the coarse lattice, which
+/// must be the active lattice when this is used.  Boundary conditions of the fine
+/// vectors are included in the links, the coarse vectors are periodic.
+template <int NC> class multigrid_coarse_operator {
+  public:
+    using vector_type = Vector<NC, Complex<double>>;
+    using matrix_type = SquareMatrix<NC, Complex<double>>;
+
+    Field<matrix_type> diag;
+    Field<matrix_type> link[2 * NDIM];
+
+    /// The parity this operator applies to
+    Parity par = ALL;
+
+    /// Applies the operator to in
+    void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        out[ALL] = diag[X] * in[X];
+        foralldir(dir) {
+            onsites(ALL) {
+                out[X] += link[dir][X] * in[X + dir] + link[-dir][X] * in[X - dir];
+            }
+        }
+    }
+};
+
+/// Multigrid solver for the Wilson Dirac operator Op (e.g. Dirac_Wilson<SU<3,double>>),
+/// with NV near-null vectors.  Op has to provide apply(), hop_direction() and
+/// apply_gamma5(), and the lattice size must be divisible by the block size.
+///
+/// Usage:
+///   Dirac_Wilson<SU<3, double>> D(kappa, U);
+///   multigrid_GCR<Dirac_Wilson<SU<3, double>>> mg(D, {4, 4, 4, 4}, 1e-10);
+///   mg.setup();          // again after the gauge field changes
+///   mg.solve(in, out);   // D out = in
+///   mg.apply(in, out);   // D^dagger D out = in, a drop-in replacement of CG<Op>
+///
+/// Fermion vectors are antiperiodic in time by default, see set_boundary_condition().
+template <typename Op, int NV = 8> class multigrid_GCR {
+  public:
+    /// Get the type the operator applies to
+    using vector_type = typename Op::vector_type;
+    /// Number of coarse components per block: both chiralities of each near-null vector
+    static constexpr int NC = 2 * NV;
+    using coarse_vector_type = Vector<NC, Complex<double>>;
+    using coarse_operator = multigrid_coarse_operator<NC>;
+    using basis_type = VectorBatch<NC, vector_type>;
+
+    /// The parity this operator applies to
+    Parity par = ALL;
+
+    /// Number of GCR iterations in the last solve() or apply()
+    int iterations = 0;
+
+  private:
+    // The operator to invert
+    Op &D;
+    // block size and the fine and coarse lattices
+    CoordinateVector block;
+    Lattice fine_lattice, coarse_lattice;
+    coarse_operator Dc;
+
+    // near-null vectors and the orthonormal block basis built from them
+    std::vector<Field<vector_type>> nullvec;
+    Field<basis_type> basis;
+    // carries the boundary conditions of the fine vectors
+    Field<vector_type> bc_template;
+    // fine lattice field of coarse vectors, for restriction and prolongation
+    Field<coarse_vector_type> fine_c;
+    bool is_setup = false;
+
+    // desired relative accuracy and maximum number of iterations of the solver
+    double accuracy = CG_DEFAULT_ACCURACY;
+    int maxiters = CG_DEFAULT_MAXITERS;
+    // relative accuracy and maximum iterations of the coarse solve
+    double coarse_accuracy = 0.05;
+    int coarse_maxiters = 200;
+    // minimal residual steps in the smoother
+    int smoothing_steps = 4;
+    // setup: inverse iterations of the near-null vectors, smoothing steps in each,
+    // and iterations of the adaptive refinement with the full solver
+    int setup_iterations = 5;
+    int setup_smoothing = 8;
+    int setup_cycles = 1;
+
+  public:
+    /// Constructor: operator and block size
+    multigrid_GCR(Op &op, const CoordinateVector &block_size) : D(op), block(block_size) {
+        init();
+    }
+    /// Constructor: operator, block size and accuracy
+    multigrid_GCR(Op &op, const CoordinateVector &block_size, double _accuracy)
+        : D(op), block(block_size) {
+        accuracy = _accuracy;
+        init();
+    }
+    /// Constructor: operator, block size, accuracy and maximum number of iterations
+    multigrid_GCR(Op &op, const CoordinateVector &block_size, double _accuracy,
+                  int _maxiters)
+        : D(op), block(block_size) {
+        accuracy = _accuracy;
+        maxiters = _maxiters;
+        init();
+    }
+
+    /// Set the boundary condition of the fermion vectors.  Call before setup().
+    void set_boundary_condition(Direction dir, hila::bc bc) {
+        bc_template.set_boundary_condition(dir, bc);
+        bc_template.set_boundary_condition(-dir, bc);
+    }
+
+    /// Set the relative accuracy and maximum iterations of the coarse solve
+    void set_coarse_solver(double _accuracy, int _maxiters) {
+        coarse_accuracy = _accuracy;
+        coarse_maxiters = _maxiters;
+    }
+
+    /// Set the number of minimal residual steps in the smoother
+    void set_smoothing_steps(int n) {
+        smoothing_steps = n;
+    }
+
+    /// Set the number of inverse iterations and smoothing steps used to find
+    /// the near-null vectors, and the number of adaptive refinement cycles
+    void set_setup(int iterations, int smoothing, int cycles) {
+        setup_iterations = iterations;
+        setup_smoothing = smoothing;
+        setup_cycles = cycles;
+    }
+
+    /// Find the near-null vectors and build the coarse operator.  Must be called
+    /// before solving, and again when the gauge field has changed.  Later calls
+    /// start from the previous near-null vectors.
+    void setup() {
+        struct timeval start, end;
+        gettimeofday(&start, NULL);
+
+        for (int k = 0; k < NV; k++) {
+            if (!is_setup) {
+                nullvec[k].copy_boundary_condition(bc_template);
+                onsites(ALL) { nullvec[k][X].gaussian_random(); }
+            }
+            // inverse iteration with the smoother amplifies the low modes
+            for (int i = 0; i < setup_iterations; i++) {
+                Field<vector_type> w;
+                w.copy_boundary_condition(bc_template);
+                w[ALL] = 0;
+                smooth(nullvec[k], w, setup_smoothing);
+                normalize(w);
+                nullvec[k] = w;
+            }
+        }
+        build_basis();
+        build_coarse_operator();
+        is_setup = true;
+
+        // improve the near-null vectors with the two-level solver
+        for (int c = 0; c < setup_cycles; c++) {
+            GCR<Op, multigrid_GCR> inverse(D, *this, 0.1, 3);
+            inverse.set_verbose(false);
+            for (int k = 0; k < NV; k++) {
+                Field<vector_type> w;
+                w.copy_boundary_condition(bc_template);
+                w[ALL] = 0;
+                inverse.apply(nullvec[k], w);
+                normalize(w);
+                nullvec[k] = w;
+            }
+            build_basis();
+            build_coarse_operator();
+        }
+
+        gettimeofday(&end, NULL);
+        double timing =
+            1e-3 * (end.tv_usec - start.tv_usec) + 1e3 * (end.tv_sec - start.tv_sec);
+        hila::out0 << "Multigrid setup: " << NV << " near-null vectors, coarse lattice "
+                   << coarse_lattice.size() << " in " << timing << "ms\n";
+    }
+
+    /// Restrict a fine vector to the coarse lattice, out = P^dagger in
+    void restrict_vector(const Field<vector_type> &in, Field<coarse_vector_type> &out) {
+        onsites(ALL) {
+            coarse_vector_type c;
+            for (int i = 0; i < NC; i++)
+                c.e(i) = basis[X].v[i].dot(in[X]);
+            fine_c[X] = c;
+        }
+        block_sum(fine_c, out);
+    }
+
+    /// Interpolate a coarse vector to the fine lattice, out = P in
+    void prolong_vector(const Field<coarse_vector_type> &in, Field<vector_type> &out) {
+        block_spread(in, fine_c);
+        onsites(ALL) {
+            vector_type v = 0;
+            for (int i = 0; i < NC; i++)
+                v += fine_c[X].e(i) * basis[X].v[i];
+            out[X] = v;
+        }
+    }
+
+    /// Apply the coarse operator on a coarse vector
+    void apply_coarse(const Field<coarse_vector_type> &in, Field<coarse_vector_type> &out) {
+        lattice.switch_to(coarse_lattice);
+        Dc.apply(in, out);
+        lattice.switch_to(fine_lattice);
+    }
+
+    /// The two-level preconditioner, out ~ D^-1 in.  Used by GCR.
+    void precondition(Field<vector_type> &in, Field<vector_type> &out) {
+        Field<coarse_vector_type> in_c, out_c;
+
+        // coarse grid correction
+        restrict_vector(in, in_c);
+        lattice.switch_to(coarse_lattice);
+        out_c[ALL] = 0;
+        GCR<coarse_operator> coarse_inverse(Dc, coarse_accuracy, coarse_maxiters);
+        coarse_inverse.set_verbose(false);
+        coarse_inverse.apply(in_c, out_c);
+        lattice.switch_to(fine_lattice);
+
+        out.copy_boundary_condition(in);
+        prolong_vector(out_c, out);
+
+        // and smoothing on the fine lattice
+        smooth(in, out, smoothing_steps);
+    }
+
+    /// Solve D out = in with the multigrid preconditioned GCR, out is the initial guess
+    void solve(Field<vector_type> &in, Field<vector_type> &out) {
+        if (!is_setup) {
+            hila::out0 << "multigrid_GCR: call setup() before solving\n";
+            hila::terminate(1);
+        }
+        GCR<Op, multigrid_GCR> inverse(D, *this, accuracy, maxiters);
+        inverse.apply(in, out);
+        iterations = inverse.iterations;
+    }
+
+    /// Applies the inverse of D^dagger D to in, like CG<Op>.  Solves D^dagger y = in
+    /// using D^dagger = gamma5 D gamma5, and then D out = y.  The accuracy of each
+    /// solve is the accuracy of the solver.
+    void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        Field<vector_type> g5in, y;
+        g5in.copy_boundary_condition(in);
+        y.copy_boundary_condition(in);
+        D.apply_gamma5(in, g5in);
+        y[ALL] = 0;
+        solve(g5in, y);
+        int it = iterations;
+        D.apply_gamma5(y, g5in);
+        out[ALL] = 0;
+        solve(g5in, out);
+        iterations += it;
+    }
+
+  private:
+    // make the coarse lattice and allocate the fields of each lattice on it
+    void init() {
+        fine_lattice = lattice;
+        if (!lattice.can_block(block)) {
+            hila::out0 << "multigrid_GCR: cannot block lattice " << lattice.size()
+                       << " by " << block << '\n';
+            hila::terminate(1);
+        }
+        lattice.block(block);
+        coarse_lattice = lattice;
+        Dc.diag[ALL] = 0;
+        for (int d = 0; d < 2 * NDIM; d++)
+            Dc.link[d][ALL] = 0;
+        lattice.switch_to(fine_lattice);
+
+        nullvec.resize(NV);
+        basis[ALL] = 0;
+        fine_c[ALL] = 0;
+        bc_template[ALL] = 0;
+#if NDIM > 3
+        set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
+#endif
+    }
+
+    // scale v to unit norm
+    void normalize(Field<vector_type> &v) {
+        double n = 0;
+        onsites(ALL) { n += squarenorm(v[X]); }
+        double s = 1.0 / sqrt(n);
+        v[ALL] = s * v[X];
+    }
+
+    // minimal residual steps for D x = b, starting from x
+    void smooth(Field<vector_type> &b, Field<vector_type> &x, int steps) {
+        Field<vector_type> r, Dr;
+        r.copy_boundary_condition(b);
+        Dr.copy_boundary_condition(b);
+        D.apply(x, Dr);
+        r[ALL] = b[X] - Dr[X];
+        for (int s = 0; s < steps; s++) {
+            D.apply(r, Dr);
+            Complex<double> rDr = 0;
+            double DrDr = 0;
+            onsites(ALL) {
+                rDr += Dr[X].dot(r[X]);
+                DrDr += squarenorm(Dr[X]);
+            }
+            Complex<double> alpha = rDr / DrDr;
+            onsites(ALL) {
+                x[X] += alpha * r[X];
+                r[X] -= alpha * Dr[X];
+            }
+        }
+    }
+
+    // Sum the fine field f over each block to the coarse field fc.  The fine sites are
+    // copied to a buffer in block order, the sites of the block of coarse site c at
+    // c * (block volume) onwards, and summed in one pass on the coarse lattice.  As in
+    // Field::block_from(), the blocks are on the same node as their coarse sites.
+    template <typename T>
+    void block_sum(const Field<T> &f, Field<T> &fc) {
+        const lattice_struct *clat = coarse_lattice.ptr();
+        if (clat->mynode.volume == 0)
+            return;
+
+        CoordinateVector factor = block;
+        CoordinateVector cmin = clat->mynode.min;
+        auto size_factor = clat->mynode.size_factor;
+        // site offset within a block, x fastest
+        Vector<NDIM, unsigned> block_factor;
+        unsigned bvol = 1;
+        foralldir(d) {
+            block_factor[d] = bvol;
+            bvol *= block[d];
+        }
+
+        T *buf = (T *)d_malloc(clat->mynode.volume * bvol * sizeof(T));
+
+#pragma hila direct_access(buf)
+        onsites(ALL) {
+            Vector<NDIM, unsigned> cv = X.coordinates().element_div(factor) - cmin;
+            Vector<NDIM, unsigned> bv = X.coordinates().mod(factor);
+            buf[cv.dot(size_factor) * bvol + bv.dot(block_factor)] = f[X];
+        }
+
+        lattice.switch_to(coarse_lattice);
+
+#pragma hila direct_access(buf)
+        onsites(ALL) {
+            Vector<NDIM, unsigned> cv = X.coordinates() - cmin;
+            unsigned i0 = cv.dot(size_factor) * bvol;
+            T sum = buf[i0];
+            for (unsigned k = 1; k < bvol; k++)
+                sum += buf[i0 + k];
+            fc[X] = sum;
+        }
+
+        lattice.switch_to(fine_lattice);
+
+        d_free(buf);
+    }
+
+    // Copy the coarse field fc to all sites of each block of the fine field f
+    template <typename T>
+    void block_spread(const Field<T> &fc, Field<T> &f) {
+        const lattice_struct *clat = coarse_lattice.ptr();
+        if (clat->mynode.volume == 0)
+            return;
+
+        CoordinateVector factor = block;
+        CoordinateVector cmin = clat->mynode.min;
+        auto size_factor = clat->mynode.size_factor;
+
+        T *buf = (T *)d_malloc(clat->mynode.volume * sizeof(T));
+
+        lattice.switch_to(coarse_lattice);
+
+#pragma hila direct_access(buf)
+        onsites(ALL) {
+            Vector<NDIM, unsigned> cv = X.coordinates() - cmin;
+            buf[cv.dot(size_factor)] = fc[X];
+        }
+
+        lattice.switch_to(fine_lattice);
+
+#pragma hila direct_access(buf)
+        onsites(ALL) {
+            Vector<NDIM, unsigned> cv = X.coordinates().element_div(factor) - cmin;
+            f[X] = buf[cv.dot(size_factor)];
+        }
+
+        d_free(buf);
+    }
+
+    // sum a fine field over each block and copy the sum to all sites of the block
+    template <typename T>
+    void block_reduce(Field<T> &f) {
+        Field<T> fc;
+        block_sum(f, fc);
+        block_spread(fc, f);
+    }
+
+    // Split the near-null vectors to chiral halves and orthonormalize them on each block
+    void build_basis() {
+        Field<vector_type> g5v;
+        g5v.copy_boundary_condition(bc_template);
+        for (int k = 0; k < NV; k++) {
+            D.apply_gamma5(nullvec[k], g5v);
+            onsites(ALL) {
+                basis[X].v[k] = 0.5 * (nullvec[k][X] + g5v[X]);
+                basis[X].v[k + NV] = 0.5 * (nullvec[k][X] - g5v[X]);
+            }
+        }
+
+        // block Gram-Schmidt, projections done twice for numerical stability
+        Field<double> norm;
+        for (int i = 0; i < NC; i++) {
+            for (int pass = 0; pass < 2 && i > 0; pass++) {
+                onsites(ALL) {
+                    coarse_vector_type c = 0;
+                    for (int j = 0; j < i; j++)
+                        c.e(j) = basis[X].v[j].dot(basis[X].v[i]);
+                    fine_c[X] = c;
+                }
+                block_reduce(fine_c);
+                onsites(ALL) {
+                    vector_type v = basis[X].v[i];
+                    for (int j = 0; j < i; j++)
+                        v -= fine_c[X].e(j) * basis[X].v[j];
+                    basis[X].v[i] = v;
+                }
+            }
+            onsites(ALL) { norm[X] = squarenorm(basis[X].v[i]); }
+            block_reduce(norm);
+            onsites(ALL) { basis[X].v[i] *= 1.0 / sqrt(norm[X]); }
+        }
+    }
+
+    // D_c = P^dagger D P, column by column.  The hopping terms of D which cross
+    // a block boundary in direction dir go to the coarse link in that direction,
+    // the rest to the coarse diagonal.
+    void build_coarse_operator() {
+        Field<vector_type> b, Db, hop;
+        Field<coarse_vector_type> col;
+        b.copy_boundary_condition(bc_template);
+        Db.copy_boundary_condition(bc_template);
+        hop.copy_boundary_condition(bc_template);
+
+        for (int j = 0; j < NC; j++) {
+            b[ALL] = basis[X].v[j];
+            D.apply(b, Db);
+
+            for (Direction dir = e_x; dir < NDIRS; ++dir) {
+                D.hop_direction(b, hop, dir);
+
+                // keep the part coming from the neighbouring block
+                Direction axis = abs(dir);
+                int bs = block[axis];
+                int edge = is_up_dir(dir) ? bs - 1 : 0;
+                onsites(ALL) {
+                    if (X.coordinate(axis) % bs == edge) {
+                        Db[X] -= hop[X];
+                    } else {
+                        hop[X] = 0;
+                    }
+                }
+
+                restrict_vector(hop, col);
+                lattice.switch_to(coarse_lattice);
+                onsites(ALL) { Dc.link[dir][X].set_column(j, col[X]); }
+                lattice.switch_to(fine_lattice);
+            }
+
+            restrict_vector(Db, col);
+            lattice.switch_to(coarse_lattice);
+            onsites(ALL) { Dc.diag[X].set_column(j, col[X]); }
+            lattice.switch_to(fine_lattice);
+        }
+    }
+};
+
+#endif
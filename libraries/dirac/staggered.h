@@ -5,11 +5,18 @@
 #include "../datatypes/cmplx.h"
 #include "../datatypes/matrix.h"
 #include "../datatypes/sun.h"
+#include "../datatypes/vector_batch.h"
 #include "../plumbing/field.h"
 #include "../../libraries/hmc/gauge_field.h"
 
 template <typename vector> Field<vector> staggered_dirac_temp[NDIM];
 
+/// Set the precision of the halo messages of the hopping term, see Field::set_halo_precision
+template <typename vtype>
+inline void dirac_staggered_set_halo_precision(hila::halo_precision prec) {
+    foralldir(dir) staggered_dirac_temp<vtype>[dir].set_halo_precision(prec);
+}
+
 /// Initialize the staggered eta field
 inline void init_staggered_eta(Field<double> (&staggered_eta)[NDIM]) {
     // Initialize the staggered eta field
@@ -111,6 +118,9 @@ template <typename matrix> class dirac_staggered {
     /// The parity this operator applies to
     Parity par = ALL;
 
+    /// Precision of the halo messages in apply() and dagger()
+    hila::halo_precision halo_prec = hila::halo_precision::FULL;
+
     // Constructor: initialize mass, gauge and eta
     dirac_staggered(dirac_staggered &d) : gauge(d.gauge), mass(d.mass) {
         // Initialize the eta field (Share this?)
@@ -132,8 +142,15 @@ template <typename matrix> class dirac_staggered {
         init_staggered_eta(staggered_eta);
     }
 
+    /// Send the halos of the temporary vectors in the hopping term in reduced precision,
+    /// see Field::set_halo_precision.  The input vector is gathered with its own precision.
+    void set_halo_precision(hila::halo_precision prec) {
+        halo_prec = prec;
+    }
+
     /// Applies the operator to in
     void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        dirac_staggered_set_halo_precision<vector_type>(halo_prec);
         out[ALL] = 0;
         dirac_staggered_diag(mass, in, out, ALL);
         dirac_staggered_hop(gauge, in, out, staggered_eta, ALL, 1);
@@ -141,6 +158,28 @@ template <typename matrix> class dirac_staggered {
 
     /// Applies the conjugate of the operator
     void dagger(const Field<vector_type> &in, Field<vector_type> &out) {
+        dirac_staggered_set_halo_precision<vector_type>(halo_prec);
+        out[ALL] = 0;
+        dirac_staggered_diag(mass, in, out, ALL);
+        dirac_staggered_hop(gauge, in, out, staggered_eta, ALL, -1);
+    }
+
+    /// Applies the operator to a batch of K vectors, reading the gauge links once
+    /// for all of them
+    template <int K>
+    void apply(const Field<VectorBatch<K, vector_type>> &in,
+               Field<VectorBatch<K, vector_type>> &out) {
+        dirac_staggered_set_halo_precision<VectorBatch<K, vector_type>>(halo_prec);
+        out[ALL] = 0;
+        dirac_staggered_diag(mass, in, out, ALL);
+        dirac_staggered_hop(gauge, in, out, staggered_eta, ALL, 1);
+    }
+
+    /// Applies the conjugate of the operator to a batch of K vectors
+    template <int K>
+    void dagger(const Field<VectorBatch<K, vector_type>> &in,
+                Field<VectorBatch<K, vector_type>> &out) {
+        dirac_staggered_set_halo_precision<VectorBatch<K, vector_type>>(halo_prec);
         out[ALL] = 0;
         dirac_staggered_diag(mass, in, out, ALL);
         dirac_staggered_hop(gauge, in, out, staggered_eta, ALL, -1);
@@ -214,6 +253,9 @@ template <typename matrix> class dirac_staggered_evenodd {
     /// The parity this operator applies to
     Parity par = EVEN;
 
+    /// Precision of the halo messages in apply() and dagger()
+    hila::halo_precision halo_prec = hila::halo_precision::FULL;
+
     /// Constructor: initialize mass, gauge and eta
     dirac_staggered_evenodd(dirac_staggered_evenodd &d) : gauge(d.gauge), mass(d.mass) {
         init_staggered_eta(staggered_eta);
@@ -235,8 +277,15 @@ template <typename matrix> class dirac_staggered_evenodd {
         init_staggered_eta(staggered_eta);
     }
 
+    /// Send the halos of the temporary vectors in the hopping term in reduced precision,
+    /// see Field::set_halo_precision.  The input vector is gathered with its own precision.
+    void set_halo_precision(hila::halo_precision prec) {
+        halo_prec = prec;
+    }
+
     /// Applies the operator to in
     inline void apply(Field<vector_type> &in, Field<vector_type> &out) {
+        dirac_staggered_set_halo_precision<vector_type>(halo_prec);
         out[ALL] = 0;
         dirac_staggered_diag(mass, in, out, EVEN);
 
@@ -247,6 +296,34 @@ template <typename matrix> class dirac_staggered_evenodd {
 
     /// Applies the conjugate of the operator
     inline void dagger(Field<vector_type> &in, Field<vector_type> &out) {
+        dirac_staggered_set_halo_precision<vector_type>(halo_prec);
+        out[ALL] = 0;
+        dirac_staggered_diag(mass, in, out, EVEN);
+
+        dirac_staggered_hop(gauge, in, out, staggered_eta, ODD, -1);
+        dirac_staggered_diag_inverse(mass, out, ODD);
+        dirac_staggered_hop(gauge, out, out, staggered_eta, EVEN, -1);
+    }
+
+    /// Applies the operator to a batch of K vectors, reading the gauge links once
+    /// for all of them
+    template <int K>
+    inline void apply(Field<VectorBatch<K, vector_type>> &in,
+                      Field<VectorBatch<K, vector_type>> &out) {
+        dirac_staggered_set_halo_precision<VectorBatch<K, vector_type>>(halo_prec);
+        out[ALL] = 0;
+        dirac_staggered_diag(mass, in, out, EVEN);
+
+        dirac_staggered_hop(gauge, in, out, staggered_eta, ODD, 1);
+        dirac_staggered_diag_inverse(mass, out, ODD);
+        dirac_staggered_hop(gauge, out, out, staggered_eta, EVEN, 1);
+    }
+
+    /// Applies the conjugate of the operator to a batch of K vectors
+    template <int K>
+    inline void dagger(Field<VectorBatch<K, vector_type>> &in,
+                       Field<VectorBatch<K, vector_type>> &out) {
+        dirac_staggered_set_halo_precision<VectorBatch<K, vector_type>>(halo_prec);
         out[ALL] = 0;
         dirac_staggered_diag(mass, in, out, EVEN);
 
@@ -260,6 +337,7 @@ template <typename matrix> class dirac_staggered_evenodd {
     template <typename momtype>
     inline void force(const Field<vector_type> &chi, const Field<vector_type> &psi,
                       Field<momtype> (&force)[NDIM], int sign) {
+        dirac_staggered_set_halo_precision<vector_type>(hila::halo_precision::FULL);
         Field<momtype> force2[NDIM];
         Field<vector_type> tmp;
         tmp.copy_boundary_condition(chi);
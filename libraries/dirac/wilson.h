@@ -5,12 +5,21 @@
 #include "datatypes/cmplx.h"
 #include "datatypes/matrix.h"
 #include "datatypes/wilson_vector.h"
+#include "datatypes/vector_batch.h"
 #include "plumbing/field.h"
 #include "hmc/gauge_field.h"
 
 template <int N, typename radix>
 Field<half_Wilson_vector<N, radix>> wilson_dirac_temp_vector[2 * NDIM];
 
+/// Set the precision of the halo messages of the hopping term, see Field::set_halo_precision
+template <int N, typename radix>
+inline void Dirac_Wilson_set_halo_precision(hila::halo_precision prec) {
+    for (int dir = 0; dir < 2 * NDIM; dir++) {
+        wilson_dirac_temp_vector<N, radix>[dir].set_halo_precision(prec);
+    }
+}
+
 /// Apply the hopping term to v_out and add to v_in
 template <int N, typename radix, typename matrix>
 inline void Dirac_Wilson_hop(const Field<matrix> *gauge, const double kappa,
@@ -44,7 +53,7 @@ inline void Dirac_Wilson_hop(const Field<matrix> *gauge, const double kappa,
         onsites(par) {
             v_out[X] = v_out[X] -
                        (kappa * gauge[dir][X] * vtemp[dir][X + dir]).expand(dir, sign) -
-                       (kappa * vtemp[dir][X + dir]).expand(dir, -sign);
+                       (kappa * vtemp[-dir][X - dir]).expand(dir, -sign);
         }
     }
 }
@@ -80,7 +89,7 @@ inline void Dirac_Wilson_hop_set(const Field<matrix> *gauge, const double kappa,
     Direction dir = Direction(0);
     onsites(par) {
         v_out[X] = -(kappa * gauge[dir][X] * vtemp[dir][X + dir]).expand(dir, sign) -
-                   (kappa * vtemp[dir][X + dir]).expand(dir, -sign);
+                   (kappa * vtemp[-dir][X - dir]).expand(dir, -sign);
     }
     // Add for all other directions
     for (int d = 1; d < NDIM; d++) {
@@ -89,21 +98,163 @@ inline void Dirac_Wilson_hop_set(const Field<matrix> *gauge, const double kappa,
             half_Wilson_vector<N, radix> h1(v_in[X + dir], dir, sign);
             v_out[X] = v_out[X] -
                        (kappa * gauge[dir][X] * vtemp[dir][X + dir]).expand(dir, sign) -
-                       (kappa * vtemp[dir][X + dir]).expand(dir, -sign);
+                       (kappa * vtemp[-dir][X - dir]).expand(dir, -sign);
+        }
+    }
+}
+
+/// The part of the hopping term which couples each site to its neighbour in
+/// direction dir, v_out(x) = H_dir v_in(x + dir), overwriting v_out.  The full
+/// hopping term is the sum over the 2*NDIM directions.  Used to build coarse
+/// operators in the multigrid solver.
+template <int N, typename radix, typename matrix>
+inline void Dirac_Wilson_hop_direction(const Field<matrix> *gauge, const double kappa,
+                                       const Field<Wilson_vector<N, radix>> &v_in,
+                                       Field<Wilson_vector<N, radix>> &v_out, Direction dir,
+                                       int sign) {
+    if (is_up_dir(dir)) {
+        onsites(ALL) {
+            half_Wilson_vector<N, radix> h(v_in[X + dir], dir, sign);
+            v_out[X] = -(kappa * gauge[dir][X] * h).expand(dir, sign);
+        }
+    } else {
+        Direction odir = -dir;
+        onsites(ALL) {
+            half_Wilson_vector<N, radix> h(v_in[X + dir], odir, -sign);
+            v_out[X] = -(kappa * gauge[odir][X + dir].adjoint() * h).expand(odir, -sign);
         }
     }
 }
 
 /// The diagonal part of the operator. Without clover this is just the identity
-template <int N, typename radix>
-inline void Dirac_Wilson_diag(const Field<Wilson_vector<N, radix>> &v_in,
-                              Field<Wilson_vector<N, radix>> &v_out, Parity par) {
+template <typename vtype>
+inline void Dirac_Wilson_diag(const Field<vtype> &v_in, Field<vtype> &v_out, Parity par) {
     v_out[par] = v_in[X];
 }
 
 /// Inverse of the diagonal part. Without clover this does nothing.
-template <int N, typename radix>
-inline void Dirac_Wilson_diag_inverse(Field<Wilson_vector<N, radix>> &v, Parity par) {}
+template <typename vtype>
+inline void Dirac_Wilson_diag_inverse(Field<vtype> &v, Parity par) {}
+
+/// Temporary fields of the batched hopping term, see VectorBatch
+template <int K, int N, typename radix>
+Field<VectorBatch<K, half_Wilson_vector<N, radix>>> wilson_dirac_temp_batch[2 * NDIM];
+
+/// Set the precision of the halo messages of the batched hopping term
+template <int K, int N, typename radix>
+inline void Dirac_Wilson_batch_set_halo_precision(hila::halo_precision prec) {
+    for (int dir = 0; dir < 2 * NDIM; dir++) {
+        wilson_dirac_temp_batch<K, N, radix>[dir].set_halo_precision(prec);
+    }
+}
+
+/// Project a batch of Wilson vectors to the forward and backward half vectors of
+/// direction dir.  The backward ones are multiplied by the adjoint link, which is
+/// loaded once for the whole batch.
+template <int K, int N, typename radix, typename matrix>
+inline void Dirac_Wilson_batch_project(const matrix &U,
+                                       const VectorBatch<K, Wilson_vector<N, radix>> &v,
+                                       VectorBatch<K, half_Wilson_vector<N, radix>> &fwd,
+                                       VectorBatch<K, half_Wilson_vector<N, radix>> &bwd,
+                                       Direction dir, int sign) {
+    matrix Ud = U.adjoint();
+    for (int k = 0; k < K; k++) {
+        half_Wilson_vector<N, radix> hb(v.v[k], dir, -sign);
+        bwd.v[k] = Ud * hb;
+        fwd.v[k] = half_Wilson_vector<N, radix>(v.v[k], dir, sign);
+    }
+}
+
+/// Subtract the hopping term of direction dir from a batch of Wilson vectors
+template <int K, int N, typename radix, typename matrix>
+inline void Dirac_Wilson_batch_hop_site(const matrix &U, const double kappa,
+                                        const VectorBatch<K, half_Wilson_vector<N, radix>> &fwd,
+                                        const VectorBatch<K, half_Wilson_vector<N, radix>> &bwd,
+                                        VectorBatch<K, Wilson_vector<N, radix>> &v,
+                                        Direction dir, int sign) {
+    for (int k = 0; k < K; k++) {
+        v.v[k] = v.v[k] - (kappa * U * fwd.v[k]).expand(dir, sign) -
+                 (kappa * bwd.v[k]).expand(dir, -sign);
+    }
+}
+
+/// Apply the hopping term to a batch of K vectors and add to v_out.  Each gauge
+/// link is read once per site and applied to all K vectors.
+template <int K, int N, typename radix, typename matrix>
+inline void Dirac_Wilson_hop(const Field<matrix> *gauge, const double kappa,
+                             const Field<VectorBatch<K, Wilson_vector<N, radix>>> &v_in,
+                             Field<VectorBatch<K, Wilson_vector<N, radix>>> &v_out, Parity par,
+                             int sign) {
+    Field<VectorBatch<K, half_Wilson_vector<N, radix>>>(&vtemp)[2 * NDIM] =
+        wilson_dirac_temp_batch<K, N, radix>;
+    for (int dir = 0; dir < 2 * NDIM; dir++) {
+        vtemp[dir].copy_boundary_condition(v_in);
+    }
+
+    foralldir(dir) {
+        onsites(opp_parity(par)) {
+            VectorBatch<K, half_Wilson_vector<N, radix>> fwd, bwd;
+            Dirac_Wilson_batch_project(gauge[dir][X], v_in[X], fwd, bwd, dir, sign);
+            vtemp[dir][X] = fwd;
+            vtemp[-dir][X] = bwd;
+        }
+
+        vtemp[dir].start_gather(dir, par);
+        vtemp[-dir].start_gather(-dir, par);
+    }
+
+    foralldir(dir) {
+        onsites(par) {
+            VectorBatch<K, Wilson_vector<N, radix>> v = v_out[X];
+            Dirac_Wilson_batch_hop_site(gauge[dir][X], kappa, vtemp[dir][X + dir],
+                                        vtemp[-dir][X - dir], v, dir, sign);
+            v_out[X] = v;
+        }
+    }
+}
+
+/// Apply the hopping term to a batch of K vectors and overwrite v_out
+template <int K, int N, typename radix, typename matrix>
+inline void Dirac_Wilson_hop_set(const Field<matrix> *gauge, const double kappa,
+                                 const Field<VectorBatch<K, Wilson_vector<N, radix>>> &v_in,
+                                 Field<VectorBatch<K, Wilson_vector<N, radix>>> &v_out,
+                                 Parity par, int sign) {
+    Field<VectorBatch<K, half_Wilson_vector<N, radix>>>(&vtemp)[2 * NDIM] =
+        wilson_dirac_temp_batch<K, N, radix>;
+    for (int dir = 0; dir < 2 * NDIM; dir++) {
+        vtemp[dir].copy_boundary_condition(v_in);
+    }
+
+    foralldir(dir) {
+        onsites(opp_parity(par)) {
+            VectorBatch<K, half_Wilson_vector<N, radix>> fwd, bwd;
+            Dirac_Wilson_batch_project(gauge[dir][X], v_in[X], fwd, bwd, dir, sign);
+            vtemp[dir][X] = fwd;
+            vtemp[-dir][X] = bwd;
+        }
+
+        vtemp[dir].start_gather(dir, par);
+        vtemp[-dir].start_gather(-dir, par);
+    }
+    // Set on first Direction
+    Direction dir = Direction(0);
+    onsites(par) {
+        VectorBatch<K, Wilson_vector<N, radix>> v = 0;
+        Dirac_Wilson_batch_hop_site(gauge[dir][X], kappa, vtemp[dir][X + dir],
+                                    vtemp[-dir][X - dir], v, dir, sign);
+        v_out[X] = v;
+    }
+    // Add for all other directions
+    for (int d = 1; d < NDIM; d++) {
+        Direction dir = Direction(d);
+        onsites(par) {
+            VectorBatch<K, Wilson_vector<N, radix>> v = v_out[X];
+            Dirac_Wilson_batch_hop_site(gauge[dir][X], kappa, vtemp[dir][X + dir],
+                                        vtemp[-dir][X - dir], v, dir, sign);
+            v_out[X] = v;
+        }
+    }
+}
 
 /// Calculate derivative  d/dA_x,mu (chi D psi)
 /// Necessary for the HMC force calculation.
@@ -167,6 +318,9 @@ template <typename matrix> class Dirac_Wilson {
     /// The parity this operator applies to
     Parity par = ALL;
 
+    /// Precision of the halo messages in apply() and dagger()
+    hila::halo_precision halo_prec = hila::halo_precision::FULL;
+
     /// Constructor: initialize mass and gauge
     Dirac_Wilson(Dirac_Wilson &d) : gauge(d.gauge), kappa(d.kappa) {}
     /// Constructor: initialize mass and gauge
@@ -179,23 +333,65 @@ template <typename matrix> class Dirac_Wilson {
     Dirac_Wilson(Dirac_Wilson<M> &d, gauge_field_base<matrix> &g)
         : gauge(g.gauge), kappa(d.kappa) {}
 
+    /// Send the halos of the hopping term in reduced precision, see
+    /// Field::set_halo_precision.  The force is always computed in full precision.
+    void set_halo_precision(hila::halo_precision prec) {
+        halo_prec = prec;
+    }
+
     /// Applies the operator to in
     inline void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        Dirac_Wilson_set_halo_precision<N, radix>(halo_prec);
         Dirac_Wilson_diag(in, out, ALL);
         Dirac_Wilson_hop(gauge, kappa, in, out, ALL, 1);
     }
 
     /// Applies the conjugate of the operator
     inline void dagger(const Field<vector_type> &in, Field<vector_type> &out) {
+        Dirac_Wilson_set_halo_precision<N, radix>(halo_prec);
         Dirac_Wilson_diag(in, out, ALL);
         Dirac_Wilson_hop(gauge, kappa, in, out, ALL, -1);
     }
 
+    /// Applies the operator to a batch of K vectors, reading the gauge links once
+    /// for all of them
+    template <int K>
+    inline void apply(const Field<VectorBatch<K, vector_type>> &in,
+                      Field<VectorBatch<K, vector_type>> &out) {
+        Dirac_Wilson_batch_set_halo_precision<K, N, radix>(halo_prec);
+        Dirac_Wilson_diag(in, out, ALL);
+        Dirac_Wilson_hop(gauge, kappa, in, out, ALL, 1);
+    }
+
+    /// Applies the conjugate of the operator to a batch of K vectors
+    template <int K>
+    inline void dagger(const Field<VectorBatch<K, vector_type>> &in,
+                       Field<VectorBatch<K, vector_type>> &out) {
+        Dirac_Wilson_batch_set_halo_precision<K, N, radix>(halo_prec);
+        Dirac_Wilson_diag(in, out, ALL);
+        Dirac_Wilson_hop(gauge, kappa, in, out, ALL, -1);
+    }
+
+    /// Applies the hopping term from the neighbour in direction dir only,
+    /// out(x) = H_dir in(x + dir).  apply() is in + the sum over all 2*NDIM directions.
+    inline void hop_direction(const Field<vector_type> &in, Field<vector_type> &out,
+                              Direction dir) {
+        Dirac_Wilson_hop_direction(gauge, kappa, in, out, dir, 1);
+    }
+
+#if NDIM > 3
+    /// out = gamma5 in.  D^dagger = gamma5 D gamma5, used by the multigrid solver
+    inline void apply_gamma5(const Field<vector_type> &in, Field<vector_type> &out) {
+        out[ALL] = ::gamma5 * in[X];
+    }
+#endif
+
     /// Applies the derivative of the Dirac operator with respect
     /// to the gauge Field
     template <typename momtype>
     inline void force(const Field<vector_type> &chi, const Field<vector_type> &psi,
                       Field<momtype> (&force)[NDIM], int sign = 1) {
+        Dirac_Wilson_set_halo_precision<N, radix>(hila::halo_precision::FULL);
         Dirac_Wilson_calc_force(gauge, kappa, chi, psi, force, ALL, sign);
     }
 };
@@ -255,6 +451,9 @@ template <typename matrix> class Dirac_Wilson_evenodd {
     /// The parity this operator applies to
     Parity par = EVEN;
 
+    /// Precision of the halo messages in apply() and dagger()
+    hila::halo_precision halo_prec = hila::halo_precision::FULL;
+
     /// Constructor: initialize mass and gauge
     Dirac_Wilson_evenodd(Dirac_Wilson_evenodd &d) : gauge(d.gauge), kappa(d.kappa) {}
     /// Constructor: initialize mass and gauge
@@ -268,8 +467,15 @@ template <typename matrix> class Dirac_Wilson_evenodd {
     Dirac_Wilson_evenodd(Dirac_Wilson_evenodd<M> &d, gauge_field_base<matrix> &g)
         : gauge(g.gauge), kappa(d.kappa) {}
 
+    /// Send the halos of the hopping term in reduced precision, see
+    /// Field::set_halo_precision.  The force is always computed in full precision.
+    void set_halo_precision(hila::halo_precision prec) {
+        halo_prec = prec;
+    }
+
     /// Applies the operator to in
     inline void apply(const Field<vector_type> &in, Field<vector_type> &out) {
+        Dirac_Wilson_set_halo_precision<N, radix>(halo_prec);
         Dirac_Wilson_diag(in, out, EVEN);
 
         Dirac_Wilson_hop_set(gauge, kappa, in, out, ODD, 1);
@@ -280,6 +486,34 @@ template <typename matrix> class Dirac_Wilson_evenodd {
 
     /// Applies the conjugate of the operator
     inline void dagger(const Field<vector_type> &in, Field<vector_type> &out) {
+        Dirac_Wilson_set_halo_precision<N, radix>(halo_prec);
+        Dirac_Wilson_diag(in, out, EVEN);
+
+        Dirac_Wilson_hop_set(gauge, kappa, in, out, ODD, -1);
+        Dirac_Wilson_diag_inverse(out, ODD);
+        Dirac_Wilson_hop(gauge, -kappa, out, out, EVEN, -1);
+        out[ODD] = 0;
+    }
+
+    /// Applies the operator to a batch of K vectors, reading the gauge links once
+    /// for all of them
+    template <int K>
+    inline void apply(const Field<VectorBatch<K, vector_type>> &in,
+                      Field<VectorBatch<K, vector_type>> &out) {
+        Dirac_Wilson_batch_set_halo_precision<K, N, radix>(halo_prec);
+        Dirac_Wilson_diag(in, out, EVEN);
+
+        Dirac_Wilson_hop_set(gauge, kappa, in, out, ODD, 1);
+        Dirac_Wilson_diag_inverse(out, ODD);
+        Dirac_Wilson_hop(gauge, -kappa, out, out, EVEN, 1);
+        out[ODD] = 0;
+    }
+
+    /// Applies the conjugate of the operator to a batch of K vectors
+    template <int K>
+    inline void dagger(const Field<VectorBatch<K, vector_type>> &in,
+                       Field<VectorBatch<K, vector_type>> &out) {
+        Dirac_Wilson_batch_set_halo_precision<K, N, radix>(halo_prec);
         Dirac_Wilson_diag(in, out, EVEN);
 
         Dirac_Wilson_hop_set(gauge, kappa, in, out, ODD, -1);
@@ -293,6 +527,7 @@ template <typename matrix> class Dirac_Wilson_evenodd {
     template <typename momtype>
     inline void force(const Field<vector_type> &chi, const Field<vector_type> &psi,
                       Field<momtype> (&force)[NDIM], int sign) {
+        Dirac_Wilson_set_halo_precision<N, radix>(hila::halo_precision::FULL);
         Field<momtype> force2[NDIM];
         Field<vector_type> tmp;
         tmp.copy_boundary_condition(chi);
@@ -32,6 +32,16 @@ class fermion_action : public action_base {
     int MRE_size = 0;
     std::vector<Field<vector_type>> old_chi_inv;
 
+    /// Use CG_mixed for the inversions, see set_mixed_precision()
+    bool mixed_precision = false;
+
+    /// With double precision gauge field, invert with the mixed precision CG_mixed
+    /// instead of a single precision solve followed by a double precision CG.
+    /// Off by default
+    void set_mixed_precision(bool on = true) {
+        mixed_precision = on;
+    }
+
     void setup(int mre_guess_size) {
 #if NDIM > 3
         chi.set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
@@ -56,6 +66,7 @@ class fermion_action : public action_base {
 
     fermion_action(fermion_action &fa) : gauge(fa.gauge), D(fa.D) {
         chi = fa.chi; // Copies the field
+        mixed_precision = fa.mixed_precision;
         setup(fa.MRE_size);
     }
 
@@ -69,6 +80,9 @@ class fermion_action : public action_base {
         }
         // If the gauge type is double precision, solve first in single precision
         if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
+            if (mixed_precision)
+                return;
+
             hila::out0 << "Starting with single precision inversion\n";
 
             auto single_precision = gauge.get_single_precision();
@@ -85,19 +99,35 @@ class fermion_action : public action_base {
         }
     }
 
+    /// Solve psi = 1/(D_dagger D) chi, starting from the initial guess.
+    /// With set_mixed_precision() and double precision gauge field the Krylov
+    /// iterations run in single precision with reliable updates in double, see CG_mixed.
+    void invert(Field<vector_type> &chi, Field<vector_type> &psi) {
+        initial_guess(chi, psi);
+        if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
+            if (mixed_precision) {
+                auto single_precision = gauge.get_single_precision();
+                typename DIRAC_OP::type_flt D_flt(D, single_precision);
+                CG_mixed<DIRAC_OP> inverse(D, D_flt);
+                inverse.apply(chi, psi);
+                return;
+            }
+        }
+        CG<DIRAC_OP> inverse(D);
+        inverse.apply(chi, psi);
+    }
+
     /// Return the value of the action with the current
     /// field configuration
     double action() {
         Field<vector_type> psi;
         psi.copy_boundary_condition(chi);
-        CG<DIRAC_OP> inverse(D);
         double action = 0;
 
         gauge.refresh();
 
         psi = 0;
-        initial_guess(chi, psi);
-        inverse.apply(chi, psi);
+        invert(chi, psi);
         onsites(D.par) { action += chi[X].rdot(psi[X]); }
         return action;
     }
@@ -106,13 +136,11 @@ class fermion_action : public action_base {
     void action(Field<double> &S) {
         Field<vector_type> psi;
         psi.copy_boundary_condition(chi);
-        CG<DIRAC_OP> inverse(D);
 
         gauge.refresh();
 
         psi = 0;
-        initial_guess(chi, psi);
-        inverse.apply(chi, psi);
+        invert(chi, psi);
         onsites(D.par) {
             S[X] += chi[X].rdot(psi[X]);
         }
@@ -149,12 +177,10 @@ class fermion_action : public action_base {
         Mpsi.copy_boundary_condition(chi);
         Field<momtype> force[NDIM], force2[NDIM];
 
-        CG<DIRAC_OP> inverse(D);
         gauge.refresh();
 
         hila::out0 << "base force\n";
-        initial_guess(chi, psi);
-        inverse.apply(chi, psi);
+        invert(chi, psi);
         save_new_solution(psi);
 
         D.apply(psi, Mpsi);
@@ -219,6 +245,16 @@ class Hasenbusch_action_2 : public action_base {
     int MRE_size = 0;
     std::vector<Field<vector_type>> old_chi_inv;
 
+    /// Use CG_mixed for the inversions, see set_mixed_precision()
+    bool mixed_precision = false;
+
+    /// With double precision gauge field, invert with the mixed precision CG_mixed
+    /// instead of a single precision solve followed by a double precision CG.
+    /// Off by default
+    void set_mixed_precision(bool on = true) {
+        mixed_precision = on;
+    }
+
     void setup(int mre_guess_size) {
 #if NDIM > 3
         chi.set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
@@ -245,6 +281,7 @@ class Hasenbusch_action_2 : public action_base {
     Hasenbusch_action_2(Hasenbusch_action_2 &fa)
         : mh(fa.mh), D(fa.D), D_h(fa.D_h), gauge(fa.gauge) {
         chi = fa.chi; // Copies the field
+        mixed_precision = fa.mixed_precision;
         setup(fa.MRE_size);
     }
 
@@ -318,6 +355,9 @@ class Hasenbusch_action_2 : public action_base {
         }
         // If the gauge type is double precision, solve first in single precision
         if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
+            if (mixed_precision)
+                return;
+
             hila::out0 << "Starting with single precision inversion\n";
 
             auto single_precision = gauge.get_single_precision();
@@ -334,6 +374,24 @@ class Hasenbusch_action_2 : public action_base {
         }
     }
 
+    /// Solve psi = 1/(D_dagger D) chi, starting from the initial guess.
+    /// With set_mixed_precision() and double precision gauge field the Krylov
+    /// iterations run in single precision with reliable updates in double, see CG_mixed.
+    void invert(Field<vector_type> &chi, Field<vector_type> &psi) {
+        initial_guess(chi, psi);
+        if constexpr (std::is_same<double, typename gauge_field::basetype>::value) {
+            if (mixed_precision) {
+                auto single_precision = gauge.get_single_precision();
+                typename DIRAC_OP::type_flt D_flt(D, single_precision);
+                CG_mixed<DIRAC_OP> inverse(D, D_flt);
+                inverse.apply(chi, psi);
+                return;
+            }
+        }
+        CG<DIRAC_OP> inverse(D);
+        inverse.apply(chi, psi);
+    }
+
     /// Add new solution to the list
     void save_new_solution(Field<vector_type> &psi) {
         if (MRE_size > 0) {
@@ -354,13 +412,11 @@ class Hasenbusch_action_2 : public action_base {
         Dhchi.copy_boundary_condition(chi);
         Field<momtype> force[NDIM], force2[NDIM];
 
-        CG<DIRAC_OP> inverse(D);
         gauge.refresh();
 
         D_h.dagger(chi, Dhchi);
 
-        initial_guess(Dhchi, psi);
-        inverse.apply(Dhchi, psi);
+        invert(Dhchi, psi);
         save_new_solution(psi);
 
         D.apply(psi, Mpsi);
@@ -375,4 +431,144 @@ class Hasenbusch_action_2 : public action_base {
     }
 };
 
+/// Rational approximation r(x) = norm + sum_i residues[i] / (x + poles[i]),
+/// for the rational HMC.  The coefficients are computed externally (e.g. with the
+/// Remez algorithm) for the required power of x and the spectral range of
+/// D_dagger D.
+struct rational_approximation {
+    double norm = 0;
+    std::vector<double> residues;
+    std::vector<double> poles;
+};
+
+/// The rational HMC fermion action
+///   S = chi_dagger r_action(D_dagger D) chi,
+/// where r_action approximates (D_dagger D)^(-alpha), and the pseudofermion is drawn
+/// with chi = r_heatbath(D_dagger D) eta, r_heatbath approximating
+/// (D_dagger D)^(alpha/2).  For example, a single flavour of even-odd preconditioned
+/// staggered fermions has alpha = 1/4, and a single Wilson flavour alpha = 1/2.
+///
+/// All the poles of a rational function are solved with a single multi-shift CG.
+template <typename gauge_field, typename DIRAC_OP>
+class rational_fermion_action : public action_base {
+  public:
+    using vector_type = typename DIRAC_OP::vector_type;
+    using momtype = SquareMatrix<gauge_field::N, Complex<typename gauge_field::basetype>>;
+    gauge_field &gauge;
+    DIRAC_OP &D;
+    Field<vector_type> chi;
+    rational_approximation r_action, r_heatbath;
+    double accuracy = CG_DEFAULT_ACCURACY;
+
+    void setup() {
+#if NDIM > 3
+        chi.set_boundary_condition(e_t, hila::bc::ANTIPERIODIC);
+        chi.set_boundary_condition(-e_t, hila::bc::ANTIPERIODIC);
+#endif
+    }
+
+    rational_fermion_action(DIRAC_OP &d, gauge_field &g, const rational_approximation &ra,
+                            const rational_approximation &rh)
+        : gauge(g), D(d), r_action(ra), r_heatbath(rh) {
+        chi = 0.0; // Allocates chi and sets it to zero
+        setup();
+    }
+
+    rational_fermion_action(rational_fermion_action &fa)
+        : gauge(fa.gauge), D(fa.D), r_action(fa.r_action), r_heatbath(fa.r_heatbath) {
+        chi = fa.chi; // Copies the field
+        accuracy = fa.accuracy;
+        setup();
+    }
+
+    /// Set the relative accuracy of the multi-shift inversions
+    void set_accuracy(double acc) {
+        accuracy = acc;
+    }
+
+    /// Apply the rational function r(D_dagger D) to in
+    void apply_rational(const rational_approximation &r, Field<vector_type> &in,
+                        Field<vector_type> &out) {
+        std::vector<Field<vector_type>> sol;
+        multishift_CG<DIRAC_OP> inverse(D, r.poles, accuracy);
+        inverse.apply(in, sol);
+
+        out.copy_boundary_condition(in);
+        out[ALL] = 0;
+        out[D.par] = r.norm * in[X];
+        for (int i = 0; i < r.poles.size(); i++) {
+            double a = r.residues[i];
+            onsites(D.par) { out[X] += a * sol[i][X]; }
+        }
+    }
+
+    /// Return the value of the action with the current
+    /// field configuration
+    double action() {
+        Field<vector_type> psi;
+        double action = 0;
+
+        gauge.refresh();
+
+        apply_rational(r_action, chi, psi);
+        onsites(D.par) { action += chi[X].rdot(psi[X]); }
+        return action;
+    }
+
+    /// Calculate the action as a field of double precision numbers
+    void action(Field<double> &S) {
+        Field<vector_type> psi;
+
+        gauge.refresh();
+
+        apply_rational(r_action, chi, psi);
+        onsites(D.par) {
+            S[X] += chi[X].rdot(psi[X]);
+        }
+    }
+
+    /// Generate a pseudofermion field with a distribution given
+    /// by the action chi r_action(D_dagger D) chi
+    void draw_gaussian_fields() {
+        Field<vector_type> eta;
+        eta.copy_boundary_condition(chi);
+        gauge.refresh();
+
+        eta[ALL] = 0;
+        onsites(D.par) {
+            eta[X].gaussian_random();
+        }
+        apply_rational(r_heatbath, eta, chi);
+    }
+
+    /// Update the momentum with the derivative of the fermion
+    /// action.  Each pole contributes like the two flavour force
+    /// with psi = 1/(D_dagger D + pole) chi, weighted by the residue.
+    void force_step(double eps) {
+        Field<vector_type> Mpsi;
+        Mpsi.copy_boundary_condition(chi);
+        Field<momtype> force[NDIM], force2[NDIM], total[NDIM];
+        std::vector<Field<vector_type>> psi;
+
+        gauge.refresh();
+
+        multishift_CG<DIRAC_OP> inverse(D, r_action.poles, accuracy);
+        inverse.apply(chi, psi);
+
+        foralldir(dir) total[dir][ALL] = 0;
+        for (int i = 0; i < r_action.poles.size(); i++) {
+            D.apply(psi[i], Mpsi);
+            Mpsi[D.par] = r_action.residues[i] * Mpsi[X];
+
+            D.force(Mpsi, psi[i], force, 1);
+            D.force(psi[i], Mpsi, force2, -1);
+
+            foralldir(dir) { total[dir][ALL] = total[dir][X] + force[dir][X] + force2[dir][X]; }
+        }
+
+        foralldir(dir) { total[dir][ALL] = -eps * total[dir][X]; }
+        gauge.add_momentum(total);
+    }
+};
+
 #endif
\ No newline at end of file
@@ -23,6 +23,14 @@
 #%         sites. Default layout stores even lattice sites first, enabling efficient
 #%         looping over parities (EVEN/ODD).
 #%   NO_INTERLEAVE=1         - turn off compute during MPI communications (default: on)
+#%   SHARED_HALO=1           - exchange halos with ranks on the same host through MPI-3
+#%         shared memory windows (default: off)
+#%   LOW_MEMORY_LATTICE=1    - compute coordinates and on-node neighbours from the site
+#%         index instead of per-site tables (CPU only, default: off)
+#%   TILED_SITE_ORDER=<n>    - store sites of each parity in n^NDIM tiles instead of typewriter
+#%         order, improving cache reuse of stencil loops (CPU only, default: off)
+#%   NODE_LAYOUT_HOST=1      - give the ranks of each host a compact block of nodes, found
+#%         at run time, instead of blocks of NODE_LAYOUT_BLOCK ranks (default: off)
 #% GPU-relevant options:
 #%   GPU_AWARE_MPI=0         - turn off GPU aware MPI (default: on) 
 #%   GPU_SYNCHRONIZE_TIMERS=1 - Synchronize timers with GPU kernels.
@@ -145,6 +153,30 @@ ifdef NO_INTERLEAVE
 HILAPP_OPTS += --no-interleave
 endif
 
+ifdef SHARED_HALO
+ifneq ($(SHARED_HALO),0)
+HILA_OPTS += -DMPI_SHARED_HALO
+endif
+endif
+
+ifdef LOW_MEMORY_LATTICE
+ifneq ($(LOW_MEMORY_LATTICE),0)
+HILA_OPTS += -DLOW_MEMORY_LATTICE
+endif
+endif
+
+ifdef TILED_SITE_ORDER
+ifneq ($(TILED_SITE_ORDER),0)
+HILA_OPTS += -DTILED_SITE_ORDER -DSITE_TILE_SIZE=$(TILED_SITE_ORDER)
+endif
+endif
+
+ifdef NODE_LAYOUT_HOST
+ifneq ($(NODE_LAYOUT_HOST),0)
+HILA_OPTS += -DNODE_LAYOUT_HOST
+endif
+endif
+
 ifdef GPU_SYNCHRONIZE_TIMERS
 HILA_OPTS += -DGPU_SYNCHRONIZE_TIMERS
 endif
@@ -4,6 +4,7 @@
 #include "hila.h"
 
 #include <algorithm>
+#include <limits>
 
 #include "gpucub.h"
 
@@ -87,7 +88,8 @@
  * std::vector<SiteIndex> hila::Clusters::cluster_ref::sites() - vector of cluster sites
  * uint8_t hila::Clusters::cluster_ref::type() - the type of the cluster, 0..254
  *
- * area() and sites() are expensive operators and must be called by all MPI ranks
+ * area() and sites() are expensive operators and must be called by all MPI ranks.  The first
+ * area() call computes the areas of all clusters in one pass, the later calls are cheap.
  * Area is defined by the number of links where one end belongs to the cluster, another does not.
  *
  * Example:
@@ -109,6 +111,29 @@
  *           hila::out0 << s.coordinates() << '\n';
  *      }
  *
+ * Distributed mode:
+ *
+ * By default the cluster list is merged on rank 0 and broadcast, so that every rank holds
+ * the full list.  With very many clusters this costs memory and serial merge time.  In the
+ * distributed mode the cluster records are sharded by a hash of the label: each label is
+ * owned by one rank, and the partial sizes are sent to the owners with one all-to-all
+ * exchange.  Indexing with [] is not available, queries are collective:
+ *
+ * void hila::Clusters::set_distributed(bool) - choose the mode, before find()
+ * size_t hila::Clusters::number() - total number of clusters (reduction)
+ * int64_t hila::Clusters::cluster_size(uint64_t label) - size of the cluster with label
+ * int64_t hila::Clusters::cluster_area(uint64_t label) - area of the cluster with label
+ * std::vector<int64_t> hila::Clusters::size_histogram(int64_t max_size) - number of
+ *      clusters of size 0 .. max_size, larger clusters are counted in the last bin
+ * void hila::Clusters::make_full_list() - gather the full list to all ranks, after which
+ *      the object behaves as in the default mode
+ *
+ * Example:
+ *      hila::Clusters cl;
+ *      cl.set_distributed();
+ *      cl.find(cltypes);
+ *      auto hist = cl.size_histogram(100);
+ *      hila::out0 << "Number of clusters " << cl.number() << ", of size 1: " << hist[1] << '\n';
  *
  */
 
@@ -144,12 +169,72 @@ class Clusters {
     struct cl_struct {
         uint64_t label;
         int64_t size;
+
+        // resolve std::swap vs hila::swap in std::sort
+        friend void swap(cl_struct &a, cl_struct &b) {
+            cl_struct t = a;
+            a = b;
+            b = t;
+        }
     };
 
-    // clist vector contains information for all clusters. NOTE: the
-    // content is valid only on rank == 0.
+    // clist vector contains information for all clusters, sorted by label.  In distributed
+    // mode it contains only the clusters whose label is owned by this rank.
     std::vector<cl_struct> clist;
 
+    // distributed mode, and the total number of clusters in it
+    bool distributed = false;
+    size_t n_clusters = 0;
+
+    // areas of the clusters in clist, computed on demand by make_area_list()
+    mutable std::vector<int64_t> alist;
+    mutable bool areas_done = false;
+
+    /// rank owning the record of label in distributed mode - mix the bits so that
+    /// neighbouring labels spread evenly
+    static int label_owner(uint64_t label) {
+        uint64_t h = label;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h % hila::number_of_nodes();
+    }
+
+    /// index of label in local clist, -1 if not found
+    int64_t find_label(uint64_t label) const {
+        auto it = std::lower_bound(
+            clist.begin(), clist.end(), label,
+            [](const cl_struct &c, uint64_t l) { return c.label < l; });
+        if (it == clist.end() || it->label != label)
+            return -1;
+        return it - clist.begin();
+    }
+
+    /// MPI datatype of one cl_struct record.  Counts in records instead of bytes do not
+    /// overflow at 2 GiB.  Free with MPI_Type_free()
+    static MPI_Datatype cl_mpi_type() {
+        MPI_Datatype t;
+        MPI_Type_contiguous(sizeof(cl_struct), MPI_BYTE, &t);
+        MPI_Type_commit(&t);
+        return t;
+    }
+
+    /// sort cl_struct list and merge entries with the same label
+    static void merge_clist(std::vector<cl_struct> &list) {
+        std::sort(list.begin(), list.end(),
+                  [](const cl_struct &a, const cl_struct &b) { return a.label < b.label; });
+        size_t n = 0;
+        for (size_t i = 0; i < list.size(); i++) {
+            if (n > 0 && list[n - 1].label == list[i].label)
+                list[n - 1].size += list[i].size;
+            else
+                list[n++] = list[i];
+        }
+        list.resize(n);
+    }
+
     class cluster_ref {
         const Clusters &clusters;
         size_t index;
@@ -177,21 +262,10 @@ class Clusters {
 
         /// @brief returns the area of the cluster
         /// Must be called from all MPI ranks - involves reduction
+        /// The areas of all clusters are computed on the first call
         int64_t area() const {
-
-            uint64_t lbl = clusters.clist[index].label;
-            int64_t cl_area = 0;
-
-            onsites (ALL) {
-                if (clusters.labels[X] == lbl) {
-                    for (Direction d = e_x; d < NDIRS; ++d) {
-                        if (clusters.labels[X + d] != lbl)
-                            cl_area += 1;
-                    }
-                }
-            }
-
-            return cl_area;
+            clusters.make_area_list();
+            return clusters.alist[index];
         }
 
         /// @brief returns std::vector of SiteIndex for cluster
@@ -251,6 +325,11 @@ class Clusters {
     inline void make_local_clist();
 
     void assert_cl_index(size_t i) const {
+        if (distributed) {
+            hila::out0 << "hila::Clusters: no cluster indexing in distributed mode, call "
+                          "make_full_list() first\n";
+            hila::terminate(1);
+        }
         if (i >= clist.size()) {
             hila::out0 << "Incorrect cluster index " << i << ", there are only " << clist.size()
                        << " clusters\n";
@@ -303,12 +382,89 @@ class Clusters {
 
     /// @brief number of clusters found
     size_t number() const {
-        return clist.size();
+        return distributed ? n_clusters : clist.size();
     }
 
     /// @brief number of clusters found
     size_t size() const {
-        return clist.size();
+        return number();
+    }
+
+    /// @brief keep the cluster records distributed over ranks, see the description at the top.
+    /// Must be set before find() or classify()
+    void set_distributed(bool on = true) {
+        distributed = on;
+    }
+
+    bool is_distributed() const {
+        return distributed;
+    }
+
+    /// @brief size of the cluster with given label, 0 if there is no such cluster.
+    /// Must be called from all MPI ranks in distributed mode
+    int64_t cluster_size(uint64_t label) const {
+        int64_t i = find_label(label);
+        int64_t sz = (i >= 0) ? clist[i].size : 0;
+        if (distributed)
+            hila::broadcast(sz, label_owner(label));
+        return sz;
+    }
+
+    /// @brief area of the cluster with given label, 0 if there is no such cluster, see
+    /// cluster_ref::area().  Must be called from all MPI ranks
+    int64_t cluster_area(uint64_t label) const {
+        make_area_list();
+        int64_t i = find_label(label);
+        int64_t a = (i >= 0) ? alist[i] : 0;
+        if (distributed)
+            hila::broadcast(a, label_owner(label));
+        return a;
+    }
+
+    /// @brief histogram of cluster sizes: element s is the number of clusters of size s,
+    /// clusters larger than max_size are counted in element max_size.
+    /// Must be called from all MPI ranks in distributed mode
+    std::vector<int64_t> size_histogram(int64_t max_size) const {
+        std::vector<int64_t> hist(max_size + 1, 0);
+        for (const auto &c : clist)
+            hist[std::min(c.size, max_size)]++;
+        if (distributed)
+            hila::reduce_node_sum(hist.data(), hist.size());
+        return hist;
+    }
+
+    /// @brief gather the distributed cluster list to all ranks and switch to the default mode.
+    /// Must be called from all MPI ranks
+    void make_full_list() {
+        if (!distributed)
+            return;
+
+        int nn = hila::number_of_nodes();
+        std::vector<int> counts(nn), displs(nn);
+        int n = clist.size();
+        MPI_Allgather(&n, 1, MPI_INT, counts.data(), 1, MPI_INT, lattice->mpi_comm_lat);
+        int64_t total = 0;
+        for (int r = 0; r < nn; r++) {
+            displs[r] = total;
+            total += counts[r];
+        }
+        if (total > std::numeric_limits<int>::max()) {
+            hila::out0 << "hila::Clusters::make_full_list(): " << total
+                       << " clusters is too many for the full list\n";
+            hila::terminate(1);
+        }
+
+        std::vector<cl_struct> full(total);
+        MPI_Datatype cl_type = cl_mpi_type();
+        MPI_Allgatherv(clist.data(), n, cl_type, full.data(), counts.data(), displs.data(),
+                       cl_type, lattice->mpi_comm_lat);
+        MPI_Type_free(&cl_type);
+
+        // labels are unique across the shards, only sorting needed
+        merge_clist(full);
+        clist = std::move(full);
+        distributed = false;
+        areas_done = false;
     }
 
     /// @brief access cluster number i
@@ -318,6 +474,8 @@ class Clusters {
     }
 
 
+    /// iteration over clusters; in distributed mode goes through the clusters owned by
+    /// this rank, and only the non-collective size(), type() and label() can be used
     cluster_ref begin() {
         return cluster_ref(*this, 0);
     }
@@ -406,9 +564,15 @@ class Clusters {
         }
 
         clist.clear();
+        areas_done = false;
 
         make_local_clist();
 
+        if (distributed) {
+            distribute_clist();
+            return;
+        }
+
         // Now merge the clist across mpi ranks
         // communicate and merge in node pairs
 
@@ -459,6 +623,107 @@ class Clusters {
 
     } // void classify()
 
+  private:
+    /// @brief send the local cluster records to the label owners in one all-to-all
+    /// exchange and merge them there
+    void distribute_clist() {
+        send_to_owners(clist);
+        n_clusters = clist.size();
+        hila::reduce_node_sum(n_clusters);
+    }
+
+    /// send the records in list to the ranks owning their labels, list is replaced by
+    /// the merged records owned by this rank
+    static void send_to_owners(std::vector<cl_struct> &list) {
+
+        int nn = hila::number_of_nodes();
+
+        std::vector<int> send_count(nn, 0), recv_count(nn), send_displ(nn), recv_displ(nn);
+        std::vector<int> owner(list.size());
+        for (size_t i = 0; i < list.size(); i++) {
+            owner[i] = label_owner(list[i].label);
+            send_count[owner[i]]++;
+        }
+
+        std::vector<cl_struct> sendbuf(list.size());
+        int s = 0;
+        for (int r = 0; r < nn; r++) {
+            send_displ[r] = s;
+            s += send_count[r];
+        }
+        std::vector<int> pos(send_displ);
+        for (size_t i = 0; i < list.size(); i++)
+            sendbuf[pos[owner[i]]++] = list[i];
+
+        MPI_Alltoall(send_count.data(), 1, MPI_INT, recv_count.data(), 1, MPI_INT,
+                     lattice->mpi_comm_lat);
+
+        int64_t n = 0;
+        for (int r = 0; r < nn; r++) {
+            recv_displ[r] = n;
+            n += recv_count[r];
+        }
+        if (n > std::numeric_limits<int>::max())
+            hila::error("hila::Clusters: too many cluster records on one rank");
+
+        // counts in records
+        list.resize(n);
+        MPI_Datatype cl_type = cl_mpi_type();
+        MPI_Alltoallv(sendbuf.data(), send_count.data(), send_displ.data(), cl_type,
+                      list.data(), recv_count.data(), recv_displ.data(), cl_type,
+                      lattice->mpi_comm_lat);
+        MPI_Type_free(&cl_type);
+
+        merge_clist(list);
+    }
+
+    /// compute the areas of all clusters in one pass: count the boundary links of each
+    /// site, and accumulate the counts to the labels of the sites.  Collective
+    void make_area_list() const {
+        if (areas_done)
+            return;
+
+        Field<int> faces;
+        onsites (ALL) {
+            int n = 0;
+            if (get_cl_label_type(labels[X]) != hila::Clusters::background) {
+                for (Direction d = e_x; d < NDIRS; ++d) {
+                    if (labels[X + d] != labels[X])
+                        n++;
+                }
+            }
+            faces[X] = n;
+        }
+
+        std::vector<uint64_t> lb;
+        std::vector<int> nf;
+        labels.copy_local_data(lb);
+        faces.copy_local_data(nf);
+
+        // (label, area) records of this rank, size field holds the area
+        std::vector<cl_struct> local;
+        for (size_t i = 0; i < lb.size(); i++) {
+            if (nf[i] > 0)
+                local.push_back({lb[i], nf[i]});
+        }
+        merge_clist(local);
+        if (distributed)
+            send_to_owners(local);
+
+        alist.assign(clist.size(), 0);
+        for (const auto &c : local) {
+            int64_t i = find_label(c.label);
+            if (i >= 0)
+                alist[i] += c.size;
+        }
+        if (!distributed)
+            hila::reduce_node_sum(alist.data(), alist.size(), true);
+
+        areas_done = true;
+    }
+
+  public:
+
 
 }; // class clusters
 
@@ -7,6 +7,9 @@
 
 #include "datatypes/extended.h"
 
+#include <cstring>
+#include <set>
+
 
 // declare MPI timers here too - these were externs
 
@@ -21,11 +24,23 @@ hila::timer broadcast_timer("MPI broadcast");
 hila::timer send_timer("MPI send field");
 hila::timer drop_comms_timer("MPI wait drop_comms");
 hila::timer partition_sync_timer("partition sync");
+hila::timer reduction_batch_timer("MPI reduction batch");
 
 // let us house the partitions-struct here
 
 hila::partitions_struct hila::partitions;
 
+hila::gather_batch_struct hila::gather_batch;
+
+hila::shared_halo_struct hila::shared_halo;
+
+hila::reduction_batch_struct hila::reduction_batch;
+
+hila::mpi_progress_struct hila::mpi_progress;
+
+// thread support level given by MPI_Init_thread
+static int mpi_thread_level = MPI_THREAD_SINGLE;
+
 /* Keep track of whether MPI has been initialized */
 static bool mpi_initialized = false;
 
@@ -47,6 +62,9 @@ static int n_float = 0;
 // static var holding the allreduce state
 static bool allreduce_on = true;
 
+// and the parallel (MPI-IO) file access state
+static bool parallel_io_on = false;
+
 void hila_reduce_double_setup(double *d, int n) {
 
     // ensure there's enough space
@@ -139,22 +157,53 @@ bool hila::get_allreduce() {
     return allreduce_on;
 }
 
+/// set collective MPI-IO on or off in binary field I/O
+void hila::set_parallel_io(bool on) {
+    parallel_io_on = on;
+}
+
+bool hila::get_parallel_io() {
+    return parallel_io_on;
+}
+
 ////////////////////////////////////////////////////////////////////////
 
 
 /* Machine initialization */
 #include <sys/types.h>
+
+/// The progress thread needs MPI_THREAD_MULTIPLE, which has to be requested in
+/// MPI_Init_thread(), before hila::cmdline can parse the command line (it needs the rank).
+/// Thus "-mpi_progress on" is looked up here directly.  This is the only place where the
+/// thread level is decided; hila::initialize() parses and checks the flag normally
+/// afterwards and starts the thread, which it can do only if MPI_THREAD_MULTIPLE was
+/// requested here.
+static bool mpi_progress_flag_on(int argc, char **argv) {
+    for (int i = 1; i < argc - 1; i++) {
+        if (std::strcmp(argv[i], "-mpi_progress") == 0)
+            return std::strcmp(argv[i + 1], "on") == 0;
+    }
+    return false;
+}
+
 void hila::initialize_communications(int &argc, char ***argv) {
     /* Init MPI */
     if (!mpi_initialized) {
 
+        bool want_progress = mpi_progress_flag_on(argc, *argv);
+
 #ifndef OPENMP
-        MPI_Init(&argc, argv);
+        if (want_progress)
+            MPI_Init_thread(&argc, argv, MPI_THREAD_MULTIPLE, &mpi_thread_level);
+        else
+            MPI_Init(&argc, argv);
 
 #else
 
         int provided;
-        MPI_Init_thread(&argc, argv, MPI_THREAD_FUNNELED, &provided);
+        MPI_Init_thread(&argc, argv, want_progress ? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED,
+                        &provided);
+        mpi_thread_level = provided;
         if (provided < MPI_THREAD_FUNNELED) {
             if (hila::myrank() == 0)
                 hila::out << "MPI could not provide MPI_THREAD_FUNNELED, exiting\n";
@@ -189,6 +238,8 @@ void hila::abort_communications(int status) {
 
 /* clean exit from all nodes */
 void hila::finish_communications() {
+    hila::mpi_progress.stop();
+    hila::shared_halo.finish();
     // turn off mpi -- this is needed to avoid mpi calls in destructors
     mpi_initialized = false;
     hila::about_to_finish = true;
@@ -282,6 +333,66 @@ int get_next_msg_tag() {
     return tag;
 }
 
+/// Persistent requests keep their tag, use a range above the cyclic tags.  Each field
+/// gets a comm slot when it is allocated, and the tag is determined by the slot,
+/// direction and parity, so that the messages of different fields cannot be mixed.
+/// Fields are allocated and freed in the same order on all ranks (the program is SPMD),
+/// thus the slots agree.  If there are more live fields than tags, the slots wrap around;
+/// the messages of fields sharing a slot are then matched in the order they are started,
+/// which is the same on all ranks.
+
+#define PERSISTENT_TAG_MIN 2000
+#define PERSISTENT_TAGS_PER_SLOT (3 * NDIRS)
+
+static std::set<int> free_comm_slots;
+static int n_comm_slots = 0;
+static int max_comm_slots = 0;
+
+int hila::allocate_comm_slot() {
+    if (free_comm_slots.empty())
+        return n_comm_slots++;
+    int slot = *free_comm_slots.begin();
+    free_comm_slots.erase(free_comm_slots.begin());
+    return slot;
+}
+
+void hila::free_comm_slot(int slot) {
+    if (slot == n_comm_slots - 1) {
+        n_comm_slots--;
+        // drop trailing free slots too
+        while (!free_comm_slots.empty() && *free_comm_slots.rbegin() == n_comm_slots - 1) {
+            free_comm_slots.erase(std::prev(free_comm_slots.end()));
+            n_comm_slots--;
+        }
+    } else {
+        free_comm_slots.insert(slot);
+    }
+}
+
+int get_persistent_msg_tag(int slot, Direction d, Parity par) {
+    if (max_comm_slots == 0) {
+        // MPI guarantees tags up to 32767, usually there are more
+        int tag_ub = 32767;
+        int *attr, flag = 0;
+        if (hila::is_comm_initialized())
+            MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &attr, &flag);
+        if (flag)
+            tag_ub = *attr;
+        max_comm_slots = (tag_ub - PERSISTENT_TAG_MIN + 1) / PERSISTENT_TAGS_PER_SLOT;
+    }
+    if (slot >= max_comm_slots) {
+        static bool warned = false;
+        if (!warned) {
+            hila::out0 << "Note: more than " << max_comm_slots
+                       << " fields with persistent gathers, message tags are shared\n";
+            warned = true;
+        }
+        slot %= max_comm_slots;
+    }
+    return PERSISTENT_TAG_MIN + slot * PERSISTENT_TAGS_PER_SLOT + ((int)par - 1) * NDIRS +
+           (int)d;
+}
+
 
 /// Split the communicator to subvolumes, using MPI_Comm_split
 /// New MPI_Comm is the global mpi_comm_lat
@@ -378,3 +489,464 @@ void reduce_node_sum_extended(ExtendedPrecision *value, int send_count, bool all
     }
     reduction_timer.stop();
 }
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/// Gather batching: start collecting the halo messages of start_gather().  Earlier
+/// batch is completed first, so that at most one batch is in flight.
+
+void hila::gather_batch_struct::begin() {
+    if (done_id != id)
+        wait(id);
+
+    sends.clear();
+    receives.clear();
+    ++id;
+#if defined(CUDA) || defined(HIP)
+    // the halo buffers are in device memory, packing would need extra copies
+    collecting = false;
+#else
+    collecting = enabled && hila::number_of_nodes() > 1;
+#endif
+    if (!collecting)
+        done_id = id;
+}
+
+unsigned hila::gather_batch_struct::add_send(int rank, void *buf, size_t size) {
+    sends.push_back({rank, (char *)buf, size});
+    return id;
+}
+
+unsigned hila::gather_batch_struct::add_receive(int rank, void *buf, size_t size) {
+    receives.push_back({rank, (char *)buf, size});
+    return id;
+}
+
+/// Collect the segments to messages, one per rank.  The segments to/from a rank are
+/// in the same order on both ends, because all nodes register the gathers in the same
+/// order.  A message with a single segment uses the field buffer directly.
+
+void hila::gather_batch_struct::make_messages(std::vector<segment> &seg,
+                                              std::vector<message> &msg, bool pack) {
+    msg.resize(0);
+    for (auto &s : seg) {
+        int m = 0;
+        while (m < msg.size() && msg[m].rank != s.rank)
+            m++;
+        if (m == msg.size()) {
+            msg.emplace_back();
+            msg[m].rank = s.rank;
+            msg[m].size = 0;
+            msg[m].buf = s.buf;
+        }
+        msg[m].size += s.size;
+    }
+
+    for (auto &m : msg) {
+        if (m.size >= (1ULL << 31)) {
+            hila::out << "Too large MPI message!  Size " << m.size << '\n';
+            hila::terminate(1);
+        }
+        bool single = false;
+        for (auto &s : seg) {
+            if (s.rank == m.rank) {
+                single = (s.size == m.size);
+                break;
+            }
+        }
+        if (!single) {
+            m.data.resize(m.size);
+            m.buf = m.data.data();
+        }
+    }
+
+    if (pack) {
+        std::vector<size_t> pos(msg.size(), 0);
+        for (auto &s : seg) {
+            int m = 0;
+            while (msg[m].rank != s.rank)
+                m++;
+            if (msg[m].buf != s.buf)
+                std::memcpy(msg[m].buf + pos[m], s.buf, s.size);
+            pos[m] += s.size;
+        }
+    }
+}
+
+/// Send the collected halos, one message per neighbour rank
+
+void hila::gather_batch_struct::flush() {
+
+    if (!collecting)
+        return;
+    collecting = false;
+
+    // keep the tags in sync on all nodes
+    int tag = get_next_msg_tag();
+
+    if (sends.size() == 0 && receives.size() == 0) {
+        done_id = id;
+        return;
+    }
+
+    make_messages(receives, receive_msg, false);
+    make_messages(sends, send_msg, true);
+
+    post_receive_timer.start();
+    for (auto &m : receive_msg) {
+        MPI_Irecv(m.buf, (int)m.size, MPI_BYTE, m.rank, tag, lattice->mpi_comm_lat, &m.request);
+        hila::mpi_progress.add(&m.request);
+    }
+    post_receive_timer.stop();
+
+    start_send_timer.start();
+    for (auto &m : send_msg) {
+        MPI_Isend(m.buf, (int)m.size, MPI_BYTE, m.rank, tag, lattice->mpi_comm_lat, &m.request);
+        hila::mpi_progress.add(&m.request);
+    }
+    start_send_timer.stop();
+}
+
+/// Complete the batch batch_id if it is still in flight, and unpack the received
+/// messages to the field buffers
+
+void hila::gather_batch_struct::wait(unsigned batch_id) {
+
+    if (batch_id != id || done_id == id)
+        return;
+
+    wait_receive_timer.start();
+    std::vector<size_t> pos(receive_msg.size(), 0);
+    for (auto &m : receive_msg)
+        hila::mpi_progress.wait(&m.request);
+
+    for (auto &s : receives) {
+        int m = 0;
+        while (receive_msg[m].rank != s.rank)
+            m++;
+        if (receive_msg[m].buf != s.buf)
+            std::memcpy(s.buf, receive_msg[m].buf + pos[m], s.size);
+        pos[m] += s.size;
+    }
+    wait_receive_timer.stop();
+
+    wait_send_timer.start();
+    for (auto &m : send_msg)
+        hila::mpi_progress.wait(&m.request);
+    wait_send_timer.stop();
+
+    done_id = id;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/// Set up the shared memory halo arenas for the ranks of comm on the same host.
+/// Collective over comm.
+
+void hila::shared_halo_struct::setup(MPI_Comm comm) {
+
+    if (host_comm != MPI_COMM_NULL)
+        return;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &host_comm);
+
+    int n_host, n_comm;
+    MPI_Comm_size(host_comm, &n_host);
+    MPI_Comm_rank(host_comm, &host_rank);
+    MPI_Comm_size(comm, &n_comm);
+
+    // header has the copy counters of the host ranks, each on its own cache line
+    header_size = 64 * n_host;
+    arena_size = header_size + SHARED_HALO_ARENA_SIZE;
+    MPI_Win_allocate_shared(arena_size, 1, MPI_INFO_NULL, host_comm, &arena, &win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+
+    for (int i = 0; i < n_host; i++)
+        new (counter(arena, i)) std::atomic<uint64_t>(0);
+    n_packed.assign(n_host, 0);
+    used = header_size;
+
+    // find the ranks in comm of the ranks on this host
+    std::vector<int> host_ranks(n_host), comm_ranks(n_host);
+    for (int i = 0; i < n_host; i++)
+        host_ranks[i] = i;
+
+    MPI_Group host_group, comm_group;
+    MPI_Comm_group(host_comm, &host_group);
+    MPI_Comm_group(comm, &comm_group);
+    MPI_Group_translate_ranks(host_group, n_host, host_ranks.data(), comm_group,
+                              comm_ranks.data());
+    MPI_Group_free(&host_group);
+    MPI_Group_free(&comm_group);
+
+    peer_arena.assign(n_comm, nullptr);
+    peer_host_rank.assign(n_comm, -1);
+    for (int i = 0; i < n_host; i++) {
+        MPI_Aint size;
+        int disp_unit;
+        char *ptr;
+        MPI_Win_shared_query(win, i, &size, &disp_unit, &ptr);
+        peer_arena[comm_ranks[i]] = ptr;
+        peer_host_rank[comm_ranks[i]] = i;
+    }
+
+    // counters are initialized before anybody uses them
+    MPI_Win_sync(win);
+    MPI_Barrier(host_comm);
+
+    hila::out0 << "Shared memory halo exchange: " << n_host
+               << " ranks on the host of rank 0, arena size " << SHARED_HALO_ARENA_SIZE
+               << " bytes\n";
+}
+
+void hila::shared_halo_struct::finish() {
+    if (host_comm != MPI_COMM_NULL) {
+        MPI_Win_unlock_all(win);
+        MPI_Win_free(&win);
+        MPI_Comm_free(&host_comm);
+        host_comm = MPI_COMM_NULL;
+        peer_arena.clear();
+        peer_host_rank.clear();
+    }
+}
+
+int64_t hila::shared_halo_struct::allocate(size_t size, int rank) {
+
+    if (used > header_size) {
+        // start from the beginning if all packed halos have been copied
+        MPI_Win_sync(win);
+        bool all_copied = true;
+        for (size_t i = 0; i < n_packed.size() && all_copied; i++)
+            all_copied = (counter(arena, i)->load(std::memory_order_acquire) == n_packed[i]);
+        if (all_copied)
+            used = header_size;
+    }
+
+    // keep the halos aligned to cache lines
+    size_t asize = (size + 63) & ~(size_t)63;
+    if (used + asize > arena_size)
+        return -1;
+    int64_t offset = used;
+    used += asize;
+    n_packed[peer_host_rank[rank]]++;
+    return offset;
+}
+
+void hila::shared_halo_struct::copied(int rank) {
+    // the copy is done before the sender sees the counter
+    counter(peer_arena[rank], host_rank)->fetch_add(1, std::memory_order_release);
+    MPI_Win_sync(win);
+}
+
+int hila::shared_halo_struct::tag(int slot, Direction d, Parity par) const {
+    // a direction and parity goes either through the arena or as a message, thus
+    // the persistent tag is free
+    return get_persistent_msg_tag(slot, d, par);
+}
+
+#define SHARED_FALLBACK_TAG_MIN 600 // below PERSISTENT_TAG_MIN
+#define SHARED_FALLBACK_TAG_NUMBER 1000
+
+int hila::shared_halo_struct::fallback_tag() {
+    static int n = 0;
+    n = (n + 1) % SHARED_FALLBACK_TAG_NUMBER;
+    return SHARED_FALLBACK_TAG_MIN + n;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/// Reduction batch.  The summation operation reads the layout of the packed buffer
+/// from batch_layout.  The buffer is reduced as a single element of a contiguous type,
+/// so that MPI does not split it.
+/// NOTE: batch_layout is a static set by flush(), thus the operation is not reentrant.
+/// This is fine as long as only one batch is in flight (flush() waits for the previous
+/// one) and the batches are reduced only from the main thread.
+
+static const std::vector<hila::reduction_batch_struct::segment> *batch_layout = nullptr;
+static MPI_Op batch_sum_op;
+
+template <typename T>
+static void batch_add(const char *in, char *inout, size_t size) {
+    const T *a = (const T *)in;
+    T *b = (T *)inout;
+    for (size_t i = 0; i < size / sizeof(T); i++)
+        b[i] += a[i];
+}
+
+static void batch_sum_function(void *in, void *inout, int *len, MPI_Datatype *datatype) {
+    using kind_t = hila::reduction_batch_struct::kind_t;
+
+    for (auto &s : *batch_layout) {
+        const char *a = (const char *)in + s.offset;
+        char *b = (char *)inout + s.offset;
+        switch (s.kind) {
+        case kind_t::DOUBLE:
+            batch_add<double>(a, b, s.size);
+            break;
+        case kind_t::FLOAT:
+            batch_add<float>(a, b, s.size);
+            break;
+        case kind_t::INT32:
+            batch_add<int32_t>(a, b, s.size);
+            break;
+        case kind_t::INT64:
+            batch_add<int64_t>(a, b, s.size);
+            break;
+        case kind_t::UINT32:
+            batch_add<uint32_t>(a, b, s.size);
+            break;
+        case kind_t::UINT64:
+            batch_add<uint64_t>(a, b, s.size);
+            break;
+        case kind_t::LONG_DOUBLE:
+            batch_add<long double>(a, b, s.size);
+            break;
+        case kind_t::EXTENDED:
+            batch_add<ExtendedPrecision>(a, b, s.size);
+            break;
+        }
+    }
+}
+
+void hila::reduction_batch_struct::remove(int &state) {
+    for (int i = 0; i < pending.size(); i++) {
+        if (pending[i].state == &state) {
+            pending.erase(pending.begin() + i);
+            state = NONE;
+            return;
+        }
+    }
+}
+
+void hila::reduction_batch_struct::flush() {
+
+    if (pending.size() == 0)
+        return;
+
+    // only one batch in flight
+    wait();
+
+    reduction_batch_timer.start();
+
+    static bool op_created = false;
+    if (!op_created) {
+        MPI_Op_create(&batch_sum_function, true, &batch_sum_op);
+        op_created = true;
+    }
+
+    in_flight.swap(pending);
+    pending.clear();
+
+    // pack, keeping the values aligned
+    size_t total = 0;
+    for (auto &s : in_flight) {
+        s.offset = total;
+        total += (s.size + 15) & ~(size_t)15;
+    }
+    buffer.resize(total);
+    for (auto &s : in_flight) {
+        std::memcpy(buffer.data() + s.offset, s.ptr, s.size);
+        *s.state = IN_FLIGHT;
+    }
+
+    batch_layout = &in_flight;
+    MPI_Type_contiguous((int)total, MPI_BYTE, &dtype);
+    MPI_Type_commit(&dtype);
+    MPI_Iallreduce(MPI_IN_PLACE, buffer.data(), 1, dtype, batch_sum_op, lattice->mpi_comm_lat,
+                   &request);
+    comm_is_on = true;
+
+    n_reductions += in_flight.size();
+    n_collectives++;
+
+    reduction_batch_timer.stop();
+}
+
+void hila::reduction_batch_struct::wait() {
+
+    if (!comm_is_on)
+        return;
+
+    reduction_wait_timer.start();
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    reduction_wait_timer.stop();
+
+    MPI_Type_free(&dtype);
+    comm_is_on = false;
+
+    for (auto &s : in_flight) {
+        std::memcpy(s.ptr, buffer.data() + s.offset, s.size);
+        *s.state = NONE;
+    }
+    in_flight.clear();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////
+/// MPI progress thread.  The thread tests the registered requests in a loop; completed
+/// requests are dropped from the list.  MPI_Wait() on a request the thread has
+/// completed returns immediately.  The lock ensures that the thread does not touch a
+/// request while the main thread waits for it or frees it.  The lock is held only for
+/// one sweep of MPI_Test calls, between the sweeps the thread sleeps briefly, and when
+/// there are no requests it waits on a condition variable until add() is called.
+
+// pause between the sweeps over the requests
+#define MPI_PROGRESS_INTERVAL_US 20
+
+bool hila::mpi_progress_struct::start() {
+    if (on)
+        return true;
+    if (mpi_thread_level < MPI_THREAD_MULTIPLE || hila::number_of_nodes() == 1)
+        return false;
+
+    running = true;
+    on = true;
+    worker = std::thread(&hila::mpi_progress_struct::loop, this);
+    return true;
+}
+
+void hila::mpi_progress_struct::stop() {
+    if (!on)
+        return;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+    }
+    has_work.notify_one();
+    worker.join();
+    on = false;
+    requests.clear();
+}
+
+void hila::mpi_progress_struct::remove(MPI_Request *req) {
+    if (on) {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int i = 0; i < requests.size(); i++) {
+            if (requests[i] == req) {
+                requests.erase(requests.begin() + i);
+                break;
+            }
+        }
+    }
+}
+
+void hila::mpi_progress_struct::loop() {
+    while (running) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            has_work.wait(guard, [this] { return !running || requests.size() > 0; });
+
+            for (int i = 0; i < requests.size();) {
+                int flag;
+                MPI_Test(requests[i], &flag, MPI_STATUS_IGNORE);
+                if (flag) {
+                    requests.erase(requests.begin() + i);
+                    n_completed++;
+                } else {
+                    i++;
+                }
+            }
+        }
+        // leave the cpu and the lock to the main thread for a while
+        std::this_thread::sleep_for(std::chrono::microseconds(MPI_PROGRESS_INTERVAL_US));
+    }
+}
@@ -7,6 +7,11 @@
 
 #include "datatypes/extended.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 
 // let us house the partitions-struct here
 namespace hila {
@@ -43,6 +48,235 @@ class partitions_struct {
 
 extern partitions_struct partitions;
 
+/// Aggregation of nearest neighbour gathers.  Between begin() and flush() start_gather()
+/// does not send its halo messages but registers the send and receive buffers here.
+/// flush() sends one message per neighbour rank, and wait() unpacks the received
+/// messages to the receive buffers of the fields.  Generated site loops bracket their
+/// start_gather() calls with begin() and flush(), wait_gather() calls wait().
+class gather_batch_struct {
+  private:
+    struct segment {
+        int rank;
+        char *buf;
+        size_t size;
+    };
+    struct message {
+        int rank;
+        size_t size;
+        char *buf;             // points either to data or to the field buffer
+        std::vector<char> data; // used if the message has several segments
+        MPI_Request request;
+    };
+
+    std::vector<segment> sends, receives;
+    std::vector<message> send_msg, receive_msg;
+    unsigned id = 0, done_id = 0;
+    bool collecting = false;
+
+    void make_messages(std::vector<segment> &seg, std::vector<message> &msg, bool pack);
+
+  public:
+    /// batching can be switched off at runtime, e.g. for comparison
+    bool enabled = true;
+
+    void begin();
+    bool is_collecting() const {
+        return collecting;
+    }
+    unsigned add_send(int rank, void *buf, size_t size);
+    unsigned add_receive(int rank, void *buf, size_t size);
+    void flush();
+    void wait(unsigned batch_id);
+};
+
+extern gather_batch_struct gather_batch;
+
+/// Halo exchange through shared memory with the ranks on the same host (see MPI_SHARED_HALO
+/// in params.h).  Each rank owns an "arena" in an MPI-3 shared window, where it packs the
+/// halos going to ranks on its host.  The receiver copies the halo from the arena of the
+/// sender; only the offset of the data is sent as an MPI message.  After the copy the
+/// receiver increments its counter in the header of the sender's arena, and the sender
+/// reuses the arena space when the counters show that all halos it has packed have been
+/// copied.  The counters are read and written after MPI_Win_sync, no messages are needed.
+/// If setup() has not been called is_on_host() is false for all ranks.
+class shared_halo_struct {
+  private:
+    MPI_Comm host_comm = MPI_COMM_NULL;
+    MPI_Win win;
+    char *arena = nullptr;
+    size_t arena_size = 0, header_size = 0, used = 0;
+    int host_rank = 0;
+    std::vector<char *> peer_arena; // indexed by rank, nullptr if not on this host
+    std::vector<int> peer_host_rank; // rank in host_comm, indexed by rank
+    std::vector<uint64_t> n_packed;  // halos packed for each host rank
+
+    /// copy counter of host rank i in the header of arena a
+    static std::atomic<uint64_t> *counter(char *a, int i) {
+        return reinterpret_cast<std::atomic<uint64_t> *>(a + 64 * i);
+    }
+
+  public:
+    void setup(MPI_Comm comm);
+    void finish();
+
+    bool is_on_host(int rank) const {
+        return rank >= 0 && static_cast<size_t>(rank) < peer_arena.size() &&
+               peer_arena[rank] != nullptr;
+    }
+
+    /// reserve size bytes from own arena for a halo to rank, return offset or -1 if full
+    int64_t allocate(size_t size, int rank);
+    /// after copying a halo from the arena of rank
+    void copied(int rank);
+
+    char *local(int64_t offset) {
+        return arena + offset;
+    }
+    const char *peer(int rank, int64_t offset) const {
+        return peer_arena[rank] + offset;
+    }
+
+    /// memory barrier for the window, before signalling and after being signalled
+    void sync() {
+        MPI_Win_sync(win);
+    }
+
+    /// message tag of the offset
+    int tag(int slot, Direction d, Parity par) const;
+    /// tags for halos sent as messages when the arena is full.  These are unique among the
+    /// messages in flight, because the receiver may wait for them in any order
+    int fallback_tag();
+};
+
+extern shared_halo_struct shared_halo;
+
+/// Fusion of delayed reductions: Reduction<T> variables marked batched() register here
+/// when their first site loop is done.  flush() packs all registered values to one buffer
+/// and starts a single MPI_Iallreduce, using a summation operation which knows the
+/// number type of each value (double, float, integers, ExtendedPrecision).  wait()
+/// completes it and copies the results back.  Reduction<T>::value() calls these as needed.
+class reduction_batch_struct {
+  public:
+    enum class kind_t : int { DOUBLE, FLOAT, INT32, INT64, UINT32, UINT64, LONG_DOUBLE, EXTENDED };
+
+    /// state of a reduction variable: not in batch, waiting for flush, in flight
+    enum state_t : int { NONE, PENDING, IN_FLIGHT };
+
+    struct segment {
+        void *ptr;
+        size_t offset, size;
+        kind_t kind;
+        int *state;
+    };
+
+  private:
+    std::vector<segment> pending, in_flight;
+    std::vector<char> buffer;
+    MPI_Request request;
+    MPI_Datatype dtype;
+    bool comm_is_on = false;
+
+  public:
+    // statistics: reductions done through the batch and collectives used for them
+    int64_t n_reductions = 0, n_collectives = 0;
+
+    template <typename T>
+    static constexpr kind_t kind_of() {
+        using b_t = hila::arithmetic_type<T>;
+        if constexpr (std::is_same<b_t, double>::value)
+            return kind_t::DOUBLE;
+        else if constexpr (std::is_same<b_t, float>::value)
+            return kind_t::FLOAT;
+        else if constexpr (std::is_same<b_t, long double>::value)
+            return kind_t::LONG_DOUBLE;
+        else if constexpr (std::is_same<b_t, ExtendedPrecision>::value)
+            return kind_t::EXTENDED;
+        else {
+            static_assert(std::is_integral<b_t>::value && (sizeof(b_t) == 4 || sizeof(b_t) == 8),
+                          "Unsupported number type in batched reduction");
+            if constexpr (std::is_signed<b_t>::value)
+                return sizeof(b_t) == 4 ? kind_t::INT32 : kind_t::INT64;
+            else
+                return sizeof(b_t) == 4 ? kind_t::UINT32 : kind_t::UINT64;
+        }
+    }
+
+    /// register value to the next flush, state is set to PENDING
+    template <typename T>
+    void add(T &value, int &state) {
+        pending.push_back({(void *)&value, 0, sizeof(T), kind_of<T>(), &state});
+        state = PENDING;
+    }
+
+    /// remove a pending value (e.g. when the variable is destroyed)
+    void remove(int &state);
+
+    /// start the collective for the pending values
+    void flush();
+
+    /// complete the collective in flight
+    void wait();
+
+    /// flush and wait
+    void complete() {
+        flush();
+        wait();
+    }
+};
+
+extern reduction_batch_struct reduction_batch;
+
+/// MPI progress thread: with command line option "-mpi_progress on" a helper thread
+/// calls MPI_Test on the outstanding halo requests, so that large messages progress
+/// while the sites are computed.  start_gather() registers the requests with add() and
+/// wait_gather() completes them with wait().  Requires MPI_THREAD_MULTIPLE.
+class mpi_progress_struct {
+  private:
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable has_work; // the thread sleeps on this when there are no requests
+    std::vector<MPI_Request *> requests;
+    std::atomic<bool> running{false};
+    bool on = false;
+
+    void loop();
+
+  public:
+    // statistics: requests registered, and completed by the progress thread
+    int64_t n_requests = 0, n_completed = 0;
+
+    /// start the thread, returns false if MPI does not support it
+    bool start();
+    void stop();
+
+    bool is_on() const {
+        return on;
+    }
+
+    /// register an active request to be progressed
+    void add(MPI_Request *req) {
+        if (on) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                requests.push_back(req);
+                n_requests++;
+            }
+            has_work.notify_one();
+        }
+    }
+
+    /// take the request away from the progress thread
+    void remove(MPI_Request *req);
+
+    /// complete the request
+    void wait(MPI_Request *req) {
+        remove(req);
+        MPI_Wait(req, MPI_STATUS_IGNORE);
+    }
+};
+
+extern mpi_progress_struct mpi_progress;
+
 } // namespace hila
 
 // Pile of timers associated with MPI calls
@@ -58,7 +292,8 @@ extern hila::timer
         broadcast_timer,
         send_timer,
         drop_comms_timer,
-        partition_sync_timer;
+        partition_sync_timer,
+        reduction_batch_timer;
 // clang-format on
 
 ///***********************************************************
@@ -68,6 +303,15 @@ extern hila::timer
 // The MPI tag generator
 int get_next_msg_tag();
 
+// Fixed tags for the persistent nearest neighbour gathers of the field in comm slot
+int get_persistent_msg_tag(int slot, Direction d, Parity par);
+
+namespace hila {
+// comm slots of fields, the lowest free slot is returned
+int allocate_comm_slot();
+void free_comm_slot(int slot);
+} // namespace hila
+
 /// Obtain the MPI data type (MPI_XXX) for a particular type of native numbers.
 ///
 /// @brief Return MPI data type compatible with native number type
@@ -407,6 +651,11 @@ T reduce_node_product(T &var, bool allreduce = true) {
 void set_allreduce(bool on = true);
 bool get_allreduce();
 
+/// Switch collective MPI-IO on/off in binary Field and GaugeField file I/O (default off).
+/// With it each rank reads/writes its own sites; file format does not change
+void set_parallel_io(bool on = true);
+bool get_parallel_io();
+
 
 } // namespace hila
 
@@ -86,29 +86,57 @@ class Field {
 
         // neighbour pointers - because of boundary conditions, can be different for
         // diff. fields
-        const unsigned *RESTRICT neighbours[NDIRS];
+        lattice_struct::neighbour_array_t neighbours[NDIRS];
         hila::bc boundary_condition[NDIRS];
 
+        // persistent requests, created on the first gather to direction and parity.
+        // Their message tags are from the comm slot of the field
+        int comm_slot;
         MPI_Request receive_request[3][NDIRS];
         MPI_Request send_request[3][NDIRS];
+        // nonzero if the gather is in hila::gather_batch
+        unsigned batch_id[3][NDIRS];
+        // state of halo exchanges through hila::shared_halo
+        struct shared_halo_state {
+            MPI_Request offset_send, offset_receive, data_send;
+            int64_t send_info[2], receive_info[2]; // arena offset and fallback tag
+        } shared_state[3][NDIRS];
 #ifndef VANILLA
         // vanilla needs no special receive buffers
         T *receive_buffer[NDIRS];
 #endif
         T *send_buffer[NDIRS];
+        // local sites and the wide halo of depth halo_depth (> 1), see gather_wide_halo()
+        T *wide_halo_buffer;
+        int halo_depth;
+        bool wide_halo_valid;
+        // halo messages packed with hila::halo_compression<T>, and the numbers
+        // in them converted to lower precision
+        bool compress_halo;
+        hila::halo_precision halo_prec;
         /**
          * @internal
          * @brief Initialize communication
          */
         void initialize_communication() {
             for (int d = 0; d < NDIRS; d++) {
-                for (int p = 0; p < 3; p++)
+                for (int p = 0; p < 3; p++) {
                     gather_status_arr[p][d] = gather_status_t::NOT_DONE;
+                    receive_request[p][d] = MPI_REQUEST_NULL;
+                    send_request[p][d] = MPI_REQUEST_NULL;
+                    batch_id[p][d] = 0;
+                }
                 send_buffer[d] = nullptr;
 #ifndef VANILLA
                 receive_buffer[d] = nullptr;
 #endif
             }
+            comm_slot = hila::allocate_comm_slot();
+            wide_halo_buffer = nullptr;
+            halo_depth = 1;
+            wide_halo_valid = false;
+            compress_halo = false;
+            halo_prec = hila::halo_precision::FULL;
         }
 
         /**
@@ -116,7 +144,25 @@ class Field {
          * @brief Free communication
          *
          */
+        void free_requests() {
+            bool comm_on = hila::is_comm_initialized();
+            for (int d = 0; d < NDIRS; d++) {
+                for (int p = 0; p < 3; p++) {
+                    if (comm_on && receive_request[p][d] != MPI_REQUEST_NULL) {
+                        hila::mpi_progress.remove(&receive_request[p][d]);
+                        MPI_Request_free(&receive_request[p][d]);
+                    }
+                    if (comm_on && send_request[p][d] != MPI_REQUEST_NULL) {
+                        hila::mpi_progress.remove(&send_request[p][d]);
+                        MPI_Request_free(&send_request[p][d]);
+                    }
+                    receive_request[p][d] = send_request[p][d] = MPI_REQUEST_NULL;
+                }
+            }
+        }
+
         void free_communication() {
+            free_requests();
             for (int d = 0; d < NDIRS; d++) {
                 if (send_buffer[d] != nullptr)
                     payload.free_mpi_buffer(send_buffer[d]);
@@ -125,6 +171,9 @@ class Field {
                     payload.free_mpi_buffer(receive_buffer[d]);
 #endif
             }
+            if (wide_halo_buffer != nullptr)
+                std::free(wide_halo_buffer);
+            hila::free_comm_slot(comm_slot);
         }
 
         /**
@@ -205,12 +254,60 @@ class Field {
         void place_comm_elements(Direction d, Parity par, T *RESTRICT buffer,
                                  const lattice_struct::comm_node_struct &from_node);
 
+        /**
+         * @internal
+         * @brief True if the halo elements of Direction d are packed with
+         * hila::halo_compression.  Elements must be packed one by one, thus not on GPUs or
+         * in vectorized block copies.
+         */
+        bool halo_is_packed(Direction d) const;
+
+        /**
+         * @internal
+         * @brief True if the numbers in halo messages are sent in lower precision
+         */
+        bool halo_precision_is_reduced() const;
+
+        /**
+         * @internal
+         * @brief True if the halo messages of Direction d are compressed in any way
+         */
+        bool halo_is_compressed(Direction d) const {
+            return halo_is_packed(d) || halo_precision_is_reduced();
+        }
+
+        /**
+         * @internal
+         * @brief Size of a halo element in messages of Direction d
+         */
+        size_t halo_element_size(Direction d) const;
+
+        /**
+         * @internal
+         * @brief Compress n elements in buffer in place, and expand them back
+         */
+        void compress_halo_elements(Direction d, T *buffer, unsigned n) const;
+        void decompress_halo_elements(Direction d, T *buffer, unsigned n) const;
+
         /**
          * @internal
          * @brief Place boundary elements from local lattice (used in vectorized version)
          */
         void set_local_boundary_elements(Direction dir, Parity par);
 
+        /**
+         * @internal
+         * @brief Halo exchange with a rank on the same host, through hila::shared_halo
+         */
+        void start_shared_receive(Direction d, Parity par,
+                                  const lattice_struct::comm_node_struct &from_node);
+        void start_shared_send(Direction d, Parity par,
+                               const lattice_struct::comm_node_struct &to_node);
+        void wait_shared_receive(Direction d, Parity par,
+                                 const lattice_struct::comm_node_struct &from_node);
+        void wait_shared_send(Direction d, Parity par,
+                              const lattice_struct::comm_node_struct &to_node);
+
         /**
          * @internal
          * @brief Gather a list of elements to a single node
@@ -376,7 +473,11 @@ class Field {
         for (Direction d = (Direction)0; d < NDIRS; ++d) {
 
 #if !defined(CUDA) && !defined(HIP)
+#ifndef LOW_MEMORY_LATTICE
             fs->neighbours[d] = lattice->neighb[d];
+#else
+            fs->neighbours[d] = {&lattice->neighb[d]};
+#endif
 #else
             fs->payload.neighbours[d] = lattice->backend_lattice->d_neighb[d];
 #endif
@@ -490,6 +591,22 @@ class Field {
             }
         }
         fs->assigned_to |= parity_bits(p);
+        fs->wide_halo_valid = false;
+    }
+
+    /**
+     * @internal
+     * @brief Invalidate the gathered halos as mark_changed(ALL) does, but without
+     * marking the field assigned.  Used when the format of the halo messages changes.
+     */
+    void invalidate_halos() const {
+        for (Direction d = (Direction)0; d < NDIRS; ++d) {
+            drop_comms(d, ALL);
+            set_gather_status(ALL, d, gather_status_t::NOT_DONE);
+            set_gather_status(EVEN, d, gather_status_t::NOT_DONE);
+            set_gather_status(ODD, d, gather_status_t::NOT_DONE);
+        }
+        fs->wide_halo_valid = false;
     }
 
     /**
@@ -1227,7 +1344,13 @@ class Field {
 
     /**
      * @brief Create a periodically shifted copy of the field
-     * @details  this is currently OK only for short moves, very inefficient for longer moves
+     * @details  Moves longer than one step are done in a single exchange using the general
+     * gather of the lattice, cached by the offset (see lattice_struct::get_general_gather()).
+     * At most 16 gathers are cached by default, see
+     * lattice_struct::set_general_gather_cache_size() and clear_general_gathers().
+     * Moves within the wide halo of the field (see set_halo_depth()) use the halo, which is
+     * exchanged only once after the field has changed.
+     * On GPUs and with antiperiodic boundary conditions the move is done step by step.
      *
      * @code{.cpp}
      * .
@@ -1251,6 +1374,104 @@ class Field {
 
     Field<T> shift(const CoordinateVector &v) const;
 
+    /// shift() in one packed exchange, using the cached general gather for offset v
+    Field<T> &shift_general(const CoordinateVector &v, Field<T> &r, Parity par) const;
+
+    /**
+     * @brief Set the depth of the wide halo of the field
+     * @details With depth > 1 a single exchange fills all sites within depth hops,
+     * including the diagonal ones (e.g. X+e_x+e_y and X+2*e_x for depth 2).  After that
+     * shift() by such offsets, and thus f[X + offset] in site loops, is done without
+     * further communication until the field is changed.  Depth 1 (default) uses only the
+     * nearest neighbour halos, and setting it releases the halo buffer of the field.  The
+     * index tables shared by the fields are released with lattice->clear_wide_halos().
+     *
+     * Memory: each field with depth > 1 keeps its own buffer holding a copy of the local
+     * sites and the received halo sites, thus somewhat more than the field itself.  In
+     * addition the lattice keeps, once for each depth in use, an index table of 4 bytes
+     * per local site for every offset.  At depth 2 there are 2 NDIM (NDIM + 1) offsets, e.g. 40
+     * in 4D, thus 160 bytes per site.  Use wide halos for the few fields which are read at
+     * many offsets, such as the gauge links of smearing or improved actions.
+     *
+     * @code{.cpp}
+     * U[d].set_halo_depth(2);
+     * onsites(ALL) {
+     *     // the offsets come from one halo exchange
+     *     s[X] = U[d][X + d1 + d2] + U[d][X + d1 - d2];
+     * }
+     * @endcode
+     */
+    void set_halo_depth(int depth) {
+        if (fs == nullptr)
+            allocate();
+        if (depth != fs->halo_depth) {
+            fs->halo_depth = depth;
+            fs->wide_halo_valid = false;
+            if (fs->wide_halo_buffer != nullptr)
+                std::free(fs->wide_halo_buffer);
+            fs->wide_halo_buffer = nullptr;
+        }
+    }
+
+    int halo_depth() const {
+        return (fs == nullptr) ? 1 : fs->halo_depth;
+    }
+
+    /**
+     * @brief Compress the halo messages of the field
+     * @details Types which specialize hila::halo_compression (e.g. SU(N) matrices, where
+     * only N-1 rows are sent) are packed to a smaller size in gathers.  For SU(N) the
+     * last row is reconstructed from unitarity, so the matrices must be special unitary to
+     * rounding accuracy.  No effect for other types.  Call outside of site loops.  The
+     * halos gathered so far are invalidated, thus the next access gathers them again.
+     */
+    void set_halo_compression(bool on = true) {
+        if (fs == nullptr)
+            allocate();
+        if (!hila::halo_compression<T>::is_compressible)
+            on = false;
+        if (on != fs->compress_halo) {
+            // message sizes change, the persistent requests are created again
+            invalidate_halos();
+            fs->free_requests();
+            fs->compress_halo = on;
+        }
+    }
+
+    bool is_halo_compressed() const {
+        return fs != nullptr && fs->compress_halo;
+    }
+
+    /**
+     * @brief Set the precision of the numbers in halo messages
+     * @details With hila::halo_precision::SINGLE double precision numbers are sent as
+     * float, with HALF double and float numbers are sent in bfloat16 format.  The numbers
+     * are expanded back on receipt, the field itself keeps its precision.  Meant for
+     * iterative solvers where the early iterations do not need full accuracy; see
+     * CG::set_halo_precision().  No effect on GPUs or for integer types.  The halos
+     * gathered so far are invalidated, thus the next access gathers them again.
+     */
+    void set_halo_precision(hila::halo_precision p) {
+        if (fs == nullptr)
+            allocate();
+        if (p != fs->halo_prec) {
+            // message sizes change, the persistent requests are created again
+            invalidate_halos();
+            fs->free_requests();
+            fs->halo_prec = p;
+        }
+    }
+
+    hila::halo_precision get_halo_precision() const {
+        return (fs == nullptr) ? hila::halo_precision::FULL : fs->halo_prec;
+    }
+
+    /// Fill the wide halo if it is not up to date.  Collective.
+    void gather_wide_halo() const;
+
+    /// shift() using the wide halo
+    Field<T> &shift_halo(const CoordinateVector &v, Field<T> &r, Parity par) const;
+
     // General getters and setters
 
     /// Set a single element. Assuming that each node calls this with the same value, it
@@ -1458,13 +1679,28 @@ class Field {
     void read(std::ifstream &inputfile, const CoordinateVector &insize);
     void read(const std::string &filename);
 
+    // Collective MPI-IO write/read at byte offset of a file opened on all ranks
+    void write_at(MPI_File &fh, int64_t offset) const;
+    void read_at(MPI_File &fh, int64_t offset);
+    void read_at(MPI_File &fh, int64_t offset, const CoordinateVector &insize);
+
+    uint64_t checksum(int64_t index_offset = 0) const;
+    uint64_t checksum(const CoordinateVector &box, int64_t index_offset) const;
+
+    void copy_local_subvolume(const CoordinateVector &cmin, const CoordinateVector &cmax,
+                              std::vector<T> &buffer, CoordinateVector &imin,
+                              CoordinateVector &isize) const;
+
     void write_subvolume(std::ofstream &outputfile, const CoordinateVector &cmin,
-                         const CoordinateVector &cmax, int precision = 6) const;
+                         const CoordinateVector &cmax, int precision = 6,
+                         bool binary = false) const;
     void write_subvolume(const std::string &filenname, const CoordinateVector &cmin,
-                         const CoordinateVector &cmax, int precision = 6) const;
+                         const CoordinateVector &cmax, int precision = 6,
+                         bool binary = false) const;
 
     template <typename Out>
-    void write_slice(Out &outputfile, const CoordinateVector &slice, int precision = 6) const;
+    void write_slice(Out &outputfile, const CoordinateVector &slice, int precision = 6,
+                     bool binary = false) const;
 
     /**
      * @brief Sum reduction of Field
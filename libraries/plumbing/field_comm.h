@@ -92,6 +92,141 @@ void Field<T>::field_struct::place_comm_elements(
     // #endif
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////
+/// Halo compression: elements are packed with hila::halo_compression (structure, e.g.
+/// SU(N) rows) and the numbers in them converted to lower precision (halo_prec).  Both
+/// are done in place: the compressed element k is at k * compressed size, never beyond
+/// element k, so compressing forwards and expanding backwards does not overwrite unread
+/// data.
+
+namespace hila {
+
+/// convert m numbers of type A in buf to type S in place, and back
+template <typename A, typename S>
+inline void narrow_numbers(char *buf, size_t m) {
+    for (size_t i = 0; i < m; i++) {
+        A a;
+        std::memcpy(&a, buf + i * sizeof(A), sizeof(A));
+        S s = S((float)a);
+        std::memcpy(buf + i * sizeof(S), &s, sizeof(S));
+    }
+}
+
+template <typename A, typename S>
+inline void widen_numbers(char *buf, size_t m) {
+    for (size_t i = m; i-- > 0;) {
+        S s;
+        std::memcpy(&s, buf + i * sizeof(S), sizeof(S));
+        A a = (A)(float)s;
+        std::memcpy(buf + i * sizeof(A), &a, sizeof(A));
+    }
+}
+
+} // namespace hila
+
+template <typename T>
+bool Field<T>::field_struct::halo_is_packed(Direction d) const {
+    if constexpr (!hila::halo_compression<T>::is_compressible) {
+        return false;
+    } else {
+        if (!compress_halo)
+            return false;
+#if defined(CUDA) || defined(HIP)
+        // buffers are in device memory
+        return false;
+#elif defined(VECTORIZED)
+        // vectorized types are sent element by element only with boundary permutation
+        if constexpr (hila::is_vectorizable_type<T>::value)
+            return vector_lattice->is_boundary_permutation[abs(d)];
+        else
+            return true;
+#else
+        return true;
+#endif
+    }
+}
+
+template <typename T>
+bool Field<T>::field_struct::halo_precision_is_reduced() const {
+#if defined(CUDA) || defined(HIP)
+    return false;
+#else
+    // number by number conversion, works also for vectorized layout
+    using A = hila::arithmetic_type<T>;
+    if constexpr (std::is_same<A, double>::value)
+        return halo_prec != hila::halo_precision::FULL;
+    else if constexpr (std::is_same<A, float>::value)
+        return halo_prec == hila::halo_precision::HALF;
+    else
+        return false;
+#endif
+}
+
+template <typename T>
+size_t Field<T>::field_struct::halo_element_size(Direction d) const {
+    using A = hila::arithmetic_type<T>;
+    size_t size = halo_is_packed(d) ? hila::halo_compression<T>::compressed_size : sizeof(T);
+    if (halo_precision_is_reduced()) {
+        size_t bytes = (halo_prec == hila::halo_precision::SINGLE) ? sizeof(float)
+                                                                     : sizeof(hila::bfloat16);
+        size = size / sizeof(A) * bytes;
+    }
+    return size;
+}
+
+template <typename T>
+void Field<T>::field_struct::compress_halo_elements(Direction d, T *buffer, unsigned n) const {
+    using A = hila::arithmetic_type<T>;
+    char *cbuf = (char *)buffer;
+    size_t size = sizeof(T);
+
+    if (halo_is_packed(d)) {
+        constexpr size_t csize = hila::halo_compression<T>::compressed_size;
+        for (unsigned k = 0; k < n; k++) {
+            T v = buffer[k];
+            hila::halo_compression<T>::compress(v, cbuf + k * csize);
+        }
+        size = csize;
+    }
+
+    if (halo_precision_is_reduced()) {
+        if constexpr (std::is_floating_point<A>::value) {
+            size_t m = n * (size / sizeof(A));
+            if (halo_prec == hila::halo_precision::SINGLE)
+                hila::narrow_numbers<A, float>(cbuf, m);
+            else
+                hila::narrow_numbers<A, hila::bfloat16>(cbuf, m);
+        }
+    }
+}
+
+template <typename T>
+void Field<T>::field_struct::decompress_halo_elements(Direction d, T *buffer,
+                                                      unsigned n) const {
+    using A = hila::arithmetic_type<T>;
+    char *cbuf = (char *)buffer;
+    size_t size = halo_is_packed(d) ? hila::halo_compression<T>::compressed_size : sizeof(T);
+
+    if (halo_precision_is_reduced()) {
+        if constexpr (std::is_floating_point<A>::value) {
+            size_t m = n * (size / sizeof(A));
+            if (halo_prec == hila::halo_precision::SINGLE)
+                hila::widen_numbers<A, float>(cbuf, m);
+            else
+                hila::widen_numbers<A, hila::bfloat16>(cbuf, m);
+        }
+    }
+
+    if (halo_is_packed(d)) {
+        constexpr size_t csize = hila::halo_compression<T>::compressed_size;
+        for (unsigned k = n; k-- > 0;) {
+            T v;
+            hila::halo_compression<T>::decompress(cbuf + k * csize, v);
+            buffer[k] = v;
+        }
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////
 /// Place boundary elements from local lattice (used in vectorized version)
 
@@ -155,6 +290,99 @@ T *Field<T>::field_struct::get_receive_buffer(Direction d, Parity par,
 } // end of get_receive_buffer
 
 
+/////////////////////////////////////////////////////////////////////////////////////////
+/// Halo exchange with a rank on the same host.  The sender packs the halo to its
+/// shared arena and sends the offset; the receiver copies the halo from the arena and
+/// marks it copied in the arena header, see hila::shared_halo_struct.  If the arena is
+/// full the offset is -1 and the halo is sent as a normal message, with the tag sent
+/// along the offset.
+
+template <typename T>
+void Field<T>::field_struct::start_shared_receive(
+    Direction d, Parity par, const lattice_struct::comm_node_struct &from_node) {
+
+    auto &st = shared_state[(int)par - 1][d];
+
+    post_receive_timer.start();
+    MPI_Irecv(st.receive_info, 2 * sizeof(int64_t), MPI_BYTE, from_node.rank,
+              hila::shared_halo.tag(comm_slot, d, par), lattice->mpi_comm_lat,
+              &st.offset_receive);
+    post_receive_timer.stop();
+}
+
+template <typename T>
+void Field<T>::field_struct::start_shared_send(Direction d, Parity par,
+                                               const lattice_struct::comm_node_struct &to_node) {
+
+    auto &st = shared_state[(int)par - 1][d];
+    size_t n = to_node.n_sites(par) * sizeof(T);
+
+    start_send_timer.start();
+
+    st.send_info[0] = hila::shared_halo.allocate(n, to_node.rank);
+    if (st.send_info[0] >= 0) {
+        gather_comm_elements(d, par, (T *)hila::shared_halo.local(st.send_info[0]), to_node);
+        hila::shared_halo.sync();
+    } else {
+        st.send_info[1] = hila::shared_halo.fallback_tag();
+    }
+
+    MPI_Isend(st.send_info, 2 * sizeof(int64_t), MPI_BYTE, to_node.rank,
+              hila::shared_halo.tag(comm_slot, d, par), lattice->mpi_comm_lat,
+              &st.offset_send);
+
+    if (st.send_info[0] < 0) {
+        // no space in arena, send the halo
+        if (send_buffer[d] == nullptr)
+            send_buffer[d] = payload.allocate_mpi_buffer(to_node.sites);
+        T *buf = send_buffer[d] + to_node.offset(par);
+        gather_comm_elements(d, par, buf, to_node);
+        MPI_Isend(buf, (int)n, MPI_BYTE, to_node.rank, (int)st.send_info[1],
+                  lattice->mpi_comm_lat, &st.data_send);
+    }
+
+    start_send_timer.stop();
+}
+
+template <typename T>
+void Field<T>::field_struct::wait_shared_receive(
+    Direction d, Parity par, const lattice_struct::comm_node_struct &from_node) {
+
+    auto &st = shared_state[(int)par - 1][d];
+    T *buffer = get_receive_buffer(d, par, from_node);
+    size_t n = from_node.n_sites(par) * sizeof(T);
+
+    wait_receive_timer.start();
+
+    MPI_Wait(&st.offset_receive, MPI_STATUS_IGNORE);
+    if (st.receive_info[0] >= 0) {
+        hila::shared_halo.sync();
+        std::memcpy(buffer, hila::shared_halo.peer(from_node.rank, st.receive_info[0]), n);
+        hila::shared_halo.copied(from_node.rank);
+    } else {
+        MPI_Recv(buffer, (int)n, MPI_BYTE, from_node.rank, (int)st.receive_info[1],
+                 lattice->mpi_comm_lat, MPI_STATUS_IGNORE);
+    }
+
+    wait_receive_timer.stop();
+}
+
+template <typename T>
+void Field<T>::field_struct::wait_shared_send(Direction d, Parity par,
+                                              const lattice_struct::comm_node_struct &to_node) {
+
+    auto &st = shared_state[(int)par - 1][d];
+
+    wait_send_timer.start();
+
+    MPI_Wait(&st.offset_send, MPI_STATUS_IGNORE);
+    if (st.send_info[0] < 0)
+        MPI_Wait(&st.data_send, MPI_STATUS_IGNORE);
+
+    wait_send_timer.stop();
+}
+
+
 #define NAIVE_SHIFT
 #if defined(NAIVE_SHIFT)
 
@@ -176,6 +404,22 @@ Field<T> &Field<T>::shift(const CoordinateVector &v, Field<T> &res, const Parity
         return res;
     }
 
+#if !defined(CUDA) && !defined(HIP)
+    // longer moves in one exchange, unless antiperiodic boundaries need to be applied
+    // on the way
+    if (len > 1) {
+        bool antiperiodic = false;
+        foralldir(d) {
+            if (v[d] != 0 && fs->boundary_condition[d] == hila::bc::ANTIPERIODIC)
+                antiperiodic = true;
+        }
+        if (!antiperiodic && len <= fs->halo_depth)
+            return shift_halo(v, res, par);
+        if (!antiperiodic)
+            return shift_general(v, res, par);
+    }
+#endif
+
     // opp_parity(ALL) == ALL
     if (len % 2 == 0)
         par_s = opp_parity(par);
@@ -255,17 +499,177 @@ Field<T> &Field<T>::shift(const CoordinateVector &v, Field<T> &res, const Parity
 
 #endif // NAIVE_SHIFT
 
+/// Shift with the general gather: send buffers are packed in the order of the
+/// to_node sitelists, everything is exchanged at once and the result is
+/// assembled from the local field and the receive buffer.
+
+template <typename T>
+Field<T> &Field<T>::shift_general(const CoordinateVector &v, Field<T> &res,
+                                  const Parity par) const {
+
+    if (&res == this) {
+        // cannot shift in place, go through a temporary
+        Field<T> tmp;
+        shift_general(v, tmp, par);
+        res[par] = tmp[X];
+        return res;
+    }
+
+    const lattice_struct::gen_comminfo_struct &ci = lattice.ptr()->get_general_gather(v);
+
+    static hila::timer shift_timer("general shift");
+    shift_timer.start();
+
+    int tag = get_next_msg_tag();
+
+    std::vector<T> receive_buffer(ci.receive_buf_size);
+    std::vector<std::vector<T>> send_buffer(ci.to_node.size());
+    std::vector<MPI_Request> req(ci.from_node.size() + ci.to_node.size());
+    int nreq = 0;
+
+    for (auto &n : ci.from_node) {
+        size_t sites = n.n_sites(par);
+        if (sites > 0)
+            MPI_Irecv(receive_buffer.data() + n.offset(par), sites * sizeof(T), MPI_BYTE, n.rank,
+                      tag, lattice->mpi_comm_lat, &req[nreq++]);
+    }
+
+    for (int i = 0; i < ci.to_node.size(); i++) {
+        int sites;
+        const unsigned *sitelist = ci.to_node[i].get_sitelist(par, sites);
+        if (sites > 0) {
+            send_buffer[i].resize(sites);
+            for (int k = 0; k < sites; k++)
+                send_buffer[i][k] = get_value_at(sitelist[k]);
+
+            MPI_Isend(send_buffer[i].data(), sites * sizeof(T), MPI_BYTE, ci.to_node[i].rank, tag,
+                      lattice->mpi_comm_lat, &req[nreq++]);
+        }
+    }
+
+    res.check_alloc();
+
+    // on-node sites can be filled while the messages are in flight
+    const unsigned volume = lattice->mynode.volume;
+    for (unsigned i = 0; i < volume; i++) {
+        if (ci.index[i] < volume && (par == ALL || lattice->coordinates(i).parity() == par))
+            res.set_value_at(get_value_at(ci.index[i]), i);
+    }
+
+    MPI_Waitall(nreq, req.data(), MPI_STATUSES_IGNORE);
+
+    for (unsigned i = 0; i < volume; i++) {
+        if (ci.index[i] >= volume && (par == ALL || lattice->coordinates(i).parity() == par))
+            res.set_value_at(receive_buffer[ci.index[i] - volume], i);
+    }
+
+    res.mark_changed(par);
+
+    shift_timer.stop();
+    return res;
+}
+
+/// Exchange the wide halo of depth fs->halo_depth, all sites at once.  Nothing is done
+/// if the halo is up to date, i.e. the field has not changed after the last exchange.
+/// The halo buffer holds the local sites in node-lexicographic order followed by the
+/// received sites, see lattice_struct::halo_comminfo_struct.
+
+template <typename T>
+void Field<T>::gather_wide_halo() const {
+
+    if (fs->halo_depth <= 1 || fs->wide_halo_valid)
+        return;
+
+    const lattice_struct::halo_comminfo_struct &hc = lattice.ptr()->get_wide_halo(fs->halo_depth);
+
+    static hila::timer halo_timer("wide halo exchange");
+    halo_timer.start();
+
+    const unsigned volume = lattice->mynode.volume;
+    if (fs->wide_halo_buffer == nullptr)
+        fs->wide_halo_buffer = (T *)memalloc((volume + hc.receive_buf_size) * sizeof(T));
+
+    // copy the local sites to the buffer
+    T *buf = fs->wide_halo_buffer;
+    CoordinateVector nmin = lattice->mynode.min;
+    Vector<NDIM, unsigned> nmul = lattice->mynode.size_factor;
+
+#pragma hila novector direct_access(buf)
+    onsites(ALL) {
+        Vector<NDIM, unsigned> nodec;
+        nodec = X.coordinates() - nmin;
+        buf[nodec.dot(nmul)] = (*this)[X];
+    }
+
+    int tag = get_next_msg_tag();
+
+    std::vector<std::vector<T>> send_buffer(hc.to_node.size());
+    std::vector<MPI_Request> req(hc.from_node.size() + hc.to_node.size());
+    int nreq = 0;
+
+    for (auto &n : hc.from_node) {
+        MPI_Irecv(buf + volume + n.buffer, n.sites * sizeof(T), MPI_BYTE, n.rank, tag,
+                  lattice->mpi_comm_lat, &req[nreq++]);
+    }
+
+    for (int i = 0; i < hc.to_node.size(); i++) {
+        int sites;
+        const unsigned *sitelist = hc.to_node[i].get_sitelist(ALL, sites);
+        send_buffer[i].resize(sites);
+        for (int k = 0; k < sites; k++)
+            send_buffer[i][k] = buf[sitelist[k]];
+
+        MPI_Isend(send_buffer[i].data(), sites * sizeof(T), MPI_BYTE, hc.to_node[i].rank, tag,
+                  lattice->mpi_comm_lat, &req[nreq++]);
+    }
+
+    MPI_Waitall(nreq, req.data(), MPI_STATUSES_IGNORE);
+
+    fs->wide_halo_valid = true;
+
+    halo_timer.stop();
+}
+
+/// Shift by offset v within the wide halo: after gather_wide_halo() no communication
+/// is needed.  The site loop picks the sites of parity par.
+
+template <typename T>
+Field<T> &Field<T>::shift_halo(const CoordinateVector &v, Field<T> &res, const Parity par) const {
+
+    if (&res == this) {
+        Field<T> tmp;
+        shift_halo(v, tmp, par);
+        res[par] = tmp[X];
+        return res;
+    }
+
+    gather_wide_halo();
+
+    const unsigned *index = lattice.ptr()->get_wide_halo(fs->halo_depth).get_index(v);
+    assert(index != nullptr && "shift_halo: offset not within the wide halo");
+
+    const T *buf = fs->wide_halo_buffer;
+    CoordinateVector nmin = lattice->mynode.min;
+    Vector<NDIM, unsigned> nmul = lattice->mynode.size_factor;
+
+#pragma hila novector direct_access(buf, index)
+    onsites(par) {
+        Vector<NDIM, unsigned> nodec;
+        nodec = X.coordinates() - nmin;
+        res[X] = buf[index[nodec.dot(nmul)]];
+    }
+
+    return res;
+}
+
 /// start_gather(): Communicate the field at Parity par from Direction
 /// d. Uses accessors to prevent dependency on the layout.
 /// return the Direction mask bits where something is happening
 template <typename T>
 dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
-    // get the mpi message tag right away, to ensure that we are always synchronized
-    // with the mpi calls -- some nodes might not need comms, but the tags must be in
-    // sync
-
-    int tag = get_next_msg_tag();
+    // The sends and receives use persistent requests with fixed tags, created at the
+    // first gather to this direction and parity.  Later gathers only restart them.
 
     const lattice_struct::nn_comminfo_struct &ci = lattice->nn_comminfo[d];
     const lattice_struct::comm_node_struct &from_node = ci.from_node;
@@ -315,12 +719,20 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
     int par_i = static_cast<int>(par) - 1; // index to dim-3 arrays
 
-    constexpr size_t size = sizeof(T);
+    // element size in messages, smaller with halo compression
+    const size_t size = fs->halo_element_size(d);
 
     T *receive_buffer;
     T *send_buffer;
 
-    if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d)) {
+    // halos from/to ranks on the same host go through shared memory
+    const bool receive_shared = hila::shared_halo.is_on_host(from_node.rank);
+    const bool send_shared = hila::shared_halo.is_on_host(to_node.rank);
+
+    if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d) && receive_shared)
+        fs->start_shared_receive(d, par, from_node);
+
+    if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d) && !receive_shared) {
 
         // HANDLE RECEIVES: get node which will send here
 
@@ -337,13 +749,27 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
         post_receive_timer.start();
 
         // c++ version does not return errors
-        MPI_Irecv(receive_buffer, (int)n, MPI_BYTE, from_node.rank, tag, lattice->mpi_comm_lat,
-                  &fs->receive_request[par_i][d]);
+        if (hila::gather_batch.is_collecting()) {
+            // message goes out in gather_batch.flush()
+            fs->batch_id[par_i][d] = hila::gather_batch.add_receive(from_node.rank,
+                                                                    receive_buffer, n);
+        } else {
+            if (fs->receive_request[par_i][d] == MPI_REQUEST_NULL)
+                MPI_Recv_init(receive_buffer, (int)n, MPI_BYTE, from_node.rank,
+                              get_persistent_msg_tag(fs->comm_slot, d, par), lattice->mpi_comm_lat,
+                              &fs->receive_request[par_i][d]);
+
+            MPI_Start(&fs->receive_request[par_i][d]);
+            hila::mpi_progress.add(&fs->receive_request[par_i][d]);
+        }
 
         post_receive_timer.stop();
     }
 
-    if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d)) {
+    if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d) && send_shared)
+        fs->start_shared_send(d, par, to_node);
+
+    if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d) && !send_shared) {
         // HANDLE SENDS: Copy Field elements on the boundary to a send buffer and send
 
         unsigned sites = to_node.n_sites(par);
@@ -355,6 +781,8 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
 #ifndef MPI_BENCHMARK_TEST
         fs->gather_comm_elements(d, par, send_buffer, to_node);
+        if (fs->halo_is_compressed(d))
+            fs->compress_halo_elements(d, send_buffer, sites);
 #endif
 
         size_t n = sites * size;
@@ -366,8 +794,17 @@ dir_mask_t Field<T>::start_gather(Direction d, Parity p) const {
 
         start_send_timer.start();
 
-        MPI_Isend(send_buffer, (int)n, MPI_BYTE, to_node.rank, tag, lattice->mpi_comm_lat,
-                  &fs->send_request[par_i][d]);
+        if (hila::gather_batch.is_collecting()) {
+            fs->batch_id[par_i][d] = hila::gather_batch.add_send(to_node.rank, send_buffer, n);
+        } else {
+            if (fs->send_request[par_i][d] == MPI_REQUEST_NULL)
+                MPI_Send_init(send_buffer, (int)n, MPI_BYTE, to_node.rank,
+                              get_persistent_msg_tag(fs->comm_slot, d, par), lattice->mpi_comm_lat,
+                              &fs->send_request[par_i][d]);
+
+            MPI_Start(&fs->send_request[par_i][d]);
+            hila::mpi_progress.add(&fs->send_request[par_i][d]);
+        }
 
         start_send_timer.stop();
     }
@@ -449,12 +886,23 @@ void Field<T>::wait_gather(Direction d, Parity p) const {
         int par_i = (int)par - 1;
 
         if (from_node.rank != hila::myrank() && boundary_need_to_communicate(d)) {
-            wait_receive_timer.start();
+            if (hila::shared_halo.is_on_host(from_node.rank)) {
+                fs->wait_shared_receive(d, par, from_node);
+            } else if (fs->batch_id[par_i][d] != 0) {
+                hila::gather_batch.wait(fs->batch_id[par_i][d]);
+            } else {
+                wait_receive_timer.start();
 
-            MPI_Status status;
-            MPI_Wait(&fs->receive_request[par_i][d], &status);
+                hila::mpi_progress.wait(&fs->receive_request[par_i][d]);
 
-            wait_receive_timer.stop();
+                wait_receive_timer.stop();
+            }
+
+#ifndef MPI_BENCHMARK_TEST
+            if (!hila::shared_halo.is_on_host(from_node.rank) && fs->halo_is_compressed(d))
+                fs->decompress_halo_elements(d, fs->get_receive_buffer(d, par, from_node),
+                                             from_node.n_sites(par));
+#endif
 
 #if !defined(VANILLA) && !defined(MPI_BENCHMARK_TEST)
             fs->place_comm_elements(d, par, fs->get_receive_buffer(d, par, from_node), from_node);
@@ -463,11 +911,17 @@ void Field<T>::wait_gather(Direction d, Parity p) const {
 
         // then wait for the sends
         if (to_node.rank != hila::myrank() && boundary_need_to_communicate(-d)) {
-            wait_send_timer.start();
-            MPI_Status status;
-            MPI_Wait(&fs->send_request[par_i][d], &status);
-            wait_send_timer.stop();
+            if (hila::shared_halo.is_on_host(to_node.rank)) {
+                fs->wait_shared_send(d, par, to_node);
+            } else if (fs->batch_id[par_i][d] != 0) {
+                hila::gather_batch.wait(fs->batch_id[par_i][d]);
+            } else {
+                wait_send_timer.start();
+                hila::mpi_progress.wait(&fs->send_request[par_i][d]);
+                wait_send_timer.stop();
+            }
         }
+        fs->batch_id[par_i][d] = 0;
 
         // Mark the parity gathered from Direction dir
         mark_gathered(d, par);
@@ -759,7 +1213,7 @@ void Field<T>::set_local_data(const std::vector<T> &buffer) {
     T *data = (T *)d_malloc(sizeof(T) * lattice->mynode.volume);
     gpuMemcpy(data, buffer.data(), sizeof(T) * lattice->mynode.volume, gpuMemcpyHostToDevice);
 #else
-    T *data = buffer.data();
+    const T *data = buffer.data();
 #endif
 
 #pragma hila novector direct_access(data)
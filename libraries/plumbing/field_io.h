@@ -6,6 +6,8 @@
 
 #include "plumbing/field.h"
 
+#include <algorithm>
+
 namespace hila {
 // Define this as template, in order to avoid code generation if the function is not needed -
 // a bit crazy
@@ -70,6 +72,155 @@ bool close_file(const std::string &filename, S &fstream) {
     return !error;
 }
 
+//////////////////////////////////////////////////////////////////////////////////
+// Parallel (MPI-IO) file access.  All ranks open the file and each reads/writes
+// its own sites directly, without routing the data through rank 0.
+
+/// Open file for collective MPI-IO writing.  If truncate is true, old content is removed
+inline bool open_mpi_output_file(const std::string &filename, MPI_File &fh,
+                                 bool truncate = true) {
+    int err = MPI_File_open(lattice->mpi_comm_lat, filename.c_str(),
+                            MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh);
+    if (err != MPI_SUCCESS) {
+        hila::out0 << "ERROR in opening file " << filename << " (MPI-IO)\n";
+        hila::terminate(4);
+    }
+    if (truncate)
+        MPI_File_set_size(fh, 0);
+
+    return true;
+}
+
+/// Open file for collective MPI-IO reading
+inline bool open_mpi_input_file(const std::string &filename, MPI_File &fh) {
+    int err = MPI_File_open(lattice->mpi_comm_lat, filename.c_str(), MPI_MODE_RDONLY,
+                            MPI_INFO_NULL, &fh);
+    if (err != MPI_SUCCESS) {
+        hila::out0 << "ERROR in opening file " << filename << " (MPI-IO)\n";
+        hila::terminate(5);
+    }
+    return true;
+}
+
+inline bool close_mpi_file(const std::string &filename, MPI_File &fh) {
+    int error = (MPI_File_close(&fh) != MPI_SUCCESS) ? 1 : 0;
+    if (hila::reduce_node_sum(error) > 0) {
+        hila::out0 << "ERROR in reading/writing file " << filename << " (MPI-IO)\n";
+        hila::terminate(3);
+    }
+    return !error;
+}
+
+/// Set the MPI-IO file view so that the box [cmin, cmin+csize) of a lattice of size lsize is seen
+/// as a contiguous array of elements of elem_size bytes.  The file contains the full lattice in the
+/// standard order (x runs fastest) starting from byte offset.  Empty box (some csize[d] == 0) is
+/// allowed.
+/// Returns the element datatype, which is used in the read/write calls.  Free the datatype
+/// with free_mpi_file_view() after use.
+inline MPI_Datatype set_mpi_file_view(MPI_File &fh, int64_t offset, const CoordinateVector &lsize,
+                                      const CoordinateVector &cmin, const CoordinateVector &csize,
+                                      size_t elem_size) {
+    MPI_Datatype etype, filetype;
+    MPI_Type_contiguous((int)elem_size, MPI_BYTE, &etype);
+    MPI_Type_commit(&etype);
+
+    bool empty = false;
+    foralldir(d) empty = empty || (csize[d] <= 0);
+
+    if (!empty) {
+        int sizes[NDIM], subsizes[NDIM], starts[NDIM];
+        foralldir(d) {
+            sizes[d] = lsize[d];
+            subsizes[d] = csize[d];
+            starts[d] = cmin[d];
+        }
+        // Fortran order: 1st index (x) runs fastest, as in the file
+        MPI_Type_create_subarray(NDIM, sizes, subsizes, starts, MPI_ORDER_FORTRAN, etype,
+                                 &filetype);
+    } else {
+        // no sites here, view is irrelevant
+        MPI_Type_contiguous(1, etype, &filetype);
+    }
+    MPI_Type_commit(&filetype);
+
+    MPI_File_set_view(fh, (MPI_Offset)offset, etype, filetype, "native", MPI_INFO_NULL);
+
+    MPI_Type_free(&filetype);
+    return etype;
+}
+
+/// File view of the sites of this rank in lattice lat, see above
+inline MPI_Datatype set_mpi_file_view(MPI_File &fh, int64_t offset, const lattice_struct *lat,
+                                      size_t elem_size) {
+    CoordinateVector csize = lat->mynode.size;
+    if (lat->mynode.volume == 0)
+        csize.fill(0);
+    return set_mpi_file_view(fh, offset, lat->l_size, lat->mynode.min, csize, elem_size);
+}
+
+inline void free_mpi_file_view(MPI_Datatype &etype) {
+    MPI_Type_free(&etype);
+}
+
+/// 64-bit hash of n bytes with seed, using xxHash64-style rounds.  Used for the
+/// layout independent field checksums, see Field<T>::checksum()
+inline uint64_t hash_bytes(const void *data, size_t n, uint64_t seed) {
+    constexpr uint64_t p1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t p2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t p3 = 0x165667B19E3779F9ULL;
+    auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = seed * p2 + p3 + n;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= n; i += sizeof(uint64_t)) {
+        uint64_t w;
+        std::memcpy(&w, p + i, sizeof(uint64_t));
+        h ^= rotl(w * p2, 31) * p1;
+        h = rotl(h, 27) * p1 + p3;
+    }
+    for (; i < n; i++) {
+        h ^= p[i] * p3;
+        h = rotl(h, 11) * p1;
+    }
+    // final avalanche
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+/// Hash of a field element for the checksums: the arithmetic_type numbers of the element
+/// are hashed one by one, by value.  Thus padding bytes, e.g. those of long double, do not
+/// enter the checksum and the result is reproducible.
+template <typename T>
+inline uint64_t hash_element(const T &v, uint64_t seed) {
+    using base_t = hila::arithmetic_type<T>;
+    static_assert(sizeof(T) % sizeof(base_t) == 0,
+                  "checksum: element must consist of numbers of its arithmetic type");
+    constexpr int n = sizeof(T) / sizeof(base_t);
+
+    uint64_t h = seed;
+    for (int i = 0; i < n; i++) {
+        base_t x = hila::get_number_in_var(v, i);
+        if constexpr (std::is_integral<base_t>::value) {
+            int64_t w = x;
+            h = hash_bytes(&w, sizeof(int64_t), h);
+        } else if constexpr (sizeof(base_t) <= sizeof(double)) {
+            h = hash_bytes(&x, sizeof(base_t), h);
+        } else {
+            // extended precision: hash as a pair of doubles
+            double w[2];
+            w[0] = static_cast<double>(x);
+            w[1] = static_cast<double>(x - w[0]);
+            h = hash_bytes(w, 2 * sizeof(double), h);
+        }
+    }
+    return h;
+}
+
 } // namespace hila
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -111,9 +262,32 @@ void Field<T>::write(std::ofstream &outputfile, bool binary, int precision) cons
     std::free(buffer);
 }
 
+/// Write the field to an MPI-IO file, starting at byte offset. Collective: all ranks write
+/// their own sites. File content is identical to the one written by write(std::ofstream &).
+template <typename T>
+void Field<T>::write_at(MPI_File &fh, int64_t offset) const {
+
+    assert(fs->mylattice.ptr() == lattice.ptr() && "write_at(): Field not on current lattice");
+
+    std::vector<T> buffer;
+    copy_local_data(buffer);
+
+    MPI_Datatype etype = hila::set_mpi_file_view(fh, offset, fs->mylattice.ptr(), sizeof(T));
+    MPI_File_write_at_all(fh, 0, buffer.data(), (int)buffer.size(), etype, MPI_STATUS_IGNORE);
+    hila::free_mpi_file_view(etype);
+}
+
 /// Write the Field to a named file replacing the file
 template <typename T>
 void Field<T>::write(const std::string &filename, bool binary, int precision) const {
+    if (binary && hila::get_parallel_io()) {
+        MPI_File fh;
+        hila::open_mpi_output_file(filename, fh);
+        write_at(fh, 0);
+        hila::close_mpi_file(filename, fh);
+        return;
+    }
+
     std::ofstream outputfile;
     hila::open_output_file(filename, outputfile, binary);
     write(outputfile, binary, precision);
@@ -239,9 +413,151 @@ void Field<T>::read(std::ifstream &inputfile, const CoordinateVector& insize) {
     std::free(buffer);
 }
 
+/// Read the Field from an MPI-IO file, starting at byte offset. Collective: all ranks read
+/// their own sites
+template <typename T>
+void Field<T>::read_at(MPI_File &fh, int64_t offset) {
+
+    if (!this->is_allocated())
+        this->allocate();
+
+    assert(fs->mylattice.ptr() == lattice.ptr() && "read_at(): Field not on current lattice");
+
+    std::vector<T> buffer(lattice->mynode.volume);
+    MPI_Status status;
+    int count;
+
+    MPI_Datatype etype = hila::set_mpi_file_view(fh, offset, fs->mylattice.ptr(), sizeof(T));
+    MPI_File_read_at_all(fh, 0, buffer.data(), (int)buffer.size(), etype, &status);
+    MPI_Get_count(&status, etype, &count);
+    hila::free_mpi_file_view(etype);
+
+    int error = (count != (int)buffer.size()) ? 1 : 0;
+    if (hila::reduce_node_sum(error) > 0) {
+        hila::out0 << "ERROR in reading Field: unexpected end of file\n";
+        hila::terminate(1);
+    }
+
+    set_local_data(buffer);
+}
+
+/// Read the Field from an MPI-IO file, where the file contains a lattice of size insize.
+/// insize must divide the current lattice size, and the input lattice is replicated to fill
+/// the current lattice.  Each rank reads only the part of the input lattice it needs, and
+/// tiles it locally.
+template <typename T>
+void Field<T>::read_at(MPI_File &fh, int64_t offset, const CoordinateVector &insize) {
+
+    if (insize == lattice.size()) {
+        read_at(fh, offset);
+        return;
+    }
+
+    if (!this->is_allocated())
+        this->allocate();
+
+    assert(fs->mylattice.ptr() == lattice.ptr() && "read_at(): Field not on current lattice");
+
+    const lattice_struct *lat = fs->mylattice.ptr();
+
+    // find the box of the input lattice needed here.  If the node wraps around the input
+    // lattice boundary to direction d, read the whole input lattice extent
+    CoordinateVector rmin, rsize;
+    size_t rvol = (lat->mynode.volume > 0) ? 1 : 0;
+    foralldir(d) {
+        assert(lat->l_size[d] % insize[d] == 0 && "read_at(): input size must divide lattice");
+        int lo = lat->mynode.min[d] % insize[d];
+        if (lo + lat->mynode.size[d] > insize[d]) {
+            rmin[d] = 0;
+            rsize[d] = insize[d];
+        } else {
+            rmin[d] = lo;
+            rsize[d] = lat->mynode.size[d];
+        }
+        rvol *= rsize[d];
+    }
+    if (rvol == 0)
+        rsize.fill(0);
+
+    std::vector<T> rbuf(rvol);
+    MPI_Status status;
+    int count;
+
+    MPI_Datatype etype = hila::set_mpi_file_view(fh, offset, insize, rmin, rsize, sizeof(T));
+    MPI_File_read_at_all(fh, 0, rbuf.data(), (int)rvol, etype, &status);
+    MPI_Get_count(&status, etype, &count);
+    hila::free_mpi_file_view(etype);
+
+    int error = (count != (int)rvol) ? 1 : 0;
+    if (hila::reduce_node_sum(error) > 0) {
+        hila::out0 << "ERROR in reading Field: unexpected end of file\n";
+        hila::terminate(1);
+    }
+
+    // tile the input box to the local sites, in logical order (x fastest)
+    std::vector<T> buffer(lat->mynode.volume);
+    CoordinateVector c = lat->mynode.min;
+    for (size_t i = 0; i < buffer.size(); i++) {
+        size_t ri = 0, mul = 1;
+        foralldir(d) {
+            ri += (c[d] % insize[d] - rmin[d]) * mul;
+            mul *= rsize[d];
+        }
+        buffer[i] = rbuf[ri];
+        lat->mynode.advance_local_coordinate(c);
+    }
+
+    set_local_data(buffer);
+}
+
+/// Checksum of the Field content: sum (mod 2^64) over sites of a hash of the element numbers,
+/// seeded with the global site index + index_offset.  Thus the result is independent of the
+/// node layout and of the order of reduction.  Only sites inside the box [0, box) are
+/// included, with the site index counted within the box; this allows checking data read
+/// with replication from a smaller lattice.  Collective, all ranks get the result.
+template <typename T>
+uint64_t Field<T>::checksum(const CoordinateVector &box, int64_t index_offset) const {
+
+    const lattice_struct *lat = fs->mylattice.ptr();
+
+    std::vector<T> buffer;
+    copy_local_data(buffer);
+
+    uint64_t sum = 0;
+    CoordinateVector c = lat->mynode.min;
+    for (size_t i = 0; i < buffer.size(); i++) {
+        int64_t index = 0;
+        bool inside = true;
+        for (int d = NDIM - 1; d >= 0; d--) {
+            inside = inside && (c[d] < box[d]);
+            index = index * box[d] + c[d];
+        }
+        if (inside)
+            sum += hila::hash_element(buffer[i], index + index_offset);
+        lat->mynode.advance_local_coordinate(c);
+    }
+
+    hila::reduce_node_sum(&sum, 1, true);
+    return sum;
+}
+
+/// Checksum of the whole Field, see above
+template <typename T>
+uint64_t Field<T>::checksum(int64_t index_offset) const {
+    return checksum(fs->mylattice.size(), index_offset);
+}
+
 // Read Field contents from the beginning of a file
 template <typename T>
 void Field<T>::read(const std::string &filename) {
+    if (hila::get_parallel_io()) {
+        MPI_File fh;
+        hila::open_mpi_input_file(filename, fh);
+        read_at(fh, 0);
+        hila::close_mpi_file(filename, fh);
+        return;
+    }
+
     std::ifstream inputfile;
     hila::open_input_file(filename, inputfile);
     read(inputfile);
@@ -272,13 +588,165 @@ static void read_fields(const std::string &filename, fieldtypes &...fields) {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+namespace hila {
+
+/// Write data segments held by all ranks to outputfile on rank 0, ordered by their global
+/// start index.  start[i] and length[i] give the global index and byte length of segment i,
+/// segments are stored back to back in data.  Collective.
+///
+/// The data is collected and written in chunks of consecutive segments, so that rank 0
+/// holds at most about write_segment_chunk bytes at a time and the MPI counts stay
+/// below 2^31 even for very large outputs.
+inline void write_ordered_segments(std::ofstream &outputfile, const std::string &data,
+                                   const std::vector<int64_t> &start,
+                                   const std::vector<int64_t> &length) {
+
+    constexpr int64_t write_segment_chunk = 1 << 26;
+
+    MPI_Comm comm = lattice->mpi_comm_lat;
+    int nodes = hila::number_of_nodes();
+    int myrank = hila::myrank();
+    int nseg = start.size();
+
+    std::vector<int> all_nseg(nodes), seg_displ(nodes);
+    MPI_Gather(&nseg, 1, MPI_INT, all_nseg.data(), 1, MPI_INT, 0, comm);
+
+    int64_t total_seg = 0;
+    if (myrank == 0) {
+        for (int r = 0; r < nodes; r++) {
+            seg_displ[r] = total_seg;
+            total_seg += all_nseg[r];
+        }
+        assert(total_seg <= std::numeric_limits<int>::max() && "too many segments in write_ordered_segments");
+    }
+
+    std::vector<int64_t> all_start(total_seg), all_length(total_seg);
+    MPI_Gatherv(start.data(), nseg, MPI_INT64_T, all_start.data(), all_nseg.data(),
+                seg_displ.data(), MPI_INT64_T, 0, comm);
+    MPI_Gatherv(length.data(), nseg, MPI_INT64_T, all_length.data(), all_nseg.data(),
+                seg_displ.data(), MPI_INT64_T, 0, comm);
+
+    // rank 0: the owner of each segment, its byte offset in the data of the owner,
+    // and the global order of the segments
+    std::vector<int> owner(total_seg);
+    std::vector<int64_t> offset(total_seg), order(total_seg);
+    if (myrank == 0) {
+        for (int r = 0; r < nodes; r++) {
+            int64_t pos = 0;
+            for (int i = seg_displ[r]; i < seg_displ[r] + all_nseg[r]; i++) {
+                owner[i] = r;
+                offset[i] = pos;
+                pos += all_length[i];
+            }
+        }
+        for (int64_t i = 0; i < total_seg; i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](int64_t a, int64_t b) { return all_start[a] < all_start[b]; });
+    }
+
+    // Each chunk is a run of segments in the global order.  The segments of a rank within
+    // a chunk are consecutive in its data, so each rank sends one byte range per chunk.
+    std::vector<int64_t> range(2 * nodes);
+    std::vector<int> counts(nodes), displ(nodes);
+    std::vector<char> chunk;
+    int64_t next = 0;
+    int more = (total_seg > 0);
+    hila::broadcast(more);
+    while (more) {
+        int64_t end = next, bytes = 0;
+        if (myrank == 0) {
+            std::fill(range.begin(), range.end(), 0);
+            std::vector<bool> started(nodes, false);
+            while (end < total_seg &&
+                   (bytes == 0 || bytes + all_length[order[end]] <= write_segment_chunk)) {
+                int64_t i = order[end];
+                int r = owner[i];
+                if (!started[r]) {
+                    range[2 * r] = offset[i];
+                    started[r] = true;
+                }
+                range[2 * r + 1] += all_length[i];
+                bytes += all_length[i];
+                end++;
+            }
+            int pos = 0;
+            for (int r = 0; r < nodes; r++) {
+                counts[r] = range[2 * r + 1];
+                displ[r] = pos;
+                pos += counts[r];
+            }
+            chunk.resize(bytes);
+        }
+
+        int64_t my_range[2];
+        MPI_Scatter(range.data(), 2, MPI_INT64_T, my_range, 2, MPI_INT64_T, 0, comm);
+        MPI_Gatherv(data.data() + my_range[0], (int)my_range[1], MPI_BYTE, chunk.data(),
+                    counts.data(), displ.data(), MPI_BYTE, 0, comm);
+
+        if (myrank == 0) {
+            for (int64_t k = next; k < end; k++) {
+                int64_t i = order[k];
+                int r = owner[i];
+                outputfile.write(chunk.data() + displ[r] + (offset[i] - range[2 * r]),
+                                 all_length[i]);
+            }
+            next = end;
+            more = (next < total_seg);
+        }
+        hila::broadcast(more);
+    }
+}
+
+} // namespace hila
+
+/// Copy the elements of this rank inside the subvolume [cmin, cmax] to buffer, x running
+/// fastest.  imin and isize return the intersection of the subvolume and the node box;
+/// isize is all zeros if there are no such sites.
+template <typename T>
+void Field<T>::copy_local_subvolume(const CoordinateVector &cmin, const CoordinateVector &cmax,
+                                    std::vector<T> &buffer, CoordinateVector &imin,
+                                    CoordinateVector &isize) const {
+
+    const lattice_struct *lat = fs->mylattice.ptr();
+    size_t n = (lat->mynode.volume > 0) ? 1 : 0;
+    foralldir(d) {
+        imin[d] = std::max(cmin[d], lat->mynode.min[d]);
+        int imax = std::min(cmax[d], lat->mynode.min[d] + lat->mynode.size[d] - 1);
+        isize[d] = std::max(imax - imin[d] + 1, 0);
+        n *= isize[d];
+    }
+
+    buffer.resize(n);
+    if (n == 0) {
+        isize.fill(0);
+        return;
+    }
+
+    std::vector<T> local;
+    copy_local_data(local);
+
+    CoordinateVector c = imin;
+    for (size_t k = 0; k < n; k++) {
+        buffer[k] = local[lat->mynode.get_logical_index(c)];
+        foralldir(d) {
+            if (++c[d] < imin[d] + isize[d])
+                break;
+            c[d] = imin[d];
+        }
+    }
+}
+
 /// Write a "subspace" of the original lattice
-/// Each element is written on a single line
+/// Each element is written on a single line, or as raw bytes if binary == true
 /// TODO: more formatting?
+///
+/// With hila::set_parallel_io() the sites are formatted in parallel on each rank,
+/// and the pieces are collected in order to rank 0 and written at once.
 
 template <typename T>
 void Field<T>::write_subvolume(std::ofstream &outputfile, const CoordinateVector &cmin,
-                               const CoordinateVector &cmax, int precision) const {
+                               const CoordinateVector &cmax, int precision, bool binary) const {
 
     constexpr size_t sites_per_write = WRITE_BUFFER_SIZE / sizeof(T);
 
@@ -293,6 +761,47 @@ void Field<T>::write_subvolume(std::ofstream &outputfile, const CoordinateVector
             line_len = sites;
     }
 
+    if (hila::get_parallel_io()) {
+        std::vector<T> elems;
+        CoordinateVector imin, isize;
+        copy_local_subvolume(cmin, cmax, elems, imin, isize);
+
+        // format x-rows of the local part, each row is a contiguous segment in the output
+        std::ostringstream os;
+        os.precision(precision);
+        std::vector<int64_t> start, length;
+        CoordinateVector c = imin;
+        size_t k = 0;
+        while (k < elems.size()) {
+            int64_t index = 0;
+            for (int d = NDIM - 1; d >= 0; d--)
+                index = index * (cmax[d] - cmin[d] + 1) + c[d] - cmin[d];
+
+            int64_t pos = os.tellp();
+            for (int x = 0; x < isize[0]; x++, k++) {
+                if (binary) {
+                    os.write((char *)&elems[k], sizeof(T));
+                } else {
+                    for (int l = 0; l < sizeof(T) / sizeof(hila::arithmetic_type<T>); l++) {
+                        os << hila::get_number_in_var(elems[k], l) << ' ';
+                    }
+                    os << '\n';
+                }
+            }
+            start.push_back(index);
+            length.push_back((int64_t)os.tellp() - pos);
+
+            for (int d = 1; d < NDIM; d++) {
+                if (++c[d] < imin[d] + isize[d])
+                    break;
+                c[d] = imin[d];
+            }
+        }
+
+        hila::write_ordered_segments(outputfile, os.str(), start, length);
+        return;
+    }
+
     size_t n_write = std::min(sites_per_write, sites);
 
     std::vector<CoordinateVector> coord_list(n_write);
@@ -317,26 +826,54 @@ void Field<T>::write_subvolume(std::ofstream &outputfile, const CoordinateVector
             fs->gather_elements(buffer, coord_list);
 
             if (hila::myrank() == 0) {
-                for (size_t k = 0; k < i; k++) {
-                    for (int l = 0; l < sizeof(T) / sizeof(hila::arithmetic_type<T>); l++) {
-                        outputfile << hila::get_number_in_var(buffer[k], l) << ' ';
+                if (binary) {
+                    outputfile.write((char *)buffer, i * sizeof(T));
+                } else {
+                    for (size_t k = 0; k < i; k++) {
+                        for (int l = 0; l < sizeof(T) / sizeof(hila::arithmetic_type<T>); l++) {
+                            outputfile << hila::get_number_in_var(buffer[k], l) << ' ';
+                        }
+                        outputfile << '\n';
                     }
-                    outputfile << '\n';
                 }
             }
             i = 0;
         }
     }
+
+    std::free(buffer);
 }
 
+/// Write subvolume to file.  With binary output and hila::set_parallel_io() each rank
+/// writes its part of the subvolume directly to the file with collective MPI-IO.
 
 template <typename T>
 void Field<T>::write_subvolume(const std::string &filename, const CoordinateVector &cmin,
-                               const CoordinateVector &cmax, int precision) const {
+                               const CoordinateVector &cmax, int precision, bool binary) const {
+
+    if (binary && hila::get_parallel_io()) {
+        std::vector<T> elems;
+        CoordinateVector imin, isize;
+        copy_local_subvolume(cmin, cmax, elems, imin, isize);
+
+        CoordinateVector bsize;
+        foralldir(d) {
+            bsize[d] = cmax[d] - cmin[d] + 1;
+            imin[d] -= cmin[d];
+        }
+
+        MPI_File fh;
+        hila::open_mpi_output_file(filename, fh);
+        MPI_Datatype etype = hila::set_mpi_file_view(fh, 0, bsize, imin, isize, sizeof(T));
+        MPI_File_write_at_all(fh, 0, elems.data(), (int)elems.size(), etype, MPI_STATUS_IGNORE);
+        hila::free_mpi_file_view(etype);
+        hila::close_mpi_file(filename, fh);
+        return;
+    }
 
     std::ofstream out;
-    hila::open_output_file(filename, out, false);
-    write_subvolume(out, cmin, cmax, precision);
+    hila::open_output_file(filename, out, binary);
+    write_subvolume(out, cmin, cmax, precision, binary);
     hila::close_file(filename, out);
 }
 
@@ -347,9 +884,10 @@ void Field<T>::write_subvolume(const std::string &filename, const CoordinateVect
 
 template <typename T>
 template <typename outf_type>
-void Field<T>::write_slice(outf_type &outf, const CoordinateVector &slice, int precision) const {
+void Field<T>::write_slice(outf_type &outf, const CoordinateVector &slice, int precision,
+                           bool binary) const {
 
-    static_assert(std::is_same<outf_type, std::string>::value ||
+    static_assert(std::is_same<std::remove_const_t<outf_type>, std::string>::value ||
                       std::is_same<outf_type, std::ofstream>::value,
                   "file name / output stream argument in write_slice()?");
 
@@ -362,7 +900,7 @@ void Field<T>::write_slice(outf_type &outf, const CoordinateVector &slice, int p
             cmin[d] = cmax[d] = slice[d];
         }
     }
-    write_subvolume(outf, cmin, cmax, precision);
+    write_subvolume(outf, cmin, cmax, precision, binary);
 }
 
 
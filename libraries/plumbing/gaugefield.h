@@ -9,6 +9,17 @@
 
 #include "hila.h"
 
+namespace hila {
+/// True for gauge link types which can be stored in the compact config format,
+/// i.e. SU(N) matrices which can be rebuilt from N-1 rows
+template <typename T, typename = void>
+struct is_compact_gauge_type : std::false_type {};
+
+template <typename T>
+struct is_compact_gauge_type<T, std::void_t<decltype(std::declval<T &>().reconstruct_last_row())>>
+    : std::true_type {};
+} // namespace hila
+
 /**
  * @brief Gauge field class
  * @details Stores and defines links between Lattice Field elements. Number of links is
@@ -27,6 +38,151 @@ class GaugeField {
     // somewhat arbitrary fingerprint flag for configuration files
     static constexpr int64_t config_flag = 394824242;
 
+    // config header: flag, NDIM, sizeof(T) and lattice size, all int64_t
+    static constexpr int64_t config_header_size = (3 + NDIM) * sizeof(int64_t);
+
+    // compact config files have their own flag, and after the header above the encoding:
+    // matrix size N, number of rows stored and bytes per real number
+    static constexpr int64_t config_flag_compact = 394824243;
+
+    // files with checksum have their own flags, and the layout independent checksum of the
+    // stored data (see Field::checksum()) follows the header above, before the compact
+    // encoding.  The checksum is written only on request, so that by default the files
+    // remain readable by older versions.
+    static constexpr int64_t config_flag_checksum = 394824244;
+    static constexpr int64_t config_flag_compact_checksum = 394824245;
+    static constexpr int64_t config_checksum_header_size = config_header_size + sizeof(int64_t);
+
+    static void check_config_checksum(const std::string &filename, uint64_t expected,
+                                      uint64_t computed) {
+        if (expected != computed) {
+            hila::out0 << "CONFIG ERROR in file " << filename << ": checksum mismatch, header "
+                       << expected << " data " << computed << '\n';
+            hila::terminate(1);
+        }
+    }
+
+    // convert link to the compact type C = Matrix<rows, N, Complex<P>> and back
+    template <typename C>
+    static C compact_link(const T &u) {
+        C c;
+        for (int i = 0; i < C::rows(); i++)
+            for (int j = 0; j < C::columns(); j++)
+                c.e(i, j) = u.e(i, j);
+        return c;
+    }
+
+    template <typename C>
+    static T expand_link(const C &c) {
+        T u;
+        for (int i = 0; i < C::rows(); i++)
+            for (int j = 0; j < C::columns(); j++)
+                u.e(i, j) = c.e(i, j);
+        if constexpr (C::rows() < C::columns())
+            u.reconstruct_last_row();
+        u.reunitarize();
+        return u;
+    }
+
+    /// Write the links in compact format, P is the stored precision and R the number of rows
+    template <typename P, int R>
+    void config_write_compact(const std::string &filename, bool with_checksum) const {
+        using compact_t = Matrix<R, T::rows(), Complex<P>>;
+
+        const int64_t header_size =
+            with_checksum ? config_checksum_header_size : config_header_size;
+        const int64_t data_offset = header_size + 3 * sizeof(int64_t);
+
+        // checksum of the stored links goes to the header, compute it first
+        Field<compact_t> tmp;
+        uint64_t checksum = 0;
+        if (with_checksum) {
+            foralldir (d) {
+                onsites (ALL) {
+                    tmp[X] = compact_link<compact_t>(fdir[d][X]);
+                }
+                checksum += tmp.checksum((int)d * lattice.volume());
+            }
+        }
+
+        std::ofstream outputfile;
+        hila::open_output_file(filename, outputfile);
+
+        if (hila::myrank() == 0) {
+            auto h = config_header(with_checksum, checksum);
+            h[0] = with_checksum ? config_flag_compact_checksum : config_flag_compact;
+            outputfile.write(reinterpret_cast<char *>(h.data()), header_size);
+            int64_t enc[3] = {T::rows(), R, sizeof(P)};
+            outputfile.write(reinterpret_cast<char *>(enc), 3 * sizeof(int64_t));
+        }
+
+        MPI_File fh;
+        bool parallel = hila::get_parallel_io();
+        if (parallel) {
+            hila::close_file(filename, outputfile);
+            hila::open_mpi_output_file(filename, fh, false);
+        }
+
+        foralldir (d) {
+            onsites (ALL) {
+                tmp[X] = compact_link<compact_t>(fdir[d][X]);
+            }
+            if (parallel)
+                tmp.write_at(fh, data_offset + (int)d * lattice.volume() * sizeof(compact_t));
+            else
+                tmp.write(outputfile);
+        }
+
+        if (parallel)
+            hila::close_mpi_file(filename, fh);
+        else
+            hila::close_file(filename, outputfile);
+    }
+
+    /// Read the links in compact format, file positioned after the header on rank 0.
+    /// If has_checksum, the data is verified against checksum
+    template <typename P, int R>
+    void config_read_compact(std::ifstream &inputfile, const std::string &filename,
+                             const CoordinateVector &insize, int64_t data_offset,
+                             bool has_checksum, uint64_t checksum) {
+        using compact_t = Matrix<R, T::rows(), Complex<P>>;
+
+        MPI_File fh;
+        bool parallel = hila::get_parallel_io();
+        if (parallel) {
+            hila::close_file(filename, inputfile);
+            hila::open_mpi_input_file(filename, fh);
+        }
+
+        int64_t invol = 1;
+        foralldir (d)
+            invol *= insize[d];
+
+        Field<compact_t> tmp;
+        uint64_t sum = 0;
+        foralldir (d) {
+            if (parallel)
+                tmp.read_at(fh, data_offset + (int)d * invol * sizeof(compact_t), insize);
+            else
+                tmp.read(inputfile, insize);
+
+            if (has_checksum)
+                sum += tmp.checksum(insize, (int)d * invol);
+
+            onsites (ALL) {
+                fdir[d][X] = expand_link<compact_t>(tmp[X]);
+            }
+        }
+
+        if (parallel)
+            hila::close_mpi_file(filename, fh);
+        else
+            hila::close_file(filename, inputfile);
+
+        if (has_checksum)
+            check_config_checksum(filename, checksum, sum);
+    }
+
   public:
     // Default constructor
     GaugeField() = default;
@@ -130,6 +286,17 @@ class GaugeField {
         }
     }
 
+    /**
+     * @brief Compress the link halos in gathers
+     * @details Only N-1 rows of the SU(N) links are sent and the last row is reconstructed,
+     * see Field::set_halo_compression().  The links must be special unitary to rounding
+     * accuracy.  No effect for link types without halo compression.
+     */
+    void compress_halos(bool on = true) {
+        foralldir (d)
+            fdir[d].set_halo_compression(on);
+    }
+
     /**
      * @brief Computes Wilson action
      * @details \f{align}{ S &=  \beta\sum_{\textbf{dir}_1 < \textbf{dir}_2}\sum_{X} \frac{1}{N}
@@ -166,12 +333,27 @@ class GaugeField {
     }
 
     void write(const std::string &filename) const {
+        if (hila::get_parallel_io()) {
+            MPI_File fh;
+            hila::open_mpi_output_file(filename, fh);
+            write_at(fh, 0);
+            hila::close_mpi_file(filename, fh);
+            return;
+        }
+
         std::ofstream outputfile;
         hila::open_output_file(filename, outputfile);
         write(outputfile);
         hila::close_file(filename, outputfile);
     }
 
+    /// Collective MPI-IO write, directions one after another starting from byte offset
+    void write_at(MPI_File &fh, int64_t offset) const {
+        foralldir (d) {
+            fdir[d].write_at(fh, offset + (int)d * lattice.volume() * sizeof(T));
+        }
+    }
+
     void read(std::ifstream &inputfile) {
         foralldir (d) {
             fdir[d].read(inputfile);
@@ -185,31 +367,116 @@ class GaugeField {
     }
 
     void read(const std::string &filename) {
+        if (hila::get_parallel_io()) {
+            MPI_File fh;
+            hila::open_mpi_input_file(filename, fh);
+            read_at(fh, 0);
+            hila::close_mpi_file(filename, fh);
+            return;
+        }
+
         std::ifstream inputfile;
         hila::open_input_file(filename, inputfile);
         read(inputfile);
         hila::close_file(filename, inputfile);
     }
 
-    /// config_write writes the gauge field to file, with additional "verifying" header
+    /// Collective MPI-IO read, directions one after another starting from byte offset
+    void read_at(MPI_File &fh, int64_t offset) {
+        foralldir (d) {
+            fdir[d].read_at(fh, offset + (int)d * lattice.volume() * sizeof(T));
+        }
+    }
+
+    /// Collective MPI-IO read of a gauge field of lattice size insize, which is replicated
+    /// to fill the current lattice. Each rank reads only the sites it needs
+    void read_at(MPI_File &fh, int64_t offset, const CoordinateVector &insize) {
+        int64_t invol = 1;
+        foralldir (d)
+            invol *= insize[d];
+        foralldir (d) {
+            fdir[d].read_at(fh, offset + (int)d * invol * sizeof(T), insize);
+        }
+    }
+
+    /// Header of the config file written by config_write() on the current lattice:
+    /// flag, NDIM, sizeof(T), lattice size and, if with_checksum, the checksum.  The links
+    /// follow directly after it.
+    static std::vector<int64_t> config_header(bool with_checksum = false,
+                                              uint64_t checksum = 0) {
+        std::vector<int64_t> h(with_checksum ? 4 + NDIM : 3 + NDIM);
+        h[0] = with_checksum ? config_flag_checksum : config_flag;
+        h[1] = NDIM;
+        h[2] = sizeof(T);
+        foralldir (d)
+            h[3 + d] = lattice.size(d);
+        if (with_checksum)
+            h[3 + NDIM] = static_cast<int64_t>(checksum);
+        return h;
+    }
+
+    /// Layout independent checksum of the links, as stored in the config file header.
+    /// Collective
+    uint64_t config_checksum() const {
+        uint64_t sum = 0;
+        foralldir (d)
+            sum += fdir[d].checksum((int)d * lattice.volume());
+        return sum;
+    }
+
+    /// config_write writes the gauge field to file, with additional "verifying" header.
+    ///
+    /// For SU(N) gauge fields the links can be stored in compact format: if compact == true
+    /// only N-1 rows are written, and with single_precision == true the numbers are stored
+    /// as floats.  The encoding is recorded in the header, and config_read() rebuilds and
+    /// reunitarizes the links.  Compact files can be read also with different
+    /// precision of T.
+    ///
+    /// With with_checksum == true the header contains a checksum of the data, independent
+    /// of the node layout, which config_read() verifies.  Files with checksum cannot be read
+    /// by versions of hila older than the checksum, thus it is off by default.
+
+    void config_write(const std::string &filename, bool compact = false,
+                      bool single_precision = false, bool with_checksum = false) const {
+        if (compact || single_precision) {
+            if constexpr (hila::is_compact_gauge_type<T>::value) {
+                constexpr int N = T::rows();
+                if (compact && single_precision)
+                    config_write_compact<float, N - 1>(filename, with_checksum);
+                else if (compact)
+                    config_write_compact<double, N - 1>(filename, with_checksum);
+                else
+                    config_write_compact<float, N>(filename, with_checksum);
+            } else {
+                hila::out0 << "CONFIG ERROR: compact config format is available only for SU(N) "
+                              "gauge fields\n";
+                hila::terminate(1);
+            }
+            return;
+        }
+
+        // checksum is computed from the data in memory, no extra I/O
+        uint64_t checksum = with_checksum ? config_checksum() : 0;
+        const int64_t header_size =
+            with_checksum ? config_checksum_header_size : config_header_size;
 
-    void config_write(const std::string &filename) const {
         std::ofstream outputfile;
         hila::open_output_file(filename, outputfile);
 
         // write header
         if (hila::myrank() == 0) {
-            int64_t f = config_flag;
-            outputfile.write(reinterpret_cast<char *>(&f), sizeof(int64_t));
-            f = NDIM;
-            outputfile.write(reinterpret_cast<char *>(&f), sizeof(int64_t));
-            f = sizeof(T);
-            outputfile.write(reinterpret_cast<char *>(&f), sizeof(int64_t));
+            auto h = config_header(with_checksum, checksum);
+            outputfile.write(reinterpret_cast<char *>(h.data()), header_size);
+        }
 
-            foralldir (d) {
-                f = lattice.size(d);
-                outputfile.write(reinterpret_cast<char *>(&f), sizeof(int64_t));
-            }
+        if (hila::get_parallel_io()) {
+            // header is in place, now all ranks write the links after it
+            hila::close_file(filename, outputfile);
+            MPI_File fh;
+            hila::open_mpi_output_file(filename, fh, false);
+            write_at(fh, header_size);
+            hila::close_mpi_file(filename, fh);
+            return;
         }
 
         write(outputfile);
@@ -223,10 +490,13 @@ class GaugeField {
 
         // read header
         bool ok = true;
+        int compact = 0, has_checksum = 0;
         int64_t f;
         if (hila::myrank() == 0) {
             inputfile.read(reinterpret_cast<char *>(&f), sizeof(int64_t));
-            ok = (f == config_flag);
+            compact = (f == config_flag_compact || f == config_flag_compact_checksum);
+            has_checksum = (f == config_flag_checksum || f == config_flag_compact_checksum);
+            ok = (f == config_flag || compact || has_checksum);
             if (!ok)
                 hila::out0 << conferr << "wrong id, should be " << config_flag << " is " << f
                            << '\n';
@@ -242,7 +512,8 @@ class GaugeField {
 
         if (ok && hila::myrank() == 0) {
             inputfile.read(reinterpret_cast<char *>(&f), sizeof(int64_t));
-            ok = (f == sizeof(T));
+            // compact links are converted, element size may differ
+            ok = compact || (f == sizeof(T));
             if (!ok)
                 hila::out0 << conferr << "wrong size of field element, should be " << sizeof(T)
                            << " is " << f << '\n';
@@ -261,16 +532,90 @@ class GaugeField {
             }
         }
 
+        uint64_t checksum = 0;
+        if (ok && has_checksum && hila::myrank() == 0) {
+            inputfile.read(reinterpret_cast<char *>(&checksum), sizeof(int64_t));
+        }
+
+        // compact encoding: N, stored rows, bytes per real
+        int64_t enc[3] = {0, 0, 0};
+        if (ok && compact && hila::myrank() == 0) {
+            inputfile.read(reinterpret_cast<char *>(enc), 3 * sizeof(int64_t));
+            if constexpr (hila::is_compact_gauge_type<T>::value) {
+                ok = (enc[0] == T::rows() && (enc[1] == T::rows() || enc[1] == T::rows() - 1) &&
+                      (enc[2] == sizeof(float) || enc[2] == sizeof(double)));
+                if (!ok)
+                    hila::out0 << conferr << "incompatible compact encoding: N " << enc[0]
+                               << ", rows " << enc[1] << ", real size " << enc[2] << '\n';
+            } else {
+                ok = false;
+                hila::out0 << conferr << "compact config format requires SU(N) gauge field\n";
+            }
+        }
+
         if (!hila::broadcast(ok)) {
             hila::terminate(1);
         } else {
             hila::broadcast_array(insize.c, NDIM);
+            hila::broadcast(compact);
+            hila::broadcast(has_checksum);
+            hila::broadcast(checksum);
+            hila::broadcast_array(enc, 3);
         }
 
-        read(inputfile, insize);
-        hila::close_file(filename, inputfile);
+        int64_t data_offset = (has_checksum ? config_checksum_header_size : config_header_size) +
+                              (compact ? 3 * sizeof(int64_t) : 0);
+
+        if (compact) {
+            if constexpr (hila::is_compact_gauge_type<T>::value) {
+                constexpr int N = T::rows();
+                bool sp = (enc[2] == sizeof(float));
+                if (enc[1] == N - 1) {
+                    if (sp)
+                        config_read_compact<float, N - 1>(inputfile, filename, insize,
+                                                          data_offset, has_checksum, checksum);
+                    else
+                        config_read_compact<double, N - 1>(inputfile, filename, insize,
+                                                           data_offset, has_checksum, checksum);
+                } else {
+                    if (sp)
+                        config_read_compact<float, N>(inputfile, filename, insize,
+                                                      data_offset, has_checksum, checksum);
+                    else
+                        config_read_compact<double, N>(inputfile, filename, insize,
+                                                       data_offset, has_checksum, checksum);
+                }
+            }
+            return;
+        }
+
+        if (hila::get_parallel_io()) {
+            hila::close_file(filename, inputfile);
+            MPI_File fh;
+            hila::open_mpi_input_file(filename, fh);
+            read_at(fh, data_offset, insize);
+            hila::close_mpi_file(filename, fh);
+        } else {
+            read(inputfile, insize);
+            hila::close_file(filename, inputfile);
+        }
+
+        if (has_checksum) {
+            // verify the data just read, keyed by the site index in the file
+            int64_t invol = 1;
+            foralldir (d)
+                invol *= insize[d];
+            uint64_t sum = 0;
+            foralldir (d)
+                sum += fdir[d].checksum(insize, (int)d * invol);
+            check_config_checksum(filename, checksum, sum);
+        }
     }
 
+    /// ILDG / SciDAC LIME format I/O, see lime_io.h
+    void ildg_write(const std::string &filename, int precision = 64) const;
+    void ildg_read(const std::string &filename);
+
     /**
      * @brief Block the gauge field from parent gauge - form "long links" to connect blocked sites
      */
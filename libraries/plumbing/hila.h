@@ -34,6 +34,7 @@
 //#endif
 
 #include "plumbing/gaugefield.h"
+#include "plumbing/lime_io.h"
 #include "plumbing/input.h"
 #include "plumbing/cmdline.h"
 #include "plumbing/fft.h"
@@ -133,6 +133,16 @@ void hila::initialize(int argc, char **argv) {
                            "Can be repeated many times, each overrides only one input entry.",
                            "<key> <value>", 2);
 
+    hila::cmdline.add_flag("-mpi_progress",
+                           "run a helper thread which progresses the halo communications\n"
+                           "(needs MPI_THREAD_MULTIPLE, default: off)",
+                           "<on/off>", 1);
+
+    hila::cmdline.add_flag("-parallel_io",
+                           "use collective MPI-IO in binary field and configuration I/O\n"
+                           "(each rank reads/writes its own sites, default: off)",
+                           "<on/off>", 1);
+
     // Init command line - after MPI has been started, so
     // that all nodes do this. First feed argc and argv to the
     // global cmdline class instance and parse for the preset flags.
@@ -208,6 +218,12 @@ void hila::initialize(int argc, char **argv) {
 #endif
 #ifdef SPECIAL_BOUNDARY_CONDITIONS
         hila::out0 << " SPECIAL_BOUNDARY_CONDITIONS";
+#endif
+#ifdef LOW_MEMORY_LATTICE
+        hila::out0 << " LOW_MEMORY_LATTICE";
+#endif
+#ifdef TILED_SITE_ORDER
+        hila::out0 << " TILED_SITE_ORDER(" << SITE_TILE_SIZE << ")";
 #endif
         hila::out0 << '\n';
 
@@ -227,6 +243,19 @@ void hila::initialize(int argc, char **argv) {
         hila::out0 << "Input file from command line: " << hila::cmdline.get_string("-i") << "\n";
     }
 
+    if (get_onoff("-parallel_io") == 1) {
+        hila::set_parallel_io(true);
+        hila::out0 << "Using parallel (MPI-IO) field I/O\n";
+    }
+
+    if (get_onoff("-mpi_progress") == 1 && !hila::check_input) {
+        if (hila::mpi_progress.start())
+            hila::out0 << "Using MPI progress thread\n";
+        else
+            hila::out0 << "MPI progress thread not used: needs MPI_THREAD_MULTIPLE and "
+                          "more than 1 rank\n";
+    }
+
 #if defined(OPENMP) && !defined(HILAPP)
     hila::out0 << "Using option OPENMP - with " << omp_get_max_threads() << " threads\n";
 #endif
@@ -300,6 +329,9 @@ void hila::error(const std::string &msg) {
  * Prints timing information and information about communications
  */
 void hila::finishrun() {
+    // e.g. asynchronous checkpoint writes still in flight
+    hila::finish_background_work();
+
     report_timers();
 
 
@@ -313,6 +345,19 @@ void hila::finishrun() {
         hila::out0 << " No communications done from node 0\n";
     }
 
+    if (hila::reduction_batch.n_reductions > 0) {
+        hila::out0 << " REDUCTION BATCH: " << hila::reduction_batch.n_reductions
+                   << " reductions in " << hila::reduction_batch.n_collectives
+                   << " collectives, "
+                   << hila::reduction_batch.n_reductions - hila::reduction_batch.n_collectives
+                   << " collectives saved\n";
+    }
+
+    if (hila::mpi_progress.is_on()) {
+        hila::out0 << " MPI PROGRESS THREAD: " << hila::mpi_progress.n_completed << " of "
+                   << hila::mpi_progress.n_requests << " requests completed by the thread\n";
+    }
+
 
 #if defined(CUDA) || defined(HIP)
     gpuMemPoolReport();
@@ -56,6 +56,11 @@ void lattice_struct::setup_base_lattice(const CoordinateVector &siz) {
     // Initialize wait_array structures - has to be after std gathers()
     initialize_wait_arrays();
 
+#ifdef MPI_SHARED_HALO
+    // find the ranks on the same host and set up the shared halo arenas
+    hila::shared_halo.setup(mpi_comm_lat);
+#endif
+
 #ifdef SPECIAL_BOUNDARY_CONDITIONS
     // do this after std. boundary is done
     init_special_boundaries();
@@ -158,13 +163,13 @@ bool lattice_struct::is_on_mynode(const CoordinateVector &loc) const {
 ///////////////////////////////////////////////////////////////////////
 /// give site index for ON NODE sites
 /// Note: loc really has to be on this node
-/// Separate versions for standard layout, boundary layer layout, and
-/// for vector layout.
+/// Separate versions for standard layout, boundary layer layout or tiled
+/// order, and for vector layout.
 ///////////////////////////////////////////////////////////////////////
 
 #ifndef SUBNODE_LAYOUT
 
-#ifndef BOUNDARY_LAYER_LAYOUT
+#if !defined(BOUNDARY_LAYER_LAYOUT) && !defined(TILED_SITE_ORDER)
 
 unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 
@@ -182,7 +187,7 @@ unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 #endif
 }
 
-#else // Now BOUNDARY_LAYER_LAYOUT
+#else // Now BOUNDARY_LAYER_LAYOUT or TILED_SITE_ORDER
 
 unsigned lattice_struct::site_index(const CoordinateVector &loc) const {
 
@@ -537,6 +542,67 @@ void lattice_struct::node_struct::construct_index_map() {
 
 #endif
 
+#ifdef TILED_SITE_ORDER
+
+////////////////////////////////////////////////////////////////////////
+/// Site index map for tiled order: go through the tiles in typewriter
+/// order and through the sites of each tile likewise, giving the next
+/// free even or odd index to each site.  Tiles at the upper node edges
+/// are smaller if SITE_TILE_SIZE does not divide the node size.
+////////////////////////////////////////////////////////////////////////
+
+void lattice_struct::node_struct::construct_tiled_index_map() {
+
+    map_site_index.resize(volume);
+
+    CoordinateVector ntiles;
+    size_t n_tiles = 1;
+    foralldir (d) {
+        ntiles[d] = (size[d] + SITE_TILE_SIZE - 1) / SITE_TILE_SIZE;
+        n_tiles *= ntiles[d];
+    }
+
+    unsigned even = 0, odd = evensites;
+
+    CoordinateVector tile = 0;
+    for (size_t t = 0; t < n_tiles; ++t) {
+
+        CoordinateVector tmin, tsize;
+        size_t tvol = 1;
+        foralldir (d) {
+            tmin[d] = min[d] + tile[d] * SITE_TILE_SIZE;
+            tsize[d] = std::min(SITE_TILE_SIZE, min[d] + size[d] - tmin[d]);
+            tvol *= tsize[d];
+        }
+
+        CoordinateVector l = tmin;
+        for (size_t i = 0; i < tvol; ++i) {
+            if (l.parity() == EVEN)
+                map_site_index[get_logical_index(l)] = even++;
+            else
+                map_site_index[get_logical_index(l)] = odd++;
+
+            // advance within the tile
+            foralldir (d) {
+                if (++l[d] < tmin[d] + tsize[d])
+                    break;
+                l[d] = tmin[d];
+            }
+        }
+
+        // and to the next tile
+        foralldir (d) {
+            if (++tile[d] < ntiles[d])
+                break;
+            tile[d] = 0;
+        }
+    }
+
+    assert(even == evensites && odd == volume);
+}
+
+#endif
+
 ////////////////////////////////////////////////////////////////////////
 /// Fill in mynode fields -- node_rank() must be set up OK
 ////////////////////////////////////////////////////////////////////////
@@ -566,10 +632,31 @@ void lattice_struct::node_struct::setup(node_info &ni, lattice_struct &lattice)
     construct_index_map();
 #endif
 
+#ifdef TILED_SITE_ORDER
+    construct_tiled_index_map();
+#endif
+
     // map site indexes to locations -- coordinates array
     // after the above site_index should work
 
-#ifdef EVEN_SITES_FIRST
+#ifdef LOW_MEMORY_LATTICE
+    foralldir (d) {
+        size_div[d].set(size[d]);
+        size_factor_div[d].set(size_factor[d]);
+    }
+#endif
+
+#if defined(LOW_MEMORY_LATTICE) && defined(EVEN_SITES_FIRST)
+    row_parity.resize(volume / size[0]);
+    CoordinateVector l = min;
+    for (unsigned r = 0; r < row_parity.size(); r++) {
+        row_parity[r] = (l.parity() == EVEN) ? 0 : 1;
+        l[0] += size[0] - 1;
+        advance_local_coordinate(l);
+    }
+#endif
+
+#if defined(EVEN_SITES_FIRST) && !defined(LOW_MEMORY_LATTICE)
     coordinates.resize(volume);
     CoordinateVector l = min;
     for (unsigned i = 0; i < volume; i++) {
@@ -636,9 +723,11 @@ void lattice_struct::create_std_gathers() {
     // allocate neighbour arrays - TODO: these should
     // be allocated on "device" memory too!
 
+#ifndef LOW_MEMORY_LATTICE
     for (int d = 0; d < NDIRS; d++) {
         neighb[d] = (unsigned *)memalloc(((size_t)mynode.volume) * sizeof(unsigned));
     }
+#endif
 
     size_t c_offset = mynode.volume; // current offset in field-arrays
 
@@ -647,7 +736,14 @@ void lattice_struct::create_std_gathers() {
 
     for (Direction d = e_x; d < NDIRS; ++d) {
 
+#ifndef LOW_MEMORY_LATTICE
+        unsigned *nb = neighb[d];
         nn_comminfo[d].index = neighb[d]; // this is not really used for nn gathers
+#else
+        // full index array only while the boundary table is made
+        unsigned *nb = (unsigned *)memalloc(((size_t)mynode.volume) * sizeof(unsigned));
+        nn_comminfo[d].index = nullptr;
+#endif
 
         comm_node_struct &from_node = nn_comminfo[d].from_node;
         // we can do the opposite send during another pass of the sites.
@@ -670,10 +766,10 @@ void lattice_struct::create_std_gathers() {
             ln = (l + d).mod(l_size);
 
             if (is_on_mynode(ln)) {
-                neighb[d][i] = site_index(ln);
+                nb[i] = site_index(ln);
             } else {
                 // short-circuit neighbour array, for later handling
-                neighb[d][i] = mynode.volume;
+                nb[i] = mynode.volume;
 
                 // Now site is off-node, this leads to gathering
                 if (from_node.rank == mynode.rank) {
@@ -713,16 +809,16 @@ void lattice_struct::create_std_gathers() {
             size_t to_even = 0, to_odd = 0, from_even = 0, from_odd = 0;
 
             for (size_t i = 0; i < mynode.volume; i++) {
-                if (neighb[d][i] == mynode.volume) {
+                if (nb[i] == mynode.volume) {
                     CoordinateVector l, ln;
                     l = coordinates(i);
 
                     if (l.parity() == EVEN) {
-                        neighb[d][i] = c_offset + from_even;
+                        nb[i] = c_offset + from_even;
                         ++from_even;
 
                     } else {
-                        neighb[d][i] = c_offset + from_node.evensites + from_odd;
+                        nb[i] = c_offset + from_node.evensites + from_odd;
                         ++from_odd;
                     }
 
@@ -742,6 +838,23 @@ void lattice_struct::create_std_gathers() {
 #endif
         }
 
+#ifdef LOW_MEMORY_LATTICE
+        // keep only the off-node neighbours; check that the computed ones agree
+        neighb[d].lat = this;
+        neighb[d].dir = d;
+        neighb[d].boundary_site.clear();
+        neighb[d].boundary_index.clear();
+        for (unsigned i = 0; i < mynode.volume; i++) {
+            if (nb[i] >= mynode.volume) {
+                neighb[d].boundary_site.push_back(i);
+                neighb[d].boundary_index.push_back(nb[i]);
+            }
+        }
+        for (unsigned i = 0; i < mynode.volume; i++)
+            assert(neighb[d][i] == nb[i] && "LOW_MEMORY_LATTICE neighbour mismatch");
+        free(nb);
+#endif
+
         // and advance offset for next direction
         c_offset += from_node.sites;
 
@@ -779,6 +892,10 @@ void lattice_struct::initialize_wait_arrays() {
      * at that dir is out of the local volume
      */
 
+#ifdef LOW_MEMORY_LATTICE
+    // the mask is computed from the coordinates
+    wait_arr_.lat = this;
+#else
     wait_arr_ = (dir_mask_t *)memalloc(mynode.volume * sizeof(unsigned char));
 
     for (size_t i = 0; i < mynode.volume; i++) {
@@ -792,6 +909,31 @@ void lattice_struct::initialize_wait_arrays() {
         }
     }
 #endif
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////
+/// Memory taken by the per-site lattice tables on this node
+
+size_t lattice_struct::metadata_bytes() const {
+    size_t bytes = 0;
+#ifndef LOW_MEMORY_LATTICE
+    bytes += NDIRS * mynode.volume * sizeof(unsigned);
+#if !(defined(CUDA) || defined(HIP))
+    bytes += mynode.volume * sizeof(dir_mask_t);
+#endif
+#ifdef EVEN_SITES_FIRST
+    bytes += mynode.coordinates.size() * sizeof(CoordinateVector);
+#endif
+#if defined(BOUNDARY_LAYER_LAYOUT) || defined(TILED_SITE_ORDER)
+    bytes += mynode.map_site_index.size() * sizeof(unsigned);
+#endif
+#else
+    bytes += mynode.row_parity.size();
+    for (int d = 0; d < NDIRS; d++)
+        bytes += neighb[d].boundary_site.size() * 2 * sizeof(unsigned);
+#endif
+    return bytes;
 }
 
 
@@ -859,7 +1001,7 @@ void lattice_struct::init_special_boundaries() {
 /////////////////////////////////////////////////////////////////////
 /// give the neighbour array pointer.  Allocate if needed
 
-const unsigned *lattice_struct::get_neighbour_array(Direction d, hila::bc bc) {
+lattice_struct::neighbour_array_t lattice_struct::get_neighbour_array(Direction d, hila::bc bc) {
 
 #ifndef SPECIAL_BOUNDARY_CONDITIONS
     assert(bc == hila::bc::PERIODIC &&
@@ -867,6 +1009,7 @@ const unsigned *lattice_struct::get_neighbour_array(Direction d, hila::bc bc) {
     return neighb[d];
 #else
 
+#ifndef LOW_MEMORY_LATTICE
     // regular bc exit, should happen almost always
     if (special_boundaries[d].is_needed == false || bc == hila::bc::PERIODIC)
         return neighb[d];
@@ -875,6 +1018,15 @@ const unsigned *lattice_struct::get_neighbour_array(Direction d, hila::bc bc) {
         setup_special_boundary_array(d);
     }
     return special_boundaries[d].neighbours;
+#else
+    if (special_boundaries[d].is_needed == false || bc == hila::bc::PERIODIC)
+        return {&neighb[d]};
+
+    if (special_boundaries[d].neighbours == nullptr) {
+        setup_special_boundary_array(d);
+    }
+    return {special_boundaries[d].neighbours};
+#endif
 
 #endif
 }
@@ -889,7 +1041,15 @@ void lattice_struct::setup_special_boundary_array(Direction d) {
         return;
 
     // now allocate neighbour array and the gathering array
+#ifndef LOW_MEMORY_LATTICE
     special_boundaries[d].neighbours = (unsigned *)memalloc(sizeof(unsigned) * mynode.volume);
+#else
+    // only the edge sites go to the table, with indices to the new halo
+    special_boundaries[d].neighbours = new neighbour_map(neighb[d]);
+    special_boundaries[d].neighbours->wrap_from_table = true;
+    special_boundaries[d].neighbours->boundary_site.clear();
+    special_boundaries[d].neighbours->boundary_index.clear();
+#endif
     special_boundaries[d].move_index =
         (unsigned *)memalloc(sizeof(unsigned) * special_boundaries[d].n_total);
 
@@ -902,12 +1062,20 @@ void lattice_struct::setup_special_boundary_array(Direction d) {
 
     int k = 0;
     for (int i = 0; i < mynode.volume; i++) {
+#ifndef LOW_MEMORY_LATTICE
         if (coordinate(i, abs(d)) != coord) {
             special_boundaries[d].neighbours[i] = neighb[d][i];
         } else {
             special_boundaries[d].neighbours[i] = offs++;
             special_boundaries[d].move_index[k++] = neighb[d][i];
         }
+#else
+        if (coordinate(i, abs(d)) == coord) {
+            special_boundaries[d].neighbours->boundary_site.push_back(i);
+            special_boundaries[d].neighbours->boundary_index.push_back(offs++);
+            special_boundaries[d].move_index[k++] = neighb[d][i];
+        }
+#endif
     }
 
     assert(k == special_boundaries[d].n_total);
@@ -1043,12 +1211,12 @@ void lattice_struct::setup_blocked_lattice(const CoordinateVector &siz, int labe
 /// TODO: implement some other neighbour schemas!
 /////////////////////////////////////////////////////////////////////
 
-#if 0
-
 /// This is a helper routine, returning a vector of comm_node_structs for all nodes
 /// involved with communication.
-/// If receive == true, this is "receive" end and index will be filled.
-/// For receive == false the is "send" half is done.
+/// If receive == true, this is "receive" end and index will be filled: on-node sites
+/// get the local site index, off-node sites mynode.volume + position in receive buffer.
+/// For receive == false the is "send" half is done.  The order of the sitelists
+/// is fixed afterwards in create_general_gather().
 
 std::vector<lattice_struct::comm_node_struct>
 lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index,
@@ -1070,7 +1238,7 @@ lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index
     for (unsigned i = 0; i < mynode.volume; i++) {
         CoordinateVector ln, l;
         l = coordinates(i);
-        ln = (l + offset).mod(size());
+        ln = (l + offset).mod(l_size);
 
         if (is_on_mynode(ln)) {
             if (receive)
@@ -1123,18 +1291,16 @@ lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index
 
             // pre-allocate the sitelist for sufficient size
             if (!receive)
-                node_v[n].sitelist =
-                    (unsigned *)memalloc(node_v[n].sites * sizeof(unsigned));
+                node_v[n].sitelist = (unsigned *)memalloc(node_v[n].sites * sizeof(unsigned));
+            else
+                node_v[n].sitelist = nullptr;
 
-            node_v[n].buffer =
-                c_buffer; // running idx to comm buffer - used from receive
+            node_v[n].buffer = c_buffer; // running idx to comm buffer - used from receive
             c_buffer += node_v[n].sites;
             n++;
         }
     }
 
-    // ci.receive_buf_size = c_buffer;  // total buf size
-
     // we'll reuse np_even and np_odd as counting arrays below
     for (int i = 0; i < nnodes; i++)
         np_even[i] = np_odd[i] = 0;
@@ -1145,7 +1311,7 @@ lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index
         for (unsigned i = 0; i < mynode.volume; i++) {
             CoordinateVector ln, l;
             l = coordinates(i);
-            ln = (l + offset).mod(size());
+            ln = (l + offset).mod(l_size);
 
             if (!is_on_mynode(ln)) {
                 unsigned r = node_rank(ln);
@@ -1180,9 +1346,10 @@ lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index
 
                 CoordinateVector l = coordinates(i);
                 if (l.parity() == EVEN)
-                    index[i] = node_v[n].buffer + (np_even[n]++);
+                    index[i] = mynode.volume + node_v[n].buffer + (np_even[n]++);
                 else
-                    index[i] = node_v[n].buffer + node_v[n].evensites + (np_odd[n]++);
+                    index[i] =
+                        mynode.volume + node_v[n].buffer + node_v[n].evensites + (np_odd[n]++);
             }
         }
     }
@@ -1190,25 +1357,299 @@ lattice_struct::create_comm_node_vector(CoordinateVector offset, unsigned *index
     return node_v;
 }
 
+/// Create the communication pattern for fetching the field from site X + offset
+/// to site X.  After the gather the element for site i is at local site index[i]
+/// if index[i] < mynode.volume, otherwise at position index[i] - mynode.volume
+/// of the receive buffer.  Sends from to_node[n] are packed in the order of
+/// to_node[n].sitelist (parity of the receiving site, as in get_sitelist()), and
+/// received into from_node[n].offset(par).  Collective: all nodes must call this.
+
 lattice_struct::gen_comminfo_struct
 lattice_struct::create_general_gather(const CoordinateVector &offset) {
-    // allocate neighbour arrays - TODO: these should
-    // be allocated on "device" memory too!
 
     gen_comminfo_struct ci;
 
-    // communication buffer
     ci.index = (unsigned *)memalloc(mynode.volume * sizeof(unsigned));
 
-    ci.from_node =
-        create_comm_node_vector(offset, ci.index, true);          // create receive end
-    ci.to_node = create_comm_node_vector(offset, nullptr, false); // create sending end
+    ci.from_node = create_comm_node_vector(offset, ci.index, true); // create receive end
+    ci.to_node = create_comm_node_vector(offset, nullptr, false);   // create sending end
 
     // set the total receive buffer size from the last vector
-    const comm_node_struct &r = ci.from_node[ci.from_node.size() - 1];
-    ci.receive_buf_size = r.buffer + r.sites;
+    if (ci.from_node.size() > 0) {
+        const comm_node_struct &r = ci.from_node.back();
+        ci.receive_buf_size = r.buffer + r.sites;
+    } else {
+        ci.receive_buf_size = 0;
+    }
+
+    // The sending node does not know in which order the receiver lists the sites in its
+    // buffer - the site orders of the nodes need not agree (e.g. at periodic wraparound).
+    // The receiver thus sends the coordinates of the sites it needs in receive buffer
+    // order, and the sender sets its sitelist accordingly.  This is done only once per
+    // offset.
+
+    std::vector<CoordinateVector> need(ci.receive_buf_size);
+    for (unsigned i = 0; i < mynode.volume; i++) {
+        if (ci.index[i] >= mynode.volume)
+            need[ci.index[i] - mynode.volume] = (coordinates(i) + offset).mod(l_size);
+    }
+
+    size_t send_size = 0;
+    for (auto &n : ci.to_node)
+        send_size += n.sites;
+    std::vector<CoordinateVector> send_coords(send_size);
+
+    int tag = get_next_msg_tag();
+    std::vector<MPI_Request> req(ci.from_node.size() + ci.to_node.size());
+    int nreq = 0;
+
+    size_t pos = 0;
+    for (auto &n : ci.to_node) {
+        MPI_Irecv(send_coords.data() + pos, n.sites * sizeof(CoordinateVector), MPI_BYTE, n.rank,
+                  tag, mpi_comm_lat, &req[nreq++]);
+        pos += n.sites;
+    }
+    for (auto &n : ci.from_node) {
+        MPI_Isend(need.data() + n.buffer, n.sites * sizeof(CoordinateVector), MPI_BYTE, n.rank,
+                  tag, mpi_comm_lat, &req[nreq++]);
+    }
+    MPI_Waitall(nreq, req.data(), MPI_STATUSES_IGNORE);
+
+    pos = 0;
+    for (auto &n : ci.to_node) {
+        for (size_t k = 0; k < n.sites; k++)
+            n.sitelist[k] = site_index(send_coords[pos + k]);
+        pos += n.sites;
+    }
 
     return ci;
 }
 
-#endif
+/// Return the general gather for offset, creating it on first use.  Offsets which are
+/// equal modulo the lattice size share the gather.  Collective on the first call.
+/// If the cache is full, the least recently used gather is released first; since all
+/// nodes call this in the same order, they evict the same gather.
+
+const lattice_struct::gen_comminfo_struct &
+lattice_struct::get_general_gather(const CoordinateVector &offset) {
+
+    CoordinateVector o = offset.mod(l_size);
+    int64_t key = 0;
+    for (int d = NDIM - 1; d >= 0; d--)
+        key = key * l_size[d] + o[d];
+
+    auto it = gen_gather_cache.find(key);
+    if (it != gen_gather_cache.end()) {
+        it->second.last_use = ++gen_gather_use_count;
+        return it->second;
+    }
+
+    trim_general_gathers(gen_gather_cache_size - 1);
+
+    auto &ci = gen_gather_cache.emplace(key, create_general_gather(o)).first->second;
+    ci.last_use = ++gen_gather_use_count;
+    return ci;
+}
+
+/// Release the memory of a general gather
+void lattice_struct::free_general_gather(gen_comminfo_struct &ci) {
+    free(ci.index);
+    ci.index = nullptr;
+    for (auto &n : ci.to_node) {
+        free(n.sitelist);
+        n.sitelist = nullptr;
+    }
+    ci.from_node.clear();
+    ci.to_node.clear();
+}
+
+/// Release all cached general gathers, e.g. after a phase of the program which used
+/// shifts by many different offsets.  They are recreated when needed.  Collective.
+void lattice_struct::clear_general_gathers() {
+    for (auto &g : gen_gather_cache)
+        free_general_gather(g.second);
+    gen_gather_cache.clear();
+}
+
+/// Set the maximum number of cached general gathers, default 16.  Collective.
+void lattice_struct::set_general_gather_cache_size(size_t n) {
+    gen_gather_cache_size = std::max<size_t>(n, 1);
+    trim_general_gathers(gen_gather_cache_size);
+}
+
+/// Release the least recently used general gathers until at most n are left
+void lattice_struct::trim_general_gathers(size_t n) {
+    while (gen_gather_cache.size() > n) {
+        auto oldest = gen_gather_cache.begin();
+        for (auto i = gen_gather_cache.begin(); i != gen_gather_cache.end(); ++i) {
+            if (i->second.last_use < oldest->second.last_use)
+                oldest = i;
+        }
+        free_general_gather(oldest->second);
+        gen_gather_cache.erase(oldest);
+    }
+}
+
+/// Create the wide halo of depth: the sites X + v for all offsets v with
+/// 1 <= sum_d |v[d]| <= depth, including the diagonal ones.  Each off-node site is
+/// received only once, even if several offsets point to it.  As in create_general_gather()
+/// the receiver sends the coordinates of the sites it needs, and the sender sets its
+/// sitelists accordingly.  Collective: all nodes must call this.
+
+lattice_struct::halo_comminfo_struct lattice_struct::create_wide_halo(int depth) {
+
+    halo_comminfo_struct hc;
+    hc.depth = depth;
+
+    // list the offsets
+    CoordinateVector v;
+    foralldir(d) v[d] = -depth;
+    while (true) {
+        int len = 0;
+        foralldir(d) len += abs(v[d]);
+        if (len > 0 && len <= depth)
+            hc.offsets.push_back(v);
+
+        int d = 0;
+        while (d < NDIM && v[d] == depth) {
+            v[d] = -depth;
+            d++;
+        }
+        if (d == NDIM)
+            break;
+        v[d]++;
+    }
+
+    // node-lexicographic position of site c on this node
+    auto node_lex = [&](const CoordinateVector &c) {
+        unsigned l = 0;
+        foralldir(d) l += (c[d] - mynode.min[d]) * mynode.size_factor[d];
+        return l;
+    };
+
+    auto lex_key = [&](const CoordinateVector &c) {
+        int64_t key = 0;
+        for (int d = NDIM - 1; d >= 0; d--)
+            key = key * l_size[d] + c[d];
+        return key;
+    };
+
+    // the off-node sites needed, per rank, and their positions in these lists
+    std::vector<std::vector<CoordinateVector>> need(nodes.number);
+    std::unordered_map<int64_t, unsigned> position;
+
+    for (auto &off : hc.offsets) {
+        for (unsigned i = 0; i < mynode.volume; i++) {
+            CoordinateVector c = (coordinates(i) + off).mod(l_size);
+            if (!is_on_mynode(c)) {
+                int64_t key = lex_key(c);
+                if (position.count(key) == 0) {
+                    int r = node_rank(c);
+                    position[key] = need[r].size();
+                    need[r].push_back(c);
+                }
+            }
+        }
+    }
+
+    // receive buffer is in rank order
+    std::vector<size_t> buffer_start(nodes.number);
+    size_t c_buffer = 0;
+    for (int r = 0; r < nodes.number; r++) {
+        buffer_start[r] = c_buffer;
+        if (need[r].size() > 0) {
+            comm_node_struct n;
+            n.rank = r;
+            n.sites = n.evensites = need[r].size();
+            n.oddsites = 0;
+            n.buffer = c_buffer;
+            n.sitelist = nullptr;
+            hc.from_node.push_back(n);
+            c_buffer += n.sites;
+        }
+    }
+    hc.receive_buf_size = c_buffer;
+
+    for (auto &off : hc.offsets) {
+        unsigned *index = (unsigned *)memalloc(mynode.volume * sizeof(unsigned));
+        for (unsigned i = 0; i < mynode.volume; i++) {
+            CoordinateVector c = (coordinates(i) + off).mod(l_size);
+            unsigned l = node_lex(coordinates(i));
+            if (is_on_mynode(c))
+                index[l] = node_lex(c);
+            else
+                index[l] = mynode.volume + buffer_start[node_rank(c)] + position[lex_key(c)];
+        }
+        hc.index.push_back(index);
+    }
+
+    // how many sites the others need from this node
+    std::vector<int> n_need(nodes.number), n_send(nodes.number);
+    for (int r = 0; r < nodes.number; r++)
+        n_need[r] = need[r].size();
+    MPI_Alltoall(n_need.data(), 1, MPI_INT, n_send.data(), 1, MPI_INT, mpi_comm_lat);
+
+    for (int r = 0; r < nodes.number; r++) {
+        if (n_send[r] > 0) {
+            comm_node_struct n;
+            n.rank = r;
+            n.sites = n.evensites = n_send[r];
+            n.oddsites = 0;
+            n.buffer = 0;
+            n.sitelist = (unsigned *)memalloc(n.sites * sizeof(unsigned));
+            hc.to_node.push_back(n);
+        }
+    }
+
+    std::vector<std::vector<CoordinateVector>> send_coords(hc.to_node.size());
+
+    int tag = get_next_msg_tag();
+    std::vector<MPI_Request> req(hc.from_node.size() + hc.to_node.size());
+    int nreq = 0;
+
+    for (int k = 0; k < hc.to_node.size(); k++) {
+        auto &n = hc.to_node[k];
+        send_coords[k].resize(n.sites);
+        MPI_Irecv(send_coords[k].data(), n.sites * sizeof(CoordinateVector), MPI_BYTE, n.rank,
+                  tag, mpi_comm_lat, &req[nreq++]);
+    }
+    for (auto &n : hc.from_node) {
+        MPI_Isend(need[n.rank].data(), n.sites * sizeof(CoordinateVector), MPI_BYTE, n.rank, tag,
+                  mpi_comm_lat, &req[nreq++]);
+    }
+    MPI_Waitall(nreq, req.data(), MPI_STATUSES_IGNORE);
+
+    for (int k = 0; k < hc.to_node.size(); k++) {
+        auto &n = hc.to_node[k];
+        for (size_t j = 0; j < n.sites; j++)
+            n.sitelist[j] = node_lex(send_coords[k][j]);
+    }
+
+    return hc;
+}
+
+/// Return the wide halo of depth, creating it on first use.  Collective on the first call.
+
+const lattice_struct::halo_comminfo_struct &lattice_struct::get_wide_halo(int depth) {
+
+    auto it = wide_halo_cache.find(depth);
+    if (it != wide_halo_cache.end())
+        return it->second;
+
+    return wide_halo_cache.emplace(depth, create_wide_halo(depth)).first->second;
+}
+
+/// Release the index tables of all wide halos.  They are recreated when a field with
+/// a wide halo is gathered again; the fields keep their halo buffers, which are released
+/// with set_halo_depth(1).  Collective.
+
+void lattice_struct::clear_wide_halos() {
+    for (auto &h : wide_halo_cache) {
+        for (auto *index : h.second.index)
+            free(index);
+        for (auto &n : h.second.to_node)
+            free(n.sitelist);
+    }
+    wide_halo_cache.clear();
+}
+
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <array>
 #include <vector>
+#include <unordered_map>
 
 // SUBNODE_LAYOUT is now defined in main.mk
 // #define SUBNODE_LAYOUT
@@ -67,6 +68,25 @@ extern int64_t n_gather_done, n_gather_avoided;
 /// this through lattice.backend_lattice.
 struct backend_lattice_struct;
 
+#ifdef LOW_MEMORY_LATTICE
+namespace hila {
+/// Division by a run-time constant with a multiplication, exact for 32-bit operands
+/// (Lemire, Kaser, Kurz: "Faster remainder by direct computation", 2019)
+struct fast_divisor {
+    uint64_t M;
+    unsigned d;
+
+    void set(unsigned div) {
+        d = div;
+        M = (div > 1) ? UINT64_MAX / div + 1 : 0;
+    }
+    unsigned divide(unsigned n) const {
+        return (d == 1) ? n : (unsigned)(((__uint128_t)M * n) >> 64);
+    }
+};
+} // namespace hila
+#endif
+
 /// The lattice struct defines the lattice geometry ans sets up MPI communication
 /// patterns.
 class lattice_struct {
@@ -93,12 +113,15 @@ class lattice_struct {
 
         Vector<NDIM, unsigned> size_factor; // components: 1, size[0], size[0]*size[1], ...
 
-#ifdef EVEN_SITES_FIRST
+#if defined(EVEN_SITES_FIRST) && !defined(LOW_MEMORY_LATTICE)
         std::vector<CoordinateVector> coordinates;
 #endif
 
-#ifdef BOUNDARY_LAYER_LAYOUT
+#if defined(BOUNDARY_LAYER_LAYOUT) || defined(TILED_SITE_ORDER)
         std::vector<unsigned> map_site_index;
+#endif
+
+#ifdef BOUNDARY_LAYER_LAYOUT
         // in physical layout, sites are (if EVEN_SITES_FIRST)
         // inner_even + inner_odd + boundary_even + boundary_odd
         // if not  EVEN_SITES_FIRST the _odd variables are unused
@@ -108,12 +131,30 @@ class lattice_struct {
         void construct_index_map();
 #endif
 
+#ifdef TILED_SITE_ORDER
+        void construct_tiled_index_map();
+#endif
+
         void setup(node_info &ni, lattice_struct &lattice);
 
         void advance_local_coordinate(CoordinateVector &cv) const;
 
         unsigned get_logical_index(const CoordinateVector &cv) const;
 
+#ifdef LOW_MEMORY_LATTICE
+        /// parity of the first site of each x-row (1 = odd), fixes the logical index of
+        /// EVEN_SITES_FIRST site indices without decoding all coordinates
+        std::vector<uint8_t> row_parity;
+
+        /// divisions by size[d] and size_factor[d]
+        hila::fast_divisor size_div[NDIM], size_factor_div[NDIM];
+
+        /// logical index of site index idx
+        inline unsigned logical_index_of_site(unsigned idx) const;
+        /// same, and the coordinates relative to min in lc
+        inline unsigned logical_index_of_site(unsigned idx, CoordinateVector &lc) const;
+#endif
+
 #ifdef SUBNODE_LAYOUT
         /// If we have vectorized-style layout, we introduce "subnodes"
         /// size is mynode.size/subnodes.divisions, which is not
@@ -225,23 +266,109 @@ class lattice_struct {
         std::vector<comm_node_struct> from_node;
         std::vector<comm_node_struct> to_node;
         size_t receive_buf_size;
+        int64_t last_use; // for evicting the least recently used cached gather
+    };
+
+    /// wide halo: all sites within depth hops (sum of |offset| components) of the
+    /// node, exchanged at once.  Halo sites are not split by parity, thus all comm nodes
+    /// have oddsites == 0 and the halo is always exchanged for ALL sites.
+    /// The sites are numbered in node-lexicographic order, (c - mynode.min) dot
+    /// mynode.size_factor, which can be computed in site loops.  The halo buffer of a
+    /// field holds the local sites in this order, followed by the received halo sites.
+    struct halo_comminfo_struct {
+        int depth;
+        std::vector<CoordinateVector> offsets;
+        /// index[k][l] is the position of site l + offsets[k] in the halo buffer,
+        /// l in node-lexicographic order.  Also to_node sitelists are in this order.
+        std::vector<unsigned *> index;
+        std::vector<comm_node_struct> from_node;
+        std::vector<comm_node_struct> to_node;
+        size_t receive_buf_size;
+
+        /// index array for offset v, nullptr if v is not within the halo
+        const unsigned *get_index(const CoordinateVector &v) const {
+            for (int k = 0; k < offsets.size(); k++)
+                if (offsets[k] == v)
+                    return index[k];
+            return nullptr;
+        }
     };
 
     /// nearest neighbour comminfo struct
     std::array<nn_comminfo_struct, NDIRS> nn_comminfo;
 
+    /// general gathers created so far, keyed by the offset (mod lattice size),
+    /// see get_general_gather().  At most gen_gather_cache_size are kept, the least
+    /// recently used is released first.
+    std::unordered_map<int64_t, gen_comminfo_struct> gen_gather_cache;
+    size_t gen_gather_cache_size = 16;
+    int64_t gen_gather_use_count = 0;
+
+    /// wide halos created so far, keyed by the depth, see get_wide_halo()
+    std::unordered_map<int, halo_comminfo_struct> wide_halo_cache;
+
+#ifndef LOW_MEMORY_LATTICE
+
+    /// neighbour index array type in Field
+    using neighbour_array_t = const unsigned *RESTRICT;
+
     /// Main neighbour index array
     unsigned *RESTRICT neighb[NDIRS];
 
     /// implement waiting using mask_t - unsigned char is good for up to 4 dim.
     dir_mask_t *RESTRICT wait_arr_;
 
+#else
+
+    /// With LOW_MEMORY_LATTICE the neighbour indices are computed from the site index.
+    /// Only the sites whose neighbour is off-node are kept in a table, sorted by site.
+    struct neighbour_map {
+        const lattice_struct *lat;
+        Direction dir;
+        // special boundary conditions: the lattice edge goes through the table also when
+        // the node wraps around it
+        bool wrap_from_table = false;
+        std::vector<unsigned> boundary_site, boundary_index;
+
+        inline unsigned operator[](unsigned idx) const;
+    };
+
+    /// wait mask of a site computed from its coordinates, replaces the wait_arr_ table
+    struct wait_map {
+        const lattice_struct *lat;
+
+        inline dir_mask_t operator[](unsigned idx) const;
+    };
+
+    /// handle to neighbour_map, stands for the neighbour index array in Field
+    struct neighbour_ptr {
+        const neighbour_map *map;
+
+        unsigned operator[](unsigned idx) const {
+            return (*map)[idx];
+        }
+    };
+
+    using neighbour_array_t = neighbour_ptr;
+
+    neighbour_map neighb[NDIRS];
+    wait_map wait_arr_;
+
+#endif
+
+    /// bytes used by the per-site lattice tables (coordinates, neighbours, wait array)
+    size_t metadata_bytes() const;
+
 #ifdef SPECIAL_BOUNDARY_CONDITIONS
     /// special boundary pointers are needed only in cases neighbour
     /// pointers must be modified (new halo elements). That is known only during
     /// runtime.
     struct special_boundary_struct {
+#ifndef LOW_MEMORY_LATTICE
         unsigned *neighbours;
+#else
+        neighbour_map *neighbours;
+#endif
         unsigned *move_index;
         size_t offset, n_even, n_odd, n_total;
         bool is_needed;
@@ -275,6 +402,14 @@ class lattice_struct {
 
     void create_std_gathers();
     gen_comminfo_struct create_general_gather(const CoordinateVector &r);
+    const gen_comminfo_struct &get_general_gather(const CoordinateVector &offset);
+    void free_general_gather(gen_comminfo_struct &ci);
+    void clear_general_gathers();
+    void set_general_gather_cache_size(size_t n);
+    void trim_general_gathers(size_t n);
+    halo_comminfo_struct create_wide_halo(int depth);
+    const halo_comminfo_struct &get_wide_halo(int depth);
+    void clear_wide_halos();
     std::vector<comm_node_struct> create_comm_node_vector(CoordinateVector offset, unsigned *index,
                                                           bool receive);
 
@@ -286,11 +421,15 @@ class lattice_struct {
     void init_special_boundaries();
     void setup_special_boundary_array(Direction d);
 
-    const unsigned *get_neighbour_array(Direction d, hila::bc bc);
-#else
+    neighbour_array_t get_neighbour_array(Direction d, hila::bc bc);
+#elif !defined(LOW_MEMORY_LATTICE)
     const unsigned *get_neighbour_array(Direction d, hila::bc bc) {
         return neighb[d];
     }
+#else
+    neighbour_ptr get_neighbour_array(Direction d, hila::bc bc) const {
+        return {&neighb[d]};
+    }
 #endif
 
 #if defined(EVEN_SITES_FIRST)
@@ -316,6 +455,8 @@ class lattice_struct {
 
 #endif
 
+#ifndef LOW_MEMORY_LATTICE
+
     inline const CoordinateVector &coordinates(unsigned idx) const {
         return mynode.coordinates[idx];
     }
@@ -324,6 +465,20 @@ class lattice_struct {
         return mynode.coordinates[idx][d];
     }
 
+#else
+
+    inline const CoordinateVector coordinates(unsigned idx) const {
+        CoordinateVector c;
+        mynode.logical_index_of_site(idx, c);
+        return c + mynode.min;
+    }
+
+    inline int coordinate(unsigned idx, Direction d) const {
+        return coordinates(idx)[d];
+    }
+
+#endif
+
     inline Parity site_parity(unsigned idx) const {
         return coordinates(idx).parity();
     }
@@ -403,6 +558,90 @@ class lattice_struct {
     void set_lattice_globals() const;
 };
 
+#ifdef LOW_MEMORY_LATTICE
+
+inline unsigned lattice_struct::node_struct::logical_index_of_site(unsigned idx) const {
+#ifdef EVEN_SITES_FIRST
+    // even site k is logical index 2k or 2k+1, these have always opposite parities
+    bool even = idx < evensites;
+    unsigned j = 2 * (even ? idx : idx - evensites);
+    unsigned row = size_div[0].divide(j);
+    if (((row_parity[row] + j - row * size[0]) % 2 == 0) != even)
+        j++;
+    return j;
+#else
+    return idx;
+#endif
+}
+
+inline unsigned lattice_struct::node_struct::logical_index_of_site(unsigned idx,
+                                                                    CoordinateVector &lc) const {
+    unsigned j = logical_index_of_site(idx);
+    unsigned vdiv = j, ndiv;
+    for (int d = 0; d < NDIM - 1; ++d) {
+        ndiv = size_div[d].divide(vdiv);
+        lc[d] = vdiv - ndiv * size[d];
+        vdiv = ndiv;
+    }
+    lc[NDIM - 1] = vdiv;
+    return j;
+}
+
+inline unsigned lattice_struct::neighbour_map::operator[](unsigned idx) const {
+    const node_struct &node = lat->mynode;
+    unsigned j = node.logical_index_of_site(idx);
+    Direction ad = abs(dir);
+    unsigned q = node.size_factor_div[ad].divide(j);
+    unsigned c = q - node.size_div[ad].divide(q) * node.size[ad];
+    bool wrap = false;
+
+    if (is_up_dir(dir) ? c < node.size[ad] - 1 : c > 0) {
+        if (is_up_dir(dir))
+            j += node.size_factor[ad];
+        else
+            j -= node.size_factor[ad];
+    } else if (node.size[ad] == lat->l_size[ad] && !wrap_from_table) {
+        // node spans the lattice, wraps around on node
+        wrap = true;
+        if (is_up_dir(dir))
+            j -= (node.size[ad] - 1) * node.size_factor[ad];
+        else
+            j += (node.size[ad] - 1) * node.size_factor[ad];
+    } else {
+        // off-node, index to the halo from the table
+        auto it = std::lower_bound(boundary_site.begin(), boundary_site.end(), idx);
+        return boundary_index[it - boundary_site.begin()];
+    }
+
+#ifdef EVEN_SITES_FIRST
+    // neighbour has opposite parity, except when wrapping around odd lattice size
+    bool even = idx < node.evensites;
+    if (!(wrap && lat->l_size[ad] % 2 == 1))
+        even = !even;
+    return even ? j / 2 : j / 2 + node.evensites;
+#else
+    return j;
+#endif
+}
+
+inline dir_mask_t lattice_struct::wait_map::operator[](unsigned idx) const {
+    const node_struct &node = lat->mynode;
+    CoordinateVector lc;
+    node.logical_index_of_site(idx, lc);
+    dir_mask_t mask = 0;
+    foralldir (d) {
+        if (node.size[d] != lat->l_size[d]) {
+            if (lc[d] == node.size[d] - 1)
+                mask |= (1 << d);
+            if (lc[d] == 0)
+                mask |= (1 << (-d));
+        }
+    }
+    return mask;
+}
+
+#endif
+
 
 /**
  * @brief global vector of defined lattice pointers
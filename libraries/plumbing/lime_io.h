@@ -0,0 +1,433 @@
+#ifndef HILA_LIME_IO_H_
+#define HILA_LIME_IO_H_
+
+/**
+ * @file lime_io.h
+ * @brief ILDG / SciDAC LIME gauge configuration I/O
+ * @details LIME files consist of records with a 144-byte big-endian header (magic, version,
+ * flags, data length and type string), followed by the data padded to 8 bytes.  An ILDG
+ * configuration has the records
+ *   - "ildg-format"       XML with field type, precision and lattice size
+ *   - "ildg-binary-data"  the links, big-endian, sites x fastest, links x,y,z,t for each site,
+ *                         3x3 complex matrices in row-major order
+ *   - "scidac-checksum"   XML with the SciDAC suma/sumb checksums
+ *
+ * Rank 0 writes and scans the record headers and metadata, the binary data record is
+ * read and written with collective MPI-IO by all ranks.
+ */
+
+#include "plumbing/gaugefield.h"
+
+namespace hila {
+namespace lime {
+
+constexpr uint32_t magic = 0x456789ab;
+constexpr uint16_t version = 1;
+constexpr int header_size = 144;
+constexpr int type_size = 128;
+
+/// Swap bytes of n elements of type P in place, if the host is little-endian.  Simple loop
+/// over words, vectorized by the compiler
+template <typename P>
+inline void swap_big_endian(P *data, size_t n) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return;
+#else
+    static_assert(sizeof(P) == 2 || sizeof(P) == 4 || sizeof(P) == 8,
+                  "swap_big_endian(): unsupported element size");
+    if constexpr (sizeof(P) == 8) {
+        uint64_t *w = reinterpret_cast<uint64_t *>(data);
+        for (size_t i = 0; i < n; i++)
+            w[i] = __builtin_bswap64(w[i]);
+    } else if constexpr (sizeof(P) == 4) {
+        uint32_t *w = reinterpret_cast<uint32_t *>(data);
+        for (size_t i = 0; i < n; i++)
+            w[i] = __builtin_bswap32(w[i]);
+    } else {
+        uint16_t *w = reinterpret_cast<uint16_t *>(data);
+        for (size_t i = 0; i < n; i++)
+            w[i] = __builtin_bswap16(w[i]);
+    }
+#endif
+}
+
+/// LIME data is padded to a multiple of 8 bytes
+inline int64_t padding(int64_t length) {
+    return (8 - length % 8) % 8;
+}
+
+/// Write record header.  mb, me: message begin and end flags
+inline void write_record_header(std::ostream &out, const std::string &type, uint64_t length,
+                                bool mb, bool me) {
+    char h[header_size] = {0};
+    uint32_t m = magic;
+    uint16_t v = version;
+    uint16_t flags = (mb ? 0x8000 : 0) | (me ? 0x4000 : 0);
+    swap_big_endian(&m, 1);
+    swap_big_endian(&v, 1);
+    swap_big_endian(&flags, 1);
+    swap_big_endian(&length, 1);
+    std::memcpy(h, &m, 4);
+    std::memcpy(h + 4, &v, 2);
+    std::memcpy(h + 6, &flags, 2);
+    std::memcpy(h + 8, &length, 8);
+    std::strncpy(h + 16, type.c_str(), type_size - 1);
+    out.write(h, header_size);
+}
+
+/// Write a complete record with string data
+inline void write_record(std::ostream &out, const std::string &type, const std::string &data,
+                         bool mb, bool me) {
+    write_record_header(out, type, data.size(), mb, me);
+    out.write(data.data(), data.size());
+    const char zeros[8] = {0};
+    out.write(zeros, padding(data.size()));
+}
+
+/// Read record header, return false at end of file or if the header is not valid
+inline bool read_record_header(std::istream &in, std::string &type, uint64_t &length) {
+    char h[header_size];
+    in.read(h, header_size);
+    if (in.gcount() != header_size)
+        return false;
+    uint32_t m;
+    std::memcpy(&m, h, 4);
+    std::memcpy(&length, h + 8, 8);
+    swap_big_endian(&m, 1);
+    swap_big_endian(&length, 1);
+    if (m != magic)
+        return false;
+    h[16 + type_size - 1] = 0;
+    type = h + 16;
+    return true;
+}
+
+/// Content of the first <tag> ... </tag> in xml, empty if not found
+inline std::string xml_value(const std::string &xml, const std::string &tag) {
+    auto b = xml.find("<" + tag + ">");
+    if (b == std::string::npos)
+        return "";
+    b += tag.size() + 2;
+    auto e = xml.find("</" + tag + ">", b);
+    if (e == std::string::npos)
+        return "";
+    return xml.substr(b, e - b);
+}
+
+/// Standard (zlib) CRC-32 of n bytes
+inline uint32_t crc32(const void *data, size_t n) {
+    static uint32_t table[256];
+    static bool init = false;
+    if (!init) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        init = true;
+    }
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < n; i++)
+        c = table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+/// SciDAC checksum: site data (as in the file) with lexicographic site index
+/// are combined to suma, sumb with xor, thus the result does not depend on the order
+inline void scidac_checksum_add(const void *site, size_t n, int64_t index, uint32_t &suma,
+                                uint32_t &sumb) {
+    uint32_t crc = crc32(site, n);
+    int a = index % 29, b = index % 31;
+    suma ^= (a == 0) ? crc : (crc << a) | (crc >> (32 - a));
+    sumb ^= (b == 0) ? crc : (crc << b) | (crc >> (32 - b));
+}
+
+/// xor-reduce suma, sumb over ranks
+inline void scidac_checksum_reduce(uint32_t &suma, uint32_t &sumb) {
+    uint32_t s[2] = {suma, sumb}, r[2];
+    MPI_Allreduce(s, r, 2, MPI_UNSIGNED, MPI_BXOR, lattice->mpi_comm_lat);
+    suma = r[0];
+    sumb = r[1];
+}
+
+/// True for link types which can be stored in ILDG format, i.e. 3x3 complex matrices
+template <typename T, typename = void>
+struct is_ildg_link : std::false_type {};
+
+template <typename T>
+struct is_ildg_link<T, std::enable_if_t<hila::is_matrix<T>::value>>
+    : std::integral_constant<bool, T::rows() == 3 && T::columns() == 3 &&
+                                       hila::contains_complex<T>::value> {};
+
+/// Number of real numbers in site data (4 links)
+constexpr int site_reals = NDIM * 3 * 3 * 2;
+
+/// Lattice size tags in the ildg-format XML
+inline const char *size_tag[4] = {"lx", "ly", "lz", "lt"};
+
+/// Collective: write the local sites of U, converted to precision P and big-endian, to fh
+/// at offset.  Returns the SciDAC checksum of the whole data
+template <typename P, typename T>
+void ildg_write_data(const GaugeField<T> &U, MPI_File &fh, int64_t offset, uint32_t &suma,
+                     uint32_t &sumb) {
+
+    const lattice_struct *lat = lattice.ptr();
+    size_t vol = lat->mynode.volume;
+    std::vector<P> buf(vol * site_reals);
+    std::vector<T> links;
+
+    // interleave the directions: site major, link minor
+    foralldir (d) {
+        U[d].copy_local_data(links);
+        for (size_t i = 0; i < vol; i++) {
+            P *p = buf.data() + i * site_reals + (int)d * 18;
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++) {
+                    *(p++) = links[i].e(r, c).re;
+                    *(p++) = links[i].e(r, c).im;
+                }
+        }
+    }
+    swap_big_endian(buf.data(), buf.size());
+
+    // checksum of the file bytes with the lexicographic site index
+    suma = sumb = 0;
+    CoordinateVector c = lat->mynode.min;
+    for (size_t i = 0; i < vol; i++) {
+        int64_t index = 0;
+        for (int d = NDIM - 1; d >= 0; d--)
+            index = index * lat->l_size[d] + c[d];
+        scidac_checksum_add(buf.data() + i * site_reals, site_reals * sizeof(P), index, suma,
+                            sumb);
+        lat->mynode.advance_local_coordinate(c);
+    }
+    scidac_checksum_reduce(suma, sumb);
+
+    MPI_Datatype etype = hila::set_mpi_file_view(fh, offset, lat, site_reals * sizeof(P));
+    MPI_File_write_at_all(fh, 0, buf.data(), (int)vol, etype, MPI_STATUS_IGNORE);
+    hila::free_mpi_file_view(etype);
+}
+
+/// Collective: read the local sites of precision P from fh at offset to U, and compute
+/// the SciDAC checksum
+template <typename P, typename T>
+void ildg_read_data(GaugeField<T> &U, MPI_File &fh, int64_t offset, uint32_t &suma,
+                    uint32_t &sumb) {
+
+    const lattice_struct *lat = lattice.ptr();
+    size_t vol = lat->mynode.volume;
+    std::vector<P> buf(vol * site_reals);
+
+    MPI_Status status;
+    int count;
+    MPI_Datatype etype = hila::set_mpi_file_view(fh, offset, lat, site_reals * sizeof(P));
+    MPI_File_read_at_all(fh, 0, buf.data(), (int)vol, etype, &status);
+    MPI_Get_count(&status, etype, &count);
+    hila::free_mpi_file_view(etype);
+
+    int error = (count != (int)vol) ? 1 : 0;
+    if (hila::reduce_node_sum(error) > 0) {
+        hila::out0 << "ILDG ERROR: unexpected end of file\n";
+        hila::terminate(1);
+    }
+
+    suma = sumb = 0;
+    CoordinateVector c = lat->mynode.min;
+    for (size_t i = 0; i < vol; i++) {
+        int64_t index = 0;
+        for (int d = NDIM - 1; d >= 0; d--)
+            index = index * lat->l_size[d] + c[d];
+        scidac_checksum_add(buf.data() + i * site_reals, site_reals * sizeof(P), index, suma,
+                            sumb);
+        lat->mynode.advance_local_coordinate(c);
+    }
+    scidac_checksum_reduce(suma, sumb);
+
+    swap_big_endian(buf.data(), buf.size());
+
+    std::vector<T> links(vol);
+    foralldir (d) {
+        for (size_t i = 0; i < vol; i++) {
+            const P *p = buf.data() + i * site_reals + (int)d * 18;
+            for (int r = 0; r < 3; r++)
+                for (int c = 0; c < 3; c++) {
+                    links[i].e(r, c).re = p[0];
+                    links[i].e(r, c).im = p[1];
+                    p += 2;
+                }
+        }
+        U[d].set_local_data(links);
+    }
+}
+
+} // namespace lime
+} // namespace hila
+
+//////////////////////////////////////////////////////////////////////////////////
+
+/// Write the gauge field in ILDG format, with precision 32 or 64 bits.
+/// Available for 4-dimensional SU(3) (3x3 complex matrix) gauge fields.
+template <typename T>
+void GaugeField<T>::ildg_write(const std::string &filename, int precision) const {
+    using namespace hila::lime;
+
+    if constexpr (NDIM != 4 || !is_ildg_link<T>::value) {
+        hila::out0 << "ILDG ERROR: ILDG format requires 4-dimensional SU(3) gauge field\n";
+        hila::terminate(1);
+    } else {
+        if (precision != 32 && precision != 64) {
+            hila::out0 << "ILDG ERROR: precision must be 32 or 64, is " << precision << '\n';
+            hila::terminate(1);
+        }
+
+        int64_t data_length = lattice.volume() * site_reals * (precision / 8);
+
+        std::stringstream xml;
+        xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            << "<ildgFormat xmlns=\"http://www.lqcd.org/ildg\" "
+            << "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+            << "xsi:schemaLocation=\"http://www.lqcd.org/ildg "
+            << "http://www.lqcd.org/ildg/filefmt.xsd\">"
+            << "<version>1.0</version><field>su3gauge</field>"
+            << "<precision>" << precision << "</precision>";
+        foralldir (d)
+            xml << '<' << size_tag[d] << '>' << lattice.size(d) << "</" << size_tag[d] << '>';
+        xml << "</ildgFormat>";
+
+        // metadata record and the header of the data record
+        std::ofstream outputfile;
+        hila::open_output_file(filename, outputfile);
+        int64_t data_offset = 0;
+        if (hila::myrank() == 0) {
+            write_record(outputfile, "ildg-format", xml.str(), true, false);
+            write_record_header(outputfile, "ildg-binary-data", data_length, false, false);
+            data_offset = outputfile.tellp();
+        }
+        hila::close_file(filename, outputfile);
+        hila::broadcast(data_offset);
+
+        uint32_t suma, sumb;
+        MPI_File fh;
+        hila::open_mpi_output_file(filename, fh, false);
+        if (precision == 32)
+            ildg_write_data<float>(*this, fh, data_offset, suma, sumb);
+        else
+            ildg_write_data<double>(*this, fh, data_offset, suma, sumb);
+        hila::close_mpi_file(filename, fh);
+
+        // checksum record after the data
+        if (hila::myrank() == 0) {
+            std::stringstream cs;
+            cs << "<?xml version=\"1.0\" encoding=\"UTF-8\"?><scidacChecksum>"
+               << "<version>1.0</version>" << std::hex << "<suma>" << suma << "</suma>"
+               << "<sumb>" << sumb << "</sumb></scidacChecksum>";
+
+            std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+            f.seekp(data_offset + data_length + padding(data_length));
+            write_record(f, "scidac-checksum", cs.str(), false, true);
+            f.close();
+        }
+        hila::synchronize();
+    }
+}
+
+/// Read ILDG format gauge field.  The lattice size must match, the precision of the file
+/// may differ from that of T.  The SciDAC checksum is verified if present
+template <typename T>
+void GaugeField<T>::ildg_read(const std::string &filename) {
+    using namespace hila::lime;
+
+    if constexpr (NDIM != 4 || !is_ildg_link<T>::value) {
+        hila::out0 << "ILDG ERROR: ILDG format requires 4-dimensional SU(3) gauge field\n";
+        hila::terminate(1);
+    } else {
+        std::string ildgerr("ILDG ERROR in file " + filename + ": ");
+
+        std::ifstream inputfile;
+        hila::open_input_file(filename, inputfile);
+
+        // rank 0 scans the records
+        bool ok = true;
+        int precision = 0, has_checksum = 0;
+        int64_t data_offset = -1, data_length = 0;
+        uint32_t suma = 0, sumb = 0;
+        CoordinateVector insize;
+        insize.fill(0);
+
+        if (hila::myrank() == 0) {
+            std::string type;
+            uint64_t length;
+            while (read_record_header(inputfile, type, length)) {
+                int64_t pos = inputfile.tellg();
+                if (type == "ildg-format" || type == "scidac-checksum") {
+                    std::string xml(length, '\0');
+                    inputfile.read(&xml[0], length);
+                    if (type == "ildg-format") {
+                        if (xml_value(xml, "field") != "su3gauge") {
+                            hila::out0 << ildgerr << "field type is not su3gauge\n";
+                            ok = false;
+                        }
+                        precision = std::atoi(xml_value(xml, "precision").c_str());
+                        foralldir (d)
+                            insize[d] = std::atoi(xml_value(xml, size_tag[d]).c_str());
+                    } else {
+                        has_checksum = 1;
+                        suma = std::strtoul(xml_value(xml, "suma").c_str(), nullptr, 16);
+                        sumb = std::strtoul(xml_value(xml, "sumb").c_str(), nullptr, 16);
+                    }
+                } else if (type == "ildg-binary-data") {
+                    data_offset = pos;
+                    data_length = length;
+                }
+                inputfile.seekg(pos + length + padding(length));
+            }
+
+            if (ok && data_offset < 0) {
+                hila::out0 << ildgerr << "no ildg-binary-data record\n";
+                ok = false;
+            }
+            if (ok && precision != 32 && precision != 64) {
+                hila::out0 << ildgerr << "unknown precision " << precision << '\n';
+                ok = false;
+            }
+            if (ok && !(insize == lattice.size())) {
+                hila::out0 << ildgerr << "lattice size " << insize << " should be "
+                           << lattice.size() << '\n';
+                ok = false;
+            }
+            if (ok && data_length != lattice.volume() * site_reals * (precision / 8)) {
+                hila::out0 << ildgerr << "wrong binary data length " << data_length << '\n';
+                ok = false;
+            }
+        }
+        hila::close_file(filename, inputfile);
+
+        if (!hila::broadcast(ok))
+            hila::terminate(1);
+
+        hila::broadcast(precision);
+        hila::broadcast(data_offset);
+        hila::broadcast(has_checksum);
+        hila::broadcast(suma);
+        hila::broadcast(sumb);
+
+        uint32_t checka, checkb;
+        MPI_File fh;
+        hila::open_mpi_input_file(filename, fh);
+        if (precision == 32)
+            ildg_read_data<float>(*this, fh, data_offset, checka, checkb);
+        else
+            ildg_read_data<double>(*this, fh, data_offset, checka, checkb);
+        hila::close_mpi_file(filename, fh);
+
+        if (has_checksum && (checka != suma || checkb != sumb)) {
+            hila::out0 << ildgerr << "SciDAC checksum mismatch, file " << std::hex << suma << ' '
+                       << sumb << ", data " << checka << ' ' << checkb << std::dec << '\n';
+            hila::terminate(1);
+        }
+    }
+}
+
+#endif
@@ -10,11 +10,15 @@
 ///
 /// Used especially in transformation coordinate -> node_rank, in
 /// lattice_struct::node_rank in
+///
+/// With NODE_LAYOUT_HOST the number of node faces inside and between hosts is printed.
 
 
 #include "plumbing/defs.h"
 #include "plumbing/lattice.h"
 
+#include <map>
+
 #if defined(NODE_LAYOUT_TRIVIAL)
 
 ////////////////////////////////////////////////////////////////////
@@ -141,8 +145,192 @@ int lattice_struct::allnodes::inverse_remap(int i) const {
 }
 
 
+#elif defined(NODE_LAYOUT_HOST)
+
+////////////////////////////////////////////////////////////////////
+/// Find the host of each rank, using MPI shared memory split.  The host is labeled
+/// by the smallest rank on it.
+////////////////////////////////////////////////////////////////////
+
+static std::vector<int> find_host_of_ranks() {
+
+    MPI_Comm host_comm;
+    MPI_Comm_split_type(lattice->mpi_comm_lat, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                        &host_comm);
+    int myrank = hila::myrank(), host;
+    MPI_Allreduce(&myrank, &host, 1, MPI_INT, MPI_MIN, host_comm);
+    MPI_Comm_free(&host_comm);
+
+    std::vector<int> host_of(hila::number_of_nodes());
+    MPI_Allgather(&host, 1, MPI_INT, host_of.data(), 1, MPI_INT, lattice->mpi_comm_lat);
+    return host_of;
+}
+
+////////////////////////////////////////////////////////////////////
+/// Print the number of node faces (pairs of nearest neighbour nodes) inside hosts and
+/// between hosts, for comparing the layouts
+////////////////////////////////////////////////////////////////////
+
+static void report_host_faces(const lattice_struct::allnodes &nodes,
+                              const std::vector<int> &host_of) {
+
+    int64_t intra = 0, inter = 0;
+    for (int i = 0; i < nodes.number; i++) {
+        CoordinateVector lcoord;
+        int idiv = i;
+        foralldir(d) {
+            lcoord[d] = idiv % nodes.n_divisions[d];
+            idiv /= nodes.n_divisions[d];
+        }
+
+        foralldir(d) {
+            if (nodes.n_divisions[d] > 1) {
+                // index of the neighbour to direction d
+                int j = 0, m = 1;
+                foralldir(d2) {
+                    int c = (d2 == d) ? (lcoord[d2] + 1) % nodes.n_divisions[d2] : lcoord[d2];
+                    j += c * m;
+                    m *= nodes.n_divisions[d2];
+                }
+                if (host_of[nodes.remap(i)] == host_of[nodes.remap(j)])
+                    intra++;
+                else
+                    inter++;
+            }
+        }
+    }
+
+    std::map<int, int> hosts;
+    for (int h : host_of)
+        hosts[h]++;
+
+    hila::out0 << "Node faces: " << intra << " intra-host, " << inter << " inter-host ("
+               << hosts.size() << " hosts)\n";
+}
+
+////////////////////////////////////////////////////////////////////
+// Find the ranks on each host and give each host a block of the node grid.
+// The block shape is chosen to minimize the faces between hosts: a block of
+// size b[d] has n_host/b[d] faces to both sides in direction d, unless it covers
+// the whole direction.  Inside a block and between blocks the ordering is as in
+// NODE_LAYOUT_BLOCK.  If the hosts have different numbers of ranks, or no block
+// fits the node grid, the order is left unmodified.
+////////////////////////////////////////////////////////////////////
+
+static void search_host_block(const CoordinateVector &ndiv, int n_host, int d, int remaining,
+                              CoordinateVector &block, int64_t &best_faces,
+                              CoordinateVector &best) {
+    if (d == NDIM) {
+        if (remaining != 1)
+            return;
+        int64_t faces = 0;
+        foralldir(d2) {
+            if (block[d2] < ndiv[d2])
+                faces += 2 * (n_host / block[d2]);
+        }
+        if (best_faces < 0 || faces < best_faces) {
+            best_faces = faces;
+            best = block;
+        }
+        return;
+    }
+    for (int b = 1; b <= ndiv[d]; b++) {
+        if (ndiv[d] % b == 0 && remaining % b == 0) {
+            block[d] = b;
+            search_host_block(ndiv, n_host, d + 1, remaining / b, block, best_faces, best);
+        }
+    }
+}
+
+void lattice_struct::allnodes::create_remap() {
+
+    std::vector<int> host_of = find_host_of_ranks();
+
+    // ranks of each host, in rank order
+    std::map<int, std::vector<int>> host_ranks;
+    for (int r = 0; r < host_of.size(); r++)
+        host_ranks[host_of[r]].push_back(r);
+
+    int n_host = host_ranks.begin()->second.size();
+    bool uniform = true;
+    for (auto &h : host_ranks)
+        uniform = uniform && (h.second.size() == n_host);
+
+    CoordinateVector blocksize, block;
+    int64_t faces = -1;
+    if (uniform)
+        search_host_block(this->n_divisions, n_host, 0, n_host, block, faces, blocksize);
+
+    if (faces < 0) {
+        hila::out0 << "Node remapping: NODE_LAYOUT_HOST, " << host_ranks.size()
+                   << " hosts with unequal rank numbers or no fitting block - no reordering\n";
+        this->map_array = nullptr;
+        this->map_inverse = nullptr;
+        report_host_faces(*this, host_of);
+        return;
+    }
+
+    CoordinateVector blockdivs;
+    foralldir(d) blockdivs[d] = this->n_divisions[d] / blocksize[d];
+
+    hila::out0 << "Node remapping: NODE_LAYOUT_HOST with " << host_ranks.size() << " hosts, "
+               << n_host << " ranks each\n";
+    hila::out0 << "Node block size " << blocksize << "  block division " << blockdivs << '\n';
+
+    std::vector<const std::vector<int> *> hosts;
+    for (auto &h : host_ranks)
+        hosts.push_back(&h.second);
+
+    this->map_array = (int *)memalloc(this->number * sizeof(int));
+    this->map_inverse = (int *)memalloc(this->number * sizeof(int));
+
+    for (int i = 0; i < this->number; i++) {
+        CoordinateVector lcoord, bcoord, icoord;
+        int idiv = i;
+        foralldir(d) {
+            lcoord[d] = idiv % this->n_divisions[d];
+            idiv /= this->n_divisions[d];
+
+            bcoord[d] = lcoord[d] / blocksize[d];
+            icoord[d] = lcoord[d] % blocksize[d];
+        }
+
+        // ii - index within a block, bi - index of a block = host
+        int ii, bi, im, bm;
+        ii = bi = 0;
+        im = bm = 1;
+        foralldir(d) {
+            ii += icoord[d] * im;
+            im *= blocksize[d];
+
+            bi += bcoord[d] * bm;
+            bm *= blockdivs[d];
+        }
+
+        int rank = (*hosts[bi])[ii];
+        this->map_array[i] = rank;
+        this->map_inverse[rank] = i;
+    }
+
+    report_host_faces(*this, host_of);
+}
+
+int lattice_struct::allnodes::remap(int i) const {
+    assert(i >= 0 && i < hila::number_of_nodes());
+    if (this->map_array == nullptr)
+        return i;
+    return this->map_array[i];
+}
+
+int lattice_struct::allnodes::inverse_remap(int i) const {
+    assert(i >= 0 && i < hila::number_of_nodes());
+    if (this->map_inverse == nullptr)
+        return i;
+    return this->map_inverse[i];
+}
+
 #else
 
-NODE_LAYOUT_BLOCK or NODE_LAYOUT_TRIVIAL must be defined
+NODE_LAYOUT_BLOCK, NODE_LAYOUT_HOST or NODE_LAYOUT_TRIVIAL must be defined
 
 #endif
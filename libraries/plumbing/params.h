@@ -56,10 +56,12 @@
 /// these form a compact "block" of ranks logically close togeter.
 /// Define NODE_LAYOUT_BLOCK to be the number of
 /// MPI processes within one compute node - tries to maximize the use of fast local communications.
-/// Either one of these must be defined.
+/// NODE_LAYOUT_HOST finds the ranks sharing a host at run time (MPI shared memory split) and
+/// gives each host a compact block of nodes, minimizing the faces between hosts.
+/// One of these must be defined.
 
 #if NDIM > 1
-#ifndef NODE_LAYOUT_TRIVIAL
+#if !defined(NODE_LAYOUT_TRIVIAL) && !defined(NODE_LAYOUT_HOST)
 #ifndef NODE_LAYOUT_BLOCK
 #define NODE_LAYOUT_BLOCK 4
 #endif
@@ -75,6 +77,56 @@
 #define WRITE_BUFFER_SIZE 2000000
 #endif
 
+/// MPI_SHARED_HALO
+/// If defined, nearest neighbour halos to ranks on the same host are exchanged through
+/// an MPI-3 shared memory window instead of MPI messages: the sender packs the halo into
+/// its shared "arena" and the receiver copies it directly to the receive buffer.
+/// SHARED_HALO_ARENA_SIZE is the size of the arena of each rank in bytes; if it is
+/// full, the halo is sent as a normal message.  Not used on GPUs.  Off by default; compare
+/// the nearest neighbour timings of applications/benchmark with and without it.
+#ifdef MPI_SHARED_HALO
+#if MPI_SHARED_HALO == 0 || defined(CUDA) || defined(HIP)
+#undef MPI_SHARED_HALO
+#endif
+#endif
+
+#ifndef SHARED_HALO_ARENA_SIZE
+#define SHARED_HALO_ARENA_SIZE 16000000
+#endif
+
+/// LOW_MEMORY_LATTICE
+/// If defined, site coordinates and on-node neighbour indices are computed from the site index
+/// instead of being stored per site; only sites with off-node neighbours are kept in tables.
+/// Saves ~(4*NDIRS + 4*NDIM + 1) bytes per site on every lattice (also the blocked ones) at
+/// the cost of some integer arithmetic in neighbour access.  CPU targets only.
+#ifdef LOW_MEMORY_LATTICE
+#if LOW_MEMORY_LATTICE == 0
+#undef LOW_MEMORY_LATTICE
+#elif defined(CUDA) || defined(HIP) || defined(VECTORIZED) || defined(SUBNODE_LAYOUT) ||        \
+    defined(BOUNDARY_LAYER_LAYOUT)
+#error "LOW_MEMORY_LATTICE is available only for plain CPU targets"
+#endif
+#endif
+
+/// TILED_SITE_ORDER
+/// If defined, the sites of each parity are stored tile by tile instead of in typewriter
+/// order: the node is cut into hypercubic tiles of SITE_TILE_SIZE^NDIM sites (clipped at
+/// node edges), and both the tiles and the sites inside a tile are traversed x fastest.
+/// Neighbours of a site then stay in cache across the loop, which helps stencil kernels
+/// (staples, Dirac operators) when the node is much larger than the cache.
+/// Requires EVEN_SITES_FIRST, CPU targets only.
+#ifdef TILED_SITE_ORDER
+#if TILED_SITE_ORDER == 0
+#undef TILED_SITE_ORDER
+#elif defined(CUDA) || defined(HIP) || defined(VECTORIZED) || defined(SUBNODE_LAYOUT) ||        \
+    defined(BOUNDARY_LAYER_LAYOUT) || defined(LOW_MEMORY_LATTICE) || !defined(EVEN_SITES_FIRST)
+#error "TILED_SITE_ORDER is available only for plain CPU targets with EVEN_SITES_FIRST"
+#endif
+#endif
+
+#if defined(TILED_SITE_ORDER) && !defined(SITE_TILE_SIZE)
+#define SITE_TILE_SIZE 4
+#endif
 
 // boundary conditions are "off" by default -- no need to do anything here
 // #ifndef SPECIAL_BOUNDARY_CONDITIONS
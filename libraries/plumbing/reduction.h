@@ -24,12 +24,16 @@ class Reduction {
     bool is_allreduce_ = true;
     bool is_nonblocking_ = false;
     bool is_delayed_ = false;
+    bool is_batched_ = false;
 
     bool delay_is_on = false;   // status of the delayed reduction
     bool is_delayed_sum = true; // sum/product
 
     MPI_Request request;
 
+    // state in hila::reduction_batch, if batched
+    int batch_state = hila::reduction_batch_struct::NONE;
+
     // start the actual reduction
 
     void do_reduce_operation(MPI_Op operation) {
@@ -83,6 +87,9 @@ class Reduction {
     /// This must be called for non-blocking reduce before use!
 
     void wait() {
+        if (batch_state == hila::reduction_batch_struct::IN_FLIGHT) {
+            hila::reduction_batch.wait();
+        }
         if (comm_is_on) {
             reduction_wait_timer.start();
             MPI_Status status;
@@ -117,11 +124,15 @@ class Reduction {
 
     /// Destructor cleans up communications if they are in progress
     ~Reduction() {
+        if (batch_state == hila::reduction_batch_struct::PENDING)
+            hila::reduction_batch.remove(batch_state);
         wait();
     }
 
     /// allreduce(bool) turns allreduce on or off.  By default on.
+    /// Batched reductions are always allreduce.
     Reduction &allreduce(bool b = true) {
+        assert((b || !is_batched_) && "batched() reduction cannot have allreduce(false)");
         is_allreduce_ = b;
         return *this;
     }
@@ -144,7 +155,23 @@ class Reduction {
         return *this;
     }
     bool is_delayed() {
-        return is_delayed_;
+        return is_delayed_ || is_batched_;
+    }
+
+    /// batched(bool) makes this a delayed sum reduction which is collected to
+    /// hila::reduction_batch.  All batched reductions waiting for the communication are
+    /// combined to a single MPI collective, started when value() or start_reduce()
+    /// of any of them is called, or by hila::reduction_batch.flush().
+    /// A batched reduction is delayed whatever delayed() says, and always nonblocking;
+    /// nonblocking() has no effect on it.  It must be an allreduce, allreduce(false)
+    /// is an error.
+    Reduction &batched(bool b = true) {
+        assert((!b || is_allreduce_) && "batched() reduction cannot have allreduce(false)");
+        is_batched_ = b;
+        return *this;
+    }
+    bool is_batched() {
+        return is_batched_;
     }
 
     /// Return value of the reduction variable.  Wait for the comms if needed.
@@ -163,6 +190,8 @@ class Reduction {
     /// Assignment is used only outside site loops - drop comms if on, no need to wait
     template <typename S, std::enable_if_t<hila::is_assignable<T &, S>::value, int> = 0>
     T operator=(const S &rhs) {
+        if (batch_state == hila::reduction_batch_struct::PENDING)
+            hila::reduction_batch.remove(batch_state);
         wait();
 
         comm_is_on = false;
@@ -207,17 +236,22 @@ class Reduction {
         wait(); // wait for possible ongoing
 
         // add the node values to reduction var
-        if (hila::myrank() == 0 || is_delayed_)
+        if (hila::myrank() == 0 || is_delayed())
             val += v;
         else
             val = v;
 
-        if (is_delayed_) {
+        if (is_delayed()) {
             if (delay_is_on && is_delayed_sum == false) {
                 assert(0 && "Cannot mix sum and product reductions!");
             }
-            delay_is_on = true;
             is_delayed_sum = true;
+
+            // batch_state keeps track of batched reductions
+            if (!is_batched_)
+                delay_is_on = true;
+            else if (batch_state == hila::reduction_batch_struct::NONE)
+                hila::reduction_batch.add(val, batch_state);
         } else {
             do_reduce_operation(MPI_SUM);
         }
@@ -250,7 +284,9 @@ class Reduction {
 
     /// For delayed reduction, start_reduce starts or completes the reduction operation
     void start_reduce() {
-        if (!comm_is_on) {
+        if (batch_state == hila::reduction_batch_struct::PENDING) {
+            hila::reduction_batch.flush();
+        } else if (!comm_is_on) {
             if (delay_is_on) {
                 delay_is_on = false;
 
@@ -349,7 +349,8 @@ bool time_to_finish() {
             previous_time = this_time;
 
             // Give 2 min margin for the exit - perhaps needed for writing etc.
-            if (timelimit - this_time < max_interval + 2 * 60.0)
+            // Background work in flight, e.g. a checkpoint write, must also finish.
+            if (timelimit - this_time < max_interval + 2 * 60.0 + background_work_time_left())
                 finish = true;
             else
                 finish = false;
@@ -365,6 +366,35 @@ bool time_to_finish() {
     return finish;
 }
 
+//////////////////////////////////////////////////////////////////
+/// Background work registered with register_background_work()
+
+struct background_work_item {
+    double (*time_left)();
+    void (*finish)();
+};
+static std::vector<background_work_item> background_work;
+
+void register_background_work(double (*time_left)(), void (*finish)()) {
+    for (auto &w : background_work) {
+        if (w.time_left == time_left && w.finish == finish)
+            return;
+    }
+    background_work.push_back({time_left, finish});
+}
+
+double background_work_time_left() {
+    double t = 0;
+    for (auto &w : background_work)
+        t += w.time_left();
+    return t;
+}
+
+void finish_background_work() {
+    for (auto &w : background_work)
+        w.finish();
+}
+
 /*****************************************************
  * Time stamp
  */
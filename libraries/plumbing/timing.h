@@ -46,6 +46,8 @@ struct timer_value {
 ///                                               at a suitable spot in
 ///                                               the program; returns true if the program
 ///                                               should exit now.
+///   void hila::register_background_work(time_left, finish);
+///                                             - work still running at exit, see below
 ///
 /// Signal handling functions (for SIGUSR1):
 ///   int hila::signal_status();                - returns the signal SIGUSR1 if set 
@@ -105,6 +107,14 @@ void timestamp(const std::string &msg);
 void setup_signal_handler();
 int signal_status();
 
+// Background work which must be completed before the program exits, e.g. an asynchronous
+// checkpoint write.  time_left() returns an estimate of the seconds still needed, and is
+// added to the exit margin of time_to_finish().  finish() completes the work, it is
+// collective and called by hila::finishrun().
+void register_background_work(double (*time_left)(), void (*finish)());
+double background_work_time_left();
+void finish_background_work();
+
 
 } // namespace hila
 
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <assert.h>
 #include <sstream>
+#include <cstring>
+#include <cstdint>
 
 #include "plumbing/defs.h"
 
@@ -145,6 +147,46 @@ template<typename T>
 struct is_std_vector<std::vector<T>> : std::true_type {};
 
 
+//////////////////////////////////////////////////////////////////////////////
+/// Halo compression hook: hila::halo_compression<T> tells how the elements of type T
+/// are packed in halo messages.  Types with redundant content (e.g. SU(N) matrices, see
+/// sun_matrix.h) specialize this with is_compressible = true, compressed_size < sizeof(T),
+/// compress(value, buffer) and decompress(buffer, value).  The default sends T as is.
+//////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct halo_compression {
+    static constexpr bool is_compressible = false;
+    static constexpr size_t compressed_size = sizeof(T);
+    static void compress(const T &v, void *buf) {}
+    static void decompress(const void *buf, T &v) {}
+};
+
+/// Precision of the numbers in halo messages, see Field::set_halo_precision().
+/// HALF uses the bfloat16 format (float exponent, 8 bit mantissa), which keeps the range of
+/// float.
+enum class halo_precision : int { FULL, SINGLE, HALF };
+
+/// 16-bit bfloat16 number, conversions to and from float with rounding to nearest even
+struct bfloat16 {
+    uint16_t bits;
+
+    bfloat16() = default;
+    bfloat16(float f) {
+        uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        u += 0x7fff + ((u >> 16) & 1);
+        bits = u >> 16;
+    }
+    operator float() const {
+        uint32_t u = (uint32_t)bits << 16;
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+};
+
+
 
 } // namespace hila
 
@@ -8,31 +8,162 @@
 
 #include "hila.h"
 
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
 /// Functions checkpoint / restore_checkpoint allow one to save lattice config periodically
 /// Checkpoint keeps file "run_status" which holds the current trajectory.
 /// By modifying "run status" the number of trajectories can be changed
+///
+/// checkpoint_async() does the same without stalling the run: the links are copied to a
+/// host staging buffer and written by a background thread on each rank, while the live
+/// field continues to be updated.  The file is written to "<config_file>.tmp", and only
+/// after all ranks are done it is renamed to config_file (with the old one moved to .prev)
+/// and run_status is updated.  Thus a run interrupted during the write restarts from the
+/// previous, complete checkpoint.  The finishing step is collective and done by
+/// wait_checkpoint(), which is called automatically by the next checkpoint and by
+/// hila::finishrun().  While a write is in flight, hila::time_to_finish() adds the
+/// estimated remaining write time to its exit margin.
+///
+/// There is a single staging buffer, holding a copy of the local links.  Thus only one
+/// checkpoint can be in flight: checkpoint_async() called while the previous write is
+/// still running blocks until that write is done.
+///
+/// The writer threads make no MPI calls, each rank writes its own sites directly to the
+/// file.  Thus the file system must be visible to all ranks, as with -parallel_io.
 
-/// parameters-type must
+namespace hila {
 
+/// State of the asynchronous checkpoint in flight
+struct async_checkpoint_state {
+    std::thread writer;
+    std::vector<char> buffer;   // staging buffer, links in file order on this node
+    std::vector<char> header;   // written by rank 0 only
+    int64_t header_size;
+    size_t element_size;
+    CoordinateVector lattice_size, node_min, node_size;
+    std::string config_file, tmp_file;
+    std::string status;         // run_status contents, without time
+    bool save_old;
+    bool pending = false;
+    int error = 0;
+    double start_time, stall_time;
+    // progress of the writer thread, for the remaining time estimate
+    std::atomic<int64_t> bytes_written{0};
+    int64_t total_bytes = 0;
+    double write_start_time = 0;
 
-template <typename group>
-void checkpoint(const GaugeField<group> &U, const std::string &config_file, int &n_trajectories,
-                int trajectory, bool save_old = true) {
+    // If the program exits without wait_checkpoint() (e.g. hila::terminate()), do not
+    // leave the thread joinable, which would call std::terminate
+    ~async_checkpoint_state() {
+        if (writer.joinable())
+            writer.join();
+    }
+};
 
-    double t = hila::gettime();
+inline async_checkpoint_state async_checkpoint;
 
-    if (save_old && hila::myrank() == 0 && filesys_ns::exists(config_file)) {
-        filesys_ns::rename(config_file, config_file + ".prev");
-        // rename config to config.prev
+/// Writer thread: write the local part of the staging buffer to the tmp file.
+/// No MPI or hila::out0 here!
+inline void write_checkpoint_local(async_checkpoint_state &s) {
+
+    int fd = ::open(s.tmp_file.c_str(), O_WRONLY | O_CREAT, 0644);
+    if (fd < 0) {
+        s.error = 1;
+        return;
     }
 
-    // save config
-    U.config_write(config_file);
+    bool ok = true;
+    auto write_block = [&](const char *p, size_t n, int64_t offset) {
+        while (ok && n > 0) {
+            ssize_t r = ::pwrite(fd, p, n, offset);
+            if (r <= 0) {
+                ok = false;
+            } else {
+                p += r;
+                n -= r;
+                offset += r;
+                s.bytes_written += r;
+            }
+        }
+    };
+
+    if (s.header.size() > 0)
+        write_block(s.header.data(), s.header.size(), 0);
+
+    int64_t volume = 1, node_volume = 1;
+    for (int d = 0; d < NDIM; d++) {
+        volume *= s.lattice_size[d];
+        node_volume *= s.node_size[d];
+    }
+
+    // buffer has x fastest within the node box, so x-rows are contiguous in the file
+    size_t row_size = s.node_size[0] * s.element_size;
+    const char *p = s.buffer.data();
+    for (int dir = 0; dir < NDIM && ok; dir++) {
+        int64_t dir_offset = s.header_size + dir * volume * s.element_size;
+        CoordinateVector c = s.node_min;
+        for (int64_t row = 0; row < node_volume / s.node_size[0] && ok; row++) {
+            int64_t index = 0;
+            for (int d = NDIM - 1; d >= 0; d--)
+                index = index * s.lattice_size[d] + c[d];
+
+            write_block(p, row_size, dir_offset + index * s.element_size);
+            p += row_size;
+
+            for (int d = 1; d < NDIM; d++) {
+                if (++c[d] < s.node_min[d] + s.node_size[d])
+                    break;
+                c[d] = s.node_min[d];
+            }
+        }
+    }
+
+    if (ok && ::fsync(fd) != 0)
+        ok = false;
+    if (::close(fd) != 0)
+        ok = false;
+    s.error = ok ? 0 : 1;
+}
+
+/// Estimated time in seconds until the checkpoint write in flight is done, from the
+/// progress of the writer thread on this rank
+inline double checkpoint_time_left() {
+    auto &s = async_checkpoint;
+    if (!s.pending)
+        return 0;
+    double elapsed = hila::gettime() - s.write_start_time;
+    int64_t written = s.bytes_written;
+    if (written <= 0 || s.total_bytes <= 0)
+        return elapsed;
+    return elapsed * (s.total_bytes - written) / written;
+}
 
+/// Write run_status atomically: write to a temporary file and rename it.  Rank 0 only
+inline void write_run_status(const std::string &status) {
+    std::ofstream outf;
+    outf.open("run_status.tmp", std::ios::out | std::ios::trunc);
+    outf << status;
+    outf << "time         " << hila::gettime() << '\n';
+    outf.close();
+    filesys_ns::rename("run_status.tmp", "run_status");
+}
 
-    // check if n_trajectories has changed
-    // NOTE: all ranks must call hila::input routines!
+/// Contents of run_status, except time.  Rank 0 only
+inline std::string run_status_string(int n_trajectories, int trajectory) {
+    std::stringstream ss;
+    ss << "trajectories " << n_trajectories
+       << "   # CHANGE TO ADJUST NUMBER OF TRAJECTORIES IN THIS RUN\n";
+    ss << "trajectory   " << trajectory + 1 << '\n';
+    ss << "seed         " << static_cast<uint64_t>(hila::random() * (1UL << 61)) << '\n';
+    return ss.str();
+}
 
+/// check if n_trajectories has been changed in run_status
+/// NOTE: all ranks must call hila::input routines!
+inline void update_n_trajectories(int &n_trajectories) {
     hila::input status;
     status.quiet();
     if (status.open("run_status", false, false)) {
@@ -43,18 +174,67 @@ void checkpoint(const GaugeField<group> &U, const std::string &config_file, int
         }
         status.close();
     }
+}
+
+} // namespace hila
+
+
+/// Wait until the asynchronous checkpoint in flight, if any, is written, and then
+/// rename the config file and update run_status.  Collective, all ranks must call.
+
+inline void wait_checkpoint() {
+    auto &s = hila::async_checkpoint;
+    if (!s.pending)
+        return;
+
+    s.writer.join();
+    s.pending = false;
+
+    int error = s.error;
+    hila::reduce_node_sum(&error, 1, true);
+    if (error) {
+        hila::out0 << "Error in writing checkpoint file " << s.tmp_file << '\n';
+        hila::terminate(1);
+    }
+
+    if (hila::myrank() == 0) {
+        if (s.save_old && filesys_ns::exists(s.config_file)) {
+            filesys_ns::rename(s.config_file, s.config_file + ".prev");
+        }
+        filesys_ns::rename(s.tmp_file, s.config_file);
+        hila::write_run_status(s.status);
+
+        std::stringstream msg;
+        msg << "Checkpoint written, stall time " << s.stall_time << ", total time "
+            << hila::gettime() - s.start_time;
+        hila::timestamp(msg.str());
+    }
+}
+
+
+template <typename group>
+void checkpoint(const GaugeField<group> &U, const std::string &config_file, int &n_trajectories,
+                int trajectory, bool save_old = true) {
+
+    // finish possible async checkpoint first
+    wait_checkpoint();
+
+    double t = hila::gettime();
+
+    if (save_old && hila::myrank() == 0 && filesys_ns::exists(config_file)) {
+        filesys_ns::rename(config_file, config_file + ".prev");
+        // rename config to config.prev
+    }
+
+    // save config
+    U.config_write(config_file);
+
+    hila::update_n_trajectories(n_trajectories);
 
     if (hila::myrank() == 0) {
 
         // write the status file
-        std::ofstream outf;
-        outf.open("run_status", std::ios::out | std::ios::trunc);
-        outf << "trajectories " << n_trajectories
-             << "   # CHANGE TO ADJUST NUMBER OF TRAJECTORIES IN THIS RUN\n";
-        outf << "trajectory   " << trajectory + 1 << '\n';
-        outf << "seed         " << static_cast<uint64_t>(hila::random() * (1UL << 61)) << '\n';
-        outf << "time         " << hila::gettime() << '\n';
-        outf.close();
+        hila::write_run_status(hila::run_status_string(n_trajectories, trajectory));
 
         std::stringstream msg;
         msg << "Checkpointing, time " << hila::gettime() - t;
@@ -63,10 +243,75 @@ void checkpoint(const GaugeField<group> &U, const std::string &config_file, int
 
 }
 
+/// Asynchronous version of checkpoint(), see above.  Returns after the links have been
+/// copied to the staging buffer.  If previous async checkpoint is still being written,
+/// waits for it first.  With with_checksum == true the file has a checksum, see
+/// GaugeField::config_write().
+
+template <typename group>
+void checkpoint_async(const GaugeField<group> &U, const std::string &config_file,
+                      int &n_trajectories, int trajectory, bool save_old = true,
+                      bool with_checksum = false) {
+
+    wait_checkpoint();
+
+    auto &s = hila::async_checkpoint;
+    s.start_time = hila::gettime();
+
+    s.config_file = config_file;
+    s.tmp_file = config_file + ".tmp";
+    s.save_old = save_old;
+    s.element_size = sizeof(group);
+    s.header_size = (with_checksum ? 4 + NDIM : 3 + NDIM) * sizeof(int64_t);
+    s.lattice_size = lattice.size();
+    s.node_min = lattice->mynode.min;
+    s.node_size = lattice->mynode.size;
+
+    // snapshot the links; this is the only part which stalls the run
+    std::vector<group> local;
+    size_t dir_bytes = lattice->mynode.volume * sizeof(group);
+    s.buffer.resize(NDIM * dir_bytes);
+    foralldir (d) {
+        U[d].copy_local_data(local);
+        std::memcpy(s.buffer.data() + d * dir_bytes, local.data(), dir_bytes);
+    }
+
+    // header checksum from the snapshot data, collective
+    uint64_t checksum = with_checksum ? U.config_checksum() : 0;
+
+    hila::update_n_trajectories(n_trajectories);
+
+    s.header.clear();
+    s.status.clear();
+    if (hila::myrank() == 0) {
+        auto h = GaugeField<group>::config_header(with_checksum, checksum);
+        s.header.resize(s.header_size);
+        std::memcpy(s.header.data(), h.data(), s.header_size);
+        s.status = hila::run_status_string(n_trajectories, trajectory);
+
+        // remove possible leftover from an interrupted write before others open it
+        if (filesys_ns::exists(s.tmp_file))
+            filesys_ns::remove(s.tmp_file);
+    }
+    hila::synchronize();
+
+    s.error = 0;
+    s.bytes_written = 0;
+    s.total_bytes = s.header.size() + s.buffer.size();
+    s.write_start_time = hila::gettime();
+    s.pending = true;
+    s.writer = std::thread(hila::write_checkpoint_local, std::ref(s));
+    hila::register_background_work(hila::checkpoint_time_left, wait_checkpoint);
+
+    s.stall_time = hila::gettime() - s.start_time;
+}
+
 
 template <typename group>
 bool restore_checkpoint(GaugeField<group> &U, const std::string &config_file, int &n_trajectories,
                         int &trajectory) {
+    wait_checkpoint();
+
     uint64_t seed;
     bool ok = true;
     hila::input status;